@@ -0,0 +1,68 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_BASE_BUCKET_QUEUE_H_
+#define AGRPC_BASE_BUCKET_QUEUE_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <unifex/detail/intrusive_queue.hpp>
+
+namespace agrpc {
+
+// Intrusive priority queue over 64 priority levels, lowest first. Items of the
+// same priority are FIFO. A bitmap of the non-empty buckets makes push and pop
+// O(1) without touching any node other than the one being moved.
+template <typename Item, Item* Item::*Next>
+class BucketQueue {
+ public:
+  static constexpr std::size_t kBuckets = 64;
+
+  BucketQueue() noexcept = default;
+
+  BucketQueue(const BucketQueue&) = delete;
+  BucketQueue& operator=(const BucketQueue&) = delete;
+
+  bool empty() const noexcept { return occupied_ == 0; }
+  std::size_t size() const noexcept { return size_; }
+
+  void push(Item* item, std::size_t bucket) noexcept {
+    buckets_[bucket].push_back(item);
+    occupied_ |= std::uint64_t{1} << bucket;
+    ++size_;
+  }
+
+  // Pops the oldest item of the lowest non-empty bucket. Must not be empty.
+  Item* pop_front() noexcept {
+    auto bucket = __builtin_ctzll(occupied_);
+    auto& queue = buckets_[bucket];
+    auto* item = queue.pop_front();
+    if (queue.empty()) {
+      occupied_ &= occupied_ - 1;
+    }
+    --size_;
+    return item;
+  }
+
+ private:
+  std::uint64_t occupied_ = 0;
+  std::size_t size_ = 0;
+  std::array<unifex::intrusive_queue<Item, Next>, kBuckets> buckets_;
+};
+
+}  // namespace agrpc
+
+#endif  // AGRPC_BASE_BUCKET_QUEUE_H_
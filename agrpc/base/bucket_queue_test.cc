@@ -0,0 +1,63 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/base/bucket_queue.h"
+
+#include "gtest/gtest.h"
+
+namespace agrpc {
+namespace {
+
+struct Node {
+  Node* next;
+  int id = 0;
+};
+
+using Queue = BucketQueue<Node, &Node::next>;
+
+TEST(BucketQueue, LowestBucketFirst) {
+  Queue queue;
+  Node nodes[4];
+  for (int i = 0; i < 4; ++i) {
+    nodes[i].id = i;
+  }
+  queue.push(&nodes[0], 63);
+  queue.push(&nodes[1], 5);
+  queue.push(&nodes[2], 0);
+  queue.push(&nodes[3], 5);
+  ASSERT_EQ(queue.size(), 4);
+  ASSERT_EQ(queue.pop_front()->id, 2);
+  ASSERT_EQ(queue.pop_front()->id, 1);
+  ASSERT_EQ(queue.pop_front()->id, 3);
+  ASSERT_FALSE(queue.empty());
+  ASSERT_EQ(queue.pop_front()->id, 0);
+  ASSERT_TRUE(queue.empty());
+}
+
+TEST(BucketQueue, PushWhilePopping) {
+  Queue queue;
+  Node a, b, c;
+  queue.push(&a, 10);
+  queue.push(&b, 20);
+  ASSERT_EQ(queue.pop_front(), &a);
+  queue.push(&c, 1);
+  queue.push(&a, 20);
+  ASSERT_EQ(queue.pop_front(), &c);
+  ASSERT_EQ(queue.pop_front(), &b);
+  ASSERT_EQ(queue.pop_front(), &a);
+  ASSERT_TRUE(queue.empty());
+}
+
+}  // namespace
+}  // namespace agrpc
@@ -0,0 +1,45 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_BASE_COUNTER_H_
+#define AGRPC_BASE_COUNTER_H_
+
+#include <atomic>
+#include <cstdint>
+
+namespace agrpc {
+
+// A statistics counter that is only ever written by one thread (e.g. the
+// thread running a `GrpcContext`) but may be read from any thread.
+//
+// Since there is a single writer, increments are a plain relaxed load and
+// store instead of a locked read-modify-write.
+class SingleWriterCounter {
+ public:
+  void Add(std::uint64_t n = 1) noexcept {
+    value_.store(value_.load(std::memory_order_relaxed) + n,
+                 std::memory_order_relaxed);
+  }
+
+  std::uint64_t Read() const noexcept {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<std::uint64_t> value_{0};
+};
+
+}  // namespace agrpc
+
+#endif  // AGRPC_BASE_COUNTER_H_
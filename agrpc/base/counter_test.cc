@@ -0,0 +1,53 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/base/counter.h"
+
+#include <atomic>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+namespace agrpc {
+namespace {
+
+TEST(SingleWriterCounter, Add) {
+  SingleWriterCounter counter;
+  ASSERT_EQ(counter.Read(), 0);
+  counter.Add();
+  counter.Add(41);
+  ASSERT_EQ(counter.Read(), 42);
+}
+
+TEST(SingleWriterCounter, ConcurrentReader) {
+  SingleWriterCounter counter;
+  std::atomic<bool> done{false};
+  std::thread reader([&] {
+    std::uint64_t last = 0;
+    while (!done.load(std::memory_order_relaxed)) {
+      auto current = counter.Read();
+      ASSERT_GE(current, last);
+      last = current;
+    }
+  });
+  for (int i = 0; i < 100000; ++i) {
+    counter.Add();
+  }
+  done = true;
+  reader.join();
+  ASSERT_EQ(counter.Read(), 100000);
+}
+
+}  // namespace
+}  // namespace agrpc
@@ -0,0 +1,146 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_BASE_SHARDED_MPSC_QUEUE_H_
+#define AGRPC_BASE_SHARDED_MPSC_QUEUE_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+#include <unifex/detail/intrusive_queue.hpp>
+
+#include "agrpc/base/align.h"
+
+namespace agrpc {
+
+// Intrusive multi-producer single-consumer queue with an "inactive" state,
+// meant as a drop-in for `unifex::atomic_intrusive_queue` when many threads
+// post into one consumer.
+//
+// Producers are spread over `Shards` stacks, each on its own cache line, so
+// that they don't all CAS on a single head pointer. The consumer collects all
+// shards at once. Items enqueued by the same thread are dequeued in FIFO order,
+// there is no ordering between items from different threads.
+//
+// Like `unifex::atomic_intrusive_queue`, the consumer may mark the queue
+// inactive before going to sleep. The first producer to enqueue after that is
+// told to wake the consumer up.
+template <typename Item, Item* Item::*Next, std::size_t Shards = 16>
+class ShardedMpscQueue {
+ public:
+  using ItemQueue = unifex::intrusive_queue<Item, Next>;
+
+  explicit ShardedMpscQueue(bool initially_active) noexcept
+      : inactive_(!initially_active) {}
+
+  ShardedMpscQueue(const ShardedMpscQueue&) = delete;
+  ShardedMpscQueue& operator=(const ShardedMpscQueue&) = delete;
+
+  // Returns true if the queue was inactive and the caller is responsible for
+  // waking the consumer up.
+  [[nodiscard]] bool Enqueue(Item* item) noexcept {
+    auto& head = shards_[GetProducerShard()].head;
+    Item* old_head = head.load(std::memory_order_relaxed);
+    do {
+      item->*Next = old_head;
+    } while (!head.compare_exchange_weak(old_head, item,
+                                         std::memory_order_seq_cst,
+                                         std::memory_order_relaxed));
+    // The seq_cst push above and this load pair with the seq_cst store and
+    // loads in `TryMarkInactiveOrDequeueAll`: either we see the queue inactive
+    // or the consumer sees our item.
+    return inactive_.load(std::memory_order_seq_cst) &&
+           inactive_.exchange(false, std::memory_order_acq_rel);
+  }
+
+  // Enqueues all of `items` with a single CAS. They are dequeued in order, as
+  // if enqueued one by one. Returns the same as `Enqueue`. Must not be empty.
+  [[nodiscard]] bool EnqueueAll(ItemQueue items) noexcept {
+    // Link the items into a stack, top first.
+    Item* bottom = items.pop_front();
+    Item* top = bottom;
+    top->*Next = nullptr;
+    while (!items.empty()) {
+      Item* item = items.pop_front();
+      item->*Next = top;
+      top = item;
+    }
+    auto& head = shards_[GetProducerShard()].head;
+    Item* old_head = head.load(std::memory_order_relaxed);
+    do {
+      bottom->*Next = old_head;
+    } while (!head.compare_exchange_weak(old_head, top,
+                                         std::memory_order_seq_cst,
+                                         std::memory_order_relaxed));
+    return inactive_.load(std::memory_order_seq_cst) &&
+           inactive_.exchange(false, std::memory_order_acq_rel);
+  }
+
+  // Consumer only. Takes all items enqueued so far.
+  [[nodiscard]] ItemQueue DequeueAll() noexcept {
+    ItemQueue items;
+    for (auto& shard : shards_) {
+      // Don't write to cache lines of idle producers.
+      if (shard.head.load(std::memory_order_seq_cst) == nullptr) {
+        continue;
+      }
+      auto* stack = shard.head.exchange(nullptr, std::memory_order_acquire);
+      items.append(ItemQueue::make_reversed(stack));
+    }
+    return items;
+  }
+
+  // Consumer only. Marks the queue inactive if it is empty.
+  //
+  // Returns true if the queue is inactive afterwards, i.e. a producer has been
+  // or will be told to wake the consumer up. Items that raced with marking the
+  // queue inactive are still moved to `items` and must be processed.
+  //
+  // Returns false if the queue stays active, with its contents in `items`.
+  [[nodiscard]] bool TryMarkInactiveOrDequeueAll(ItemQueue& items) noexcept {
+    items = DequeueAll();
+    if (!items.empty()) {
+      return false;
+    }
+    inactive_.store(true, std::memory_order_seq_cst);
+    items = DequeueAll();
+    if (items.empty()) {
+      return true;
+    }
+    // Some producers got in. Take the wakeup back, unless one of them has
+    // already claimed it.
+    return !inactive_.exchange(false, std::memory_order_acq_rel);
+  }
+
+ private:
+  struct alignas(hardware_destructive_interference_size) Shard {
+    std::atomic<Item*> head{nullptr};
+  };
+
+  // Threads are assigned shards round-robin on first use.
+  static std::size_t GetProducerShard() noexcept {
+    static std::atomic<std::size_t> next_shard{0};
+    thread_local const std::size_t shard =
+        next_shard.fetch_add(1, std::memory_order_relaxed) % Shards;
+    return shard;
+  }
+
+  std::array<Shard, Shards> shards_;
+  alignas(hardware_destructive_interference_size) std::atomic<bool> inactive_;
+};
+
+}  // namespace agrpc
+
+#endif  // AGRPC_BASE_SHARDED_MPSC_QUEUE_H_
@@ -0,0 +1,116 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/base/sharded_mpsc_queue.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <unifex/detail/atomic_intrusive_queue.hpp>
+
+#include "benchmark/benchmark.h"
+
+// Many producers (the benchmark threads) post into a single queue that is
+// drained by a dedicated consumer thread, which is what happens to the remote
+// queue of a `GrpcContext` when lots of threads post completions into it.
+
+namespace agrpc {
+
+namespace {
+
+struct Node {
+  Node* next;
+  std::atomic<bool> queued{false};
+};
+
+struct AtomicIntrusiveQueue {
+  unifex::atomic_intrusive_queue<Node, &Node::next> queue{true};
+
+  void Enqueue(Node* node) noexcept { (void)queue.enqueue(node); }
+  auto DequeueAll() noexcept { return queue.dequeue_all(); }
+};
+
+struct ShardedQueue {
+  ShardedMpscQueue<Node, &Node::next> queue{true};
+
+  void Enqueue(Node* node) noexcept { (void)queue.Enqueue(node); }
+  auto DequeueAll() noexcept { return queue.DequeueAll(); }
+};
+
+template <typename Queue>
+class Consumer {
+ public:
+  Consumer() {
+    thread_ = std::thread([this] {
+      while (!exiting_.load(std::memory_order_relaxed)) {
+        auto items = queue_.DequeueAll();
+        while (!items.empty()) {
+          items.pop_front()->queued.store(false, std::memory_order_release);
+        }
+      }
+    });
+  }
+
+  ~Consumer() {
+    exiting_ = true;
+    thread_.join();
+  }
+
+  Queue& queue() noexcept { return queue_; }
+
+ private:
+  Queue queue_;
+  std::atomic<bool> exiting_{false};
+  std::thread thread_;
+};
+
+template <typename Queue>
+void RunProducer(benchmark::State& state) {
+  // Intentionally leaked, the consumer lives until the process exits.
+  static auto* consumer = new Consumer<Queue>();
+
+  // Each producer cycles through its own nodes and only reuses a node once the
+  // consumer has seen it.
+  std::vector<Node> nodes(4096);
+  std::size_t index = 0;
+  while (state.KeepRunning()) {
+    auto& node = nodes[index++ % nodes.size()];
+    while (node.queued.load(std::memory_order_acquire)) {
+    }
+    node.queued.store(true, std::memory_order_relaxed);
+    consumer->queue().Enqueue(&node);
+  }
+  for (auto& node : nodes) {
+    while (node.queued.load(std::memory_order_acquire)) {
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+}  // namespace
+
+void Benchmark_AtomicIntrusiveQueue(benchmark::State& state) {
+  RunProducer<AtomicIntrusiveQueue>(state);
+}
+
+BENCHMARK(Benchmark_AtomicIntrusiveQueue)->ThreadRange(1, 32)->UseRealTime();
+
+void Benchmark_ShardedMpscQueue(benchmark::State& state) {
+  RunProducer<ShardedQueue>(state);
+}
+
+BENCHMARK(Benchmark_ShardedMpscQueue)->ThreadRange(1, 32)->UseRealTime();
+
+}  // namespace agrpc
@@ -0,0 +1,161 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/base/sharded_mpsc_queue.h"
+
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace agrpc {
+namespace {
+
+struct Node {
+  Node* next;
+  int producer = 0;
+  int sequence = 0;
+};
+
+using Queue = ShardedMpscQueue<Node, &Node::next>;
+
+TEST(ShardedMpscQueue, FifoPerProducer) {
+  Queue queue{true};
+  Node nodes[3];
+  for (int i = 0; i < 3; ++i) {
+    nodes[i].sequence = i;
+    ASSERT_FALSE(queue.Enqueue(&nodes[i]));
+  }
+  auto items = queue.DequeueAll();
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_FALSE(items.empty());
+    ASSERT_EQ(items.pop_front()->sequence, i);
+  }
+  ASSERT_TRUE(items.empty());
+  ASSERT_TRUE(queue.DequeueAll().empty());
+}
+
+TEST(ShardedMpscQueue, EnqueueAll) {
+  Queue queue{false};
+  Node nodes[5];
+  Queue::ItemQueue batch;
+  for (int i = 0; i < 5; ++i) {
+    nodes[i].sequence = i;
+  }
+  ASSERT_TRUE(queue.Enqueue(&nodes[0]));
+  for (int i = 1; i < 4; ++i) {
+    batch.push_back(&nodes[i]);
+  }
+  ASSERT_FALSE(queue.EnqueueAll(std::move(batch)));
+  ASSERT_FALSE(queue.Enqueue(&nodes[4]));
+  auto items = queue.DequeueAll();
+  for (int i = 0; i < 5; ++i) {
+    ASSERT_EQ(items.pop_front()->sequence, i);
+  }
+  ASSERT_TRUE(items.empty());
+}
+
+TEST(ShardedMpscQueue, EnqueueAllWakesInactiveConsumerOnce) {
+  Queue queue{true};
+  Node nodes[3];
+  Queue::ItemQueue batch;
+  for (int i = 0; i < 3; ++i) {
+    nodes[i].sequence = i;
+    batch.push_back(&nodes[i]);
+  }
+  ASSERT_TRUE(queue.EnqueueAll(std::move(batch)));
+
+  Node single;
+  single.sequence = 3;
+  Queue::ItemQueue one;
+  one.push_back(&single);
+  ASSERT_FALSE(queue.EnqueueAll(std::move(one)));
+
+  auto items = queue.DequeueAll();
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_EQ(items.pop_front()->sequence, i);
+  }
+  ASSERT_TRUE(items.empty());
+}
+
+TEST(ShardedMpscQueue, InactiveWakesFirstProducerOnly) {
+  Queue queue{false};
+  Node a, b;
+  ASSERT_TRUE(queue.Enqueue(&a));
+  ASSERT_FALSE(queue.Enqueue(&b));
+
+  Queue::ItemQueue items;
+  ASSERT_FALSE(queue.TryMarkInactiveOrDequeueAll(items));
+  ASSERT_EQ(items.pop_front(), &a);
+  ASSERT_EQ(items.pop_front(), &b);
+
+  ASSERT_TRUE(queue.TryMarkInactiveOrDequeueAll(items));
+  ASSERT_TRUE(items.empty());
+  ASSERT_TRUE(queue.Enqueue(&a));
+}
+
+TEST(ShardedMpscQueue, ManyProducers) {
+  constexpr int kProducers = 8;
+  constexpr int kItemsPerProducer = 20000;
+
+  Queue queue{false};
+  std::vector<std::vector<Node>> nodes(kProducers,
+                                       std::vector<Node>(kItemsPerProducer));
+  std::atomic<int> wakeups{0};
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; ++p) {
+    producers.emplace_back([&, p] {
+      for (int i = 0; i < kItemsPerProducer; ++i) {
+        auto& node = nodes[p][i];
+        node.producer = p;
+        node.sequence = i;
+        if (queue.Enqueue(&node)) {
+          wakeups.fetch_add(1);
+        }
+      }
+    });
+  }
+
+  // Simulated consumer: it may only go inactive when it has been woken up for
+  // every time it did so.
+  std::vector<int> next_sequence(kProducers, 0);
+  int received = 0;
+  int sleeps = 0;
+  bool inactive = true;
+  while (received != kProducers * kItemsPerProducer) {
+    Queue::ItemQueue items;
+    if (inactive) {
+      if (wakeups.load() == sleeps + 1) {
+        ++sleeps;
+        inactive = false;
+      }
+    } else {
+      inactive = queue.TryMarkInactiveOrDequeueAll(items);
+    }
+    while (!items.empty()) {
+      auto* node = items.pop_front();
+      ASSERT_EQ(node->sequence, next_sequence[node->producer]++);
+      ++received;
+    }
+  }
+  for (auto& t : producers) {
+    t.join();
+  }
+  ASSERT_LE(wakeups.load(), sleeps + 1);
+}
+
+}  // namespace
+}  // namespace agrpc
@@ -0,0 +1,80 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/base/thread.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <thread>
+
+#include "agrpc/base/logging.h"
+
+namespace agrpc {
+
+std::size_t GetNumberOfProcessorsAvailable() {
+#if defined(__linux__)
+  cpu_set_t cpus;
+  if (sched_getaffinity(0, sizeof(cpus), &cpus) == 0) {
+    auto count = CPU_COUNT(&cpus);
+    if (count > 0) {
+      return count;
+    }
+  }
+#endif
+  auto count = std::thread::hardware_concurrency();
+  return count ? count : 1;
+}
+
+std::vector<std::size_t> GetAvailableProcessors() {
+  std::vector<std::size_t> result;
+#if defined(__linux__)
+  cpu_set_t cpus;
+  if (sched_getaffinity(0, sizeof(cpus), &cpus) == 0) {
+    for (std::size_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &cpus)) {
+        result.push_back(cpu);
+      }
+    }
+  }
+#endif
+  if (result.empty()) {
+    auto count = std::thread::hardware_concurrency();
+    for (std::size_t cpu = 0; cpu < (count ? count : 1); ++cpu) {
+      result.push_back(cpu);
+    }
+  }
+  return result;
+}
+
+bool SetCurrentThreadAffinity(std::size_t cpu) {
+#if defined(__linux__)
+  if (cpu >= CPU_SETSIZE) {
+    return false;
+  }
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  auto error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  AGRPC_LOG_WARNING_IF(error != 0, "Failed to pin thread to CPU #{}: {}", cpu,
+                       error);
+  return error == 0;
+#else
+  return false;
+#endif
+}
+
+}  // namespace agrpc
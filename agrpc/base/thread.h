@@ -0,0 +1,38 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_BASE_THREAD_H_
+#define AGRPC_BASE_THREAD_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace agrpc {
+
+// Number of CPUs the current process may run on. Never returns 0.
+std::size_t GetNumberOfProcessorsAvailable();
+
+// The ids of the CPUs in the affinity mask of the calling thread, in
+// ascending order.
+std::vector<std::size_t> GetAvailableProcessors();
+
+// Restricts the calling thread to the given CPU.
+//
+// Returns false (and leaves the affinity untouched) if the platform does not
+// support it or the CPU is not available to this process.
+bool SetCurrentThreadAffinity(std::size_t cpu);
+
+}  // namespace agrpc
+
+#endif  // AGRPC_BASE_THREAD_H_
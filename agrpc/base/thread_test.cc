@@ -0,0 +1,49 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/base/thread.h"
+
+#include <algorithm>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#include "gtest/gtest.h"
+
+namespace agrpc {
+namespace {
+
+TEST(Thread, AvailableProcessorsMatchTheirNumber) {
+  auto cpus = GetAvailableProcessors();
+  ASSERT_EQ(cpus.size(), GetNumberOfProcessorsAvailable());
+  ASSERT_TRUE(std::is_sorted(cpus.begin(), cpus.end()));
+}
+
+#if defined(__linux__)
+TEST(Thread, AvailableProcessorsFollowTheAffinityMask) {
+  cpu_set_t saved;
+  ASSERT_EQ(sched_getaffinity(0, sizeof(saved), &saved), 0);
+
+  auto cpu = GetAvailableProcessors().back();
+  ASSERT_TRUE(SetCurrentThreadAffinity(cpu));
+  auto cpus = GetAvailableProcessors();
+  ASSERT_EQ(sched_setaffinity(0, sizeof(saved), &saved), 0);
+
+  ASSERT_EQ(cpus, std::vector<std::size_t>{cpu});
+}
+#endif
+
+}  // namespace
+}  // namespace agrpc
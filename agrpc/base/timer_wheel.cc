@@ -0,0 +1,127 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/base/timer_wheel.h"
+
+#include <algorithm>
+
+namespace agrpc {
+
+void TimerWheel::Insert(Entry* entry, Tick expiry) noexcept {
+  entry->expiry_ = expiry;
+  Link(entry);
+}
+
+void TimerWheel::Remove(Entry* entry) noexcept {
+  auto bucket = entry->bucket_;
+  if (entry->prev_) {
+    entry->prev_->next_ = entry->next_;
+  } else {
+    buckets_[bucket] = entry->next_;
+  }
+  if (entry->next_) {
+    entry->next_->prev_ = entry->prev_;
+  }
+  if (!buckets_[bucket] && bucket != kDueBucket) {
+    occupied_[bucket / kSlotsPerLevel] &=
+        ~(std::uint64_t{1} << (bucket % kSlotsPerLevel));
+  }
+  entry->prev_ = entry->next_ = nullptr;
+  entry->bucket_ = Entry::kUnlinked;
+  --size_;
+}
+
+std::optional<TimerWheel::Tick> TimerWheel::GetNextExpiry() const noexcept {
+  if (buckets_[kDueBucket]) {
+    return elapsed_;
+  }
+  if (auto slot = GetNextSlot()) {
+    return slot->deadline;
+  }
+  return std::nullopt;
+}
+
+void TimerWheel::Link(Entry* entry) noexcept {
+  if (entry->expiry_ <= elapsed_) {
+    PushBucket(entry, kDueBucket);
+    return;
+  }
+  // Timers too far out are parked at the furthest reachable tick and placed
+  // again once the wheel gets there.
+  auto target = static_cast<std::uint64_t>(
+      std::min(entry->expiry_, elapsed_ + kMaxDelay));
+  // The level is given by the most significant bit in which the target differs
+  // from the current time.
+  auto masked =
+      (static_cast<std::uint64_t>(elapsed_) ^ target) | (kSlotsPerLevel - 1);
+  int level = std::min((63 - __builtin_clzll(masked)) / kBitsPerLevel,
+                       kLevels - 1);
+  int index = (target >> (level * kBitsPerLevel)) & (kSlotsPerLevel - 1);
+  occupied_[level] |= std::uint64_t{1} << index;
+  PushBucket(entry, level * kSlotsPerLevel + index);
+}
+
+void TimerWheel::PushBucket(Entry* entry, int bucket) noexcept {
+  entry->bucket_ = static_cast<std::uint16_t>(bucket);
+  entry->prev_ = nullptr;
+  entry->next_ = buckets_[bucket];
+  if (entry->next_) {
+    entry->next_->prev_ = entry;
+  }
+  buckets_[bucket] = entry;
+  ++size_;
+}
+
+TimerWheel::Entry* TimerWheel::TakeBucket(int bucket) noexcept {
+  auto* head = buckets_[bucket];
+  buckets_[bucket] = nullptr;
+  if (bucket != kDueBucket) {
+    occupied_[bucket / kSlotsPerLevel] &=
+        ~(std::uint64_t{1} << (bucket % kSlotsPerLevel));
+  }
+  for (auto* entry = head; entry; entry = entry->next_) {
+    entry->prev_ = nullptr;
+    entry->bucket_ = Entry::kUnlinked;
+    --size_;
+  }
+  return head;
+}
+
+std::optional<TimerWheel::Slot> TimerWheel::GetNextSlot() const noexcept {
+  // Slots on lower levels always expire before those on higher levels, so the
+  // first level with anything in it has the next slot.
+  for (int level = 0; level < kLevels; ++level) {
+    auto occupied = occupied_[level];
+    if (!occupied) {
+      continue;
+    }
+    int shift = level * kBitsPerLevel;
+    int current = (elapsed_ >> shift) & (kSlotsPerLevel - 1);
+    // Search from the current slot onwards, wrapping around.
+    auto rotated = (occupied >> current) |
+                   (current ? occupied << (kSlotsPerLevel - current) : 0);
+    int index = (current + __builtin_ctzll(rotated)) & (kSlotsPerLevel - 1);
+    Tick slot_size = Tick{1} << shift;
+    Tick level_size = slot_size << kBitsPerLevel;
+    Tick deadline = (elapsed_ & ~(level_size - 1)) + index * slot_size;
+    if (deadline <= elapsed_) {
+      // Only possible on the top level, for a slot in the next rotation.
+      deadline += level_size;
+    }
+    return Slot{level, index, deadline};
+  }
+  return std::nullopt;
+}
+
+}  // namespace agrpc
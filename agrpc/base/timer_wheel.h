@@ -0,0 +1,164 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_BASE_TIMER_WHEEL_H_
+#define AGRPC_BASE_TIMER_WHEEL_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace agrpc {
+
+// Hierarchical timer wheel with O(1) insertion and removal.
+//
+// Time is measured in abstract ticks. Level `l` has 64 slots of 64^l ticks
+// each, a timer is kept in the level where its expiry first differs from the
+// current time, and moves down a level each time the wheel reaches its slot.
+// Six levels cover 2^36 ticks (about two years at one tick per millisecond);
+// timers further out are parked in the top level and re-placed as time
+// advances.
+//
+// Entries are intrusive and owned by the caller. The wheel is not thread-safe.
+class TimerWheel {
+ public:
+  using Tick = std::int64_t;
+
+  class Entry {
+   public:
+    Entry() noexcept = default;
+
+    Entry(const Entry&) = delete;
+    Entry& operator=(const Entry&) = delete;
+
+    bool is_linked() const noexcept { return bucket_ != kUnlinked; }
+
+    Tick expiry() const noexcept { return expiry_; }
+
+   private:
+    friend TimerWheel;
+
+    static constexpr std::uint16_t kUnlinked = 0xffff;
+
+    Entry* prev_ = nullptr;
+    Entry* next_ = nullptr;
+    Tick expiry_ = 0;
+    std::uint16_t bucket_ = kUnlinked;
+  };
+
+  explicit TimerWheel(Tick now) noexcept : elapsed_(now) {}
+
+  TimerWheel(const TimerWheel&) = delete;
+  TimerWheel& operator=(const TimerWheel&) = delete;
+
+  bool empty() const noexcept { return size_ == 0; }
+  std::size_t size() const noexcept { return size_; }
+
+  // The time the wheel has been advanced to.
+  Tick now() const noexcept { return elapsed_; }
+
+  // Adds `entry`, which must not be linked, to expire at `expiry`. An expiry
+  // that is not in the future expires on the next `Advance`.
+  void Insert(Entry* entry, Tick expiry) noexcept;
+
+  // Removes a linked `entry` without expiring it.
+  void Remove(Entry* entry) noexcept;
+
+  // Advances the wheel to `now` and calls `on_expired(Entry*)` for every entry
+  // whose expiry is not after `now`. Entries are unlinked before the callback
+  // is called, which must not modify the wheel.
+  template <typename F>
+  void Advance(Tick now, F&& on_expired);
+
+  // Unlinks every entry and calls `on_removed(Entry*)` for it.
+  template <typename F>
+  void RemoveAll(F&& on_removed);
+
+  // The earliest tick at which `Advance` may expire something, or nothing if
+  // the wheel is empty. This is a lower bound, entries parked on higher levels
+  // are only looked at once the wheel reaches their slot.
+  std::optional<Tick> GetNextExpiry() const noexcept;
+
+ private:
+  static constexpr int kBitsPerLevel = 6;
+  static constexpr int kSlotsPerLevel = 1 << kBitsPerLevel;
+  static constexpr int kLevels = 6;
+  static constexpr Tick kMaxDelay =
+      (Tick{1} << (kBitsPerLevel * kLevels)) - 1;
+  // Entries that were already expired when inserted.
+  static constexpr int kDueBucket = kLevels * kSlotsPerLevel;
+
+  struct Slot {
+    int level;
+    int index;
+    Tick deadline;
+  };
+
+  // Links `entry` into the due bucket or the slot its expiry falls into,
+  // relative to `elapsed_`.
+  void Link(Entry* entry) noexcept;
+  void PushBucket(Entry* entry, int bucket) noexcept;
+  Entry* TakeBucket(int bucket) noexcept;
+  std::optional<Slot> GetNextSlot() const noexcept;
+
+  Tick elapsed_;
+  std::size_t size_ = 0;
+  std::array<std::uint64_t, kLevels> occupied_{};
+  std::array<Entry*, kDueBucket + 1> buckets_{};
+};
+
+template <typename F>
+void TimerWheel::Advance(Tick now, F&& on_expired) {
+  for (auto* entry = TakeBucket(kDueBucket); entry;) {
+    auto* next = entry->next_;
+    on_expired(entry);
+    entry = next;
+  }
+  while (auto slot = GetNextSlot()) {
+    if (slot->deadline > now) {
+      break;
+    }
+    elapsed_ = slot->deadline;
+    auto* entry = TakeBucket(slot->level * kSlotsPerLevel + slot->index);
+    while (entry) {
+      auto* next = entry->next_;
+      if (entry->expiry_ <= elapsed_) {
+        on_expired(entry);
+      } else {
+        // Cascade into a lower level.
+        Link(entry);
+      }
+      entry = next;
+    }
+  }
+  if (now > elapsed_) {
+    elapsed_ = now;
+  }
+}
+
+template <typename F>
+void TimerWheel::RemoveAll(F&& on_removed) {
+  for (int bucket = 0; bucket <= kDueBucket; ++bucket) {
+    for (auto* entry = TakeBucket(bucket); entry;) {
+      auto* next = entry->next_;
+      on_removed(entry);
+      entry = next;
+    }
+  }
+}
+
+}  // namespace agrpc
+
+#endif  // AGRPC_BASE_TIMER_WHEEL_H_
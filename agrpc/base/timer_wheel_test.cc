@@ -0,0 +1,165 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/base/timer_wheel.h"
+
+#include <map>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace agrpc {
+namespace {
+
+using Tick = TimerWheel::Tick;
+
+// Advances `wheel` one tick at a time up to `until` and records at which tick
+// each entry expired.
+std::map<TimerWheel::Entry*, Tick> StepTo(TimerWheel& wheel, Tick until) {
+  std::map<TimerWheel::Entry*, Tick> expired;
+  for (auto now = wheel.now(); now <= until; ++now) {
+    wheel.Advance(now, [&](auto* entry) { expired[entry] = now; });
+  }
+  return expired;
+}
+
+TEST(TimerWheel, ExpiresOnTime) {
+  TimerWheel wheel{1000};
+  TimerWheel::Entry entries[4];
+  const Tick expiries[] = {1001, 1063, 1064, 1000 + 5000};
+  for (int i = 0; i < 4; ++i) {
+    wheel.Insert(&entries[i], expiries[i]);
+  }
+  ASSERT_EQ(wheel.size(), 4);
+  auto expired = StepTo(wheel, 7000);
+  ASSERT_TRUE(wheel.empty());
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_EQ(expired[&entries[i]], expiries[i]);
+    ASSERT_FALSE(entries[i].is_linked());
+  }
+}
+
+TEST(TimerWheel, ExpiredOnInsert) {
+  TimerWheel wheel{100};
+  TimerWheel::Entry entry;
+  wheel.Insert(&entry, 50);
+  ASSERT_EQ(wheel.GetNextExpiry(), 100);
+  int calls = 0;
+  wheel.Advance(100, [&](auto* expired) {
+    ASSERT_EQ(expired, &entry);
+    ++calls;
+  });
+  ASSERT_EQ(calls, 1);
+}
+
+TEST(TimerWheel, Remove) {
+  TimerWheel wheel{0};
+  TimerWheel::Entry a, b, c;
+  wheel.Insert(&a, 10);
+  wheel.Insert(&b, 10);
+  wheel.Insert(&c, 100000);
+  wheel.Remove(&a);
+  wheel.Remove(&c);
+  ASSERT_FALSE(a.is_linked());
+  ASSERT_TRUE(b.is_linked());
+  ASSERT_EQ(wheel.size(), 1);
+  auto expired = StepTo(wheel, 200000);
+  ASSERT_EQ(expired.size(), 1);
+  ASSERT_EQ(expired[&b], 10);
+}
+
+TEST(TimerWheel, AdvanceSkipsAhead) {
+  TimerWheel wheel{0};
+  TimerWheel::Entry near, far;
+  wheel.Insert(&near, 70);
+  wheel.Insert(&far, 300000);
+  ASSERT_EQ(wheel.GetNextExpiry(), 64);
+
+  std::vector<TimerWheel::Entry*> expired;
+  wheel.Advance(1000, [&](auto* entry) { expired.push_back(entry); });
+  ASSERT_EQ(expired, std::vector<TimerWheel::Entry*>{&near});
+  ASSERT_EQ(wheel.now(), 1000);
+
+  // Jumping a long way expires the far entry on the first call.
+  expired.clear();
+  wheel.Advance(10000000, [&](auto* entry) { expired.push_back(entry); });
+  ASSERT_EQ(expired, std::vector<TimerWheel::Entry*>{&far});
+  ASSERT_FALSE(wheel.GetNextExpiry());
+}
+
+TEST(TimerWheel, BeyondRange) {
+  constexpr Tick kFar = Tick{1} << 40;
+  TimerWheel wheel{5};
+  TimerWheel::Entry entry;
+  wheel.Insert(&entry, kFar);
+  std::vector<Tick> fired;
+  // Walk through the wheel's deadlines the way a timer would be re-armed.
+  while (auto next = wheel.GetNextExpiry()) {
+    ASSERT_LE(*next, kFar);
+    wheel.Advance(*next, [&](auto*) { fired.push_back(*next); });
+  }
+  ASSERT_EQ(fired, std::vector<Tick>{kFar});
+}
+
+TEST(TimerWheel, RemoveAll) {
+  TimerWheel wheel{0};
+  TimerWheel::Entry entries[3];
+  wheel.Insert(&entries[0], 0);
+  wheel.Insert(&entries[1], 5);
+  wheel.Insert(&entries[2], 1 << 20);
+  int removed = 0;
+  wheel.RemoveAll([&](auto* entry) {
+    ASSERT_FALSE(entry->is_linked());
+    ++removed;
+  });
+  ASSERT_EQ(removed, 3);
+  ASSERT_TRUE(wheel.empty());
+  ASSERT_FALSE(wheel.GetNextExpiry());
+}
+
+TEST(TimerWheel, Random) {
+  constexpr int kEntries = 2000;
+  std::mt19937 random{42};
+  std::uniform_int_distribution<Tick> delay{0, 300000};
+
+  TimerWheel wheel{123456};
+  std::vector<TimerWheel::Entry> entries(kEntries);
+  for (auto& entry : entries) {
+    wheel.Insert(&entry, wheel.now() + delay(random));
+  }
+  for (int i = 0; i < kEntries; i += 3) {
+    wheel.Remove(&entries[i]);
+  }
+
+  std::map<TimerWheel::Entry*, Tick> expired;
+  while (auto next = wheel.GetNextExpiry()) {
+    auto now = *next + random() % 100;
+    wheel.Advance(now, [&](auto* entry) {
+      ASSERT_TRUE(expired.emplace(entry, now).second);
+    });
+  }
+  for (int i = 0; i < kEntries; ++i) {
+    if (i % 3 == 0) {
+      ASSERT_FALSE(expired.count(&entries[i]));
+      continue;
+    }
+    // Never early, and never later than the advance that covered it.
+    ASSERT_GE(expired[&entries[i]], entries[i].expiry());
+    ASSERT_LT(expired[&entries[i]], entries[i].expiry() + 100);
+  }
+}
+
+}  // namespace
+}  // namespace agrpc
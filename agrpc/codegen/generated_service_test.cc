@@ -0,0 +1,226 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+#include <grpcpp/create_channel.h>
+#include <grpcpp/security/credentials.h>
+#include <grpcpp/security/server_credentials.h>
+#include <grpcpp/server.h>
+#include <grpcpp/server_builder.h>
+#include <unifex/async_scope.hpp>
+#include <unifex/sync_wait.hpp>
+
+#include "gtest/gtest.h"
+
+#include "agrpc/context/async_manual_reset_event.h"
+#include "agrpc/context/grpc_context_pool.h"
+#include "agrpc/testing/echo.agrpc.h"
+#include "agrpc/testing/reserved_names.agrpc.h"
+
+namespace agrpc {
+namespace {
+
+using testing::EchoRequest;
+using testing::EchoResponse;
+using testing::EchoService;
+using testing::Item;
+using testing::ReservedNamesService;
+
+// Holds every `Echo` call until `release` is set.
+class EchoServiceImpl : public testing::EchoServiceAgrpcBase<EchoServiceImpl> {
+ public:
+  task<void> Echo(GrpcContext::Scheduler scheduler,
+                  grpc::ServerContext& server_context, EchoRequest& request,
+                  EchoResponse& response,
+                  grpc::ServerAsyncResponseWriter<EchoResponse>& writer) {
+    {
+      std::lock_guard lock{mutex};
+      handled_on.insert(detail::GrpcContextAccess::GetCurrent());
+    }
+    ++entered;
+    co_await release.Wait();
+    response.set_message(request.message());
+    co_await AsyncFinish(scheduler, writer, response, grpc::Status::OK);
+  }
+
+  task<void> EchoStream(
+      GrpcContext::Scheduler scheduler, grpc::ServerContext& server_context,
+      EchoRequest& request, EchoResponse& response,
+      grpc::ServerAsyncReaderWriter<EchoResponse, EchoRequest>& stream) {
+    while (co_await AsyncRead(scheduler, stream, request)) {
+      response.set_message(request.message());
+      co_await AsyncWrite(scheduler, stream, response);
+    }
+    co_await AsyncFinish(scheduler, stream, grpc::Status::OK);
+  }
+
+  std::mutex mutex;
+  // The contexts `Echo` ran on.
+  std::set<GrpcContext*> handled_on;
+  std::atomic<int> entered{0};
+  AsyncManualResetEvent release;
+};
+
+// Answers with the method name followed by the request's name.
+class ReservedNamesServiceImpl
+    : public testing::ReservedNamesServiceAgrpcBase<ReservedNamesServiceImpl> {
+ public:
+  task<void> Delete(GrpcContext::Scheduler scheduler,
+                    grpc::ServerContext& server_context, Item& request,
+                    Item& response,
+                    grpc::ServerAsyncResponseWriter<Item>& writer) {
+    return Answer(scheduler, "delete", request, response, writer);
+  }
+
+  task<void> New(GrpcContext::Scheduler scheduler,
+                 grpc::ServerContext& server_context, Item& request,
+                 Item& response,
+                 grpc::ServerAsyncResponseWriter<Item>& writer) {
+    return Answer(scheduler, "new", request, response, writer);
+  }
+
+  task<void> Default(GrpcContext::Scheduler scheduler,
+                     grpc::ServerContext& server_context, Item& request,
+                     Item& response,
+                     grpc::ServerAsyncResponseWriter<Item>& writer) {
+    return Answer(scheduler, "default", request, response, writer);
+  }
+
+ private:
+  static task<void> Answer(GrpcContext::Scheduler scheduler, const char* method,
+                           Item& request, Item& response,
+                           grpc::ServerAsyncResponseWriter<Item>& writer) {
+    response.set_name(fmt::format("{} {}", method, request.name()));
+    co_await AsyncFinish(scheduler, writer, response, grpc::Status::OK);
+  }
+};
+
+// A server on a pool of contexts that serves `service`.
+template <typename Service>
+class TestServer {
+ public:
+  static constexpr int kContexts = 2;
+
+  explicit TestServer(Service& service) {
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort("127.0.0.1:0", grpc::InsecureServerCredentials(),
+                             &port_);
+    builder.RegisterService(&service.async_service());
+    pool_ = std::make_unique<GrpcContextPool>(builder, kContexts);
+    server_ = builder.BuildAndStart();
+  }
+
+  ~TestServer() {
+    server_->Shutdown();
+    pool_->ShutDown();
+    pool_->Join();
+    unifex::sync_wait(scope_.cleanup());
+  }
+
+  std::shared_ptr<grpc::Channel> NewChannel() {
+    return grpc::CreateChannel(fmt::format("127.0.0.1:{}", port_),
+                               grpc::InsecureChannelCredentials());
+  }
+
+  GrpcContextPool& pool() noexcept { return *pool_; }
+  unifex::async_scope& scope() noexcept { return scope_; }
+
+ private:
+  int port_{0};
+  std::unique_ptr<GrpcContextPool> pool_;
+  std::unique_ptr<grpc::Server> server_;
+  unifex::async_scope scope_;
+};
+
+TEST(GeneratedService, ServesEveryContext) {
+  constexpr int kContexts = TestServer<EchoServiceImpl>::kContexts;
+  EchoServiceImpl service;
+  TestServer server{service};
+  // With one `Echo` call per context at a time, calls that are in flight
+  // together must be handled on different contexts.
+  testing::StartEchoService(
+      service, server.pool(), server.scope(),
+      {.echo = {.outstanding_requests = 1, .max_concurrency = 1}});
+  server.pool().Start();
+
+  auto stub = EchoService::NewStub(server.NewChannel());
+  std::vector<std::thread> clients;
+  for (int i = 0; i < kContexts; ++i) {
+    clients.emplace_back([&stub, i] {
+      grpc::ClientContext client_context;
+      EchoRequest request;
+      request.set_message(std::to_string(i));
+      EchoResponse response;
+      EXPECT_TRUE(stub->Echo(&client_context, request, &response).ok());
+      EXPECT_EQ(response.message(), std::to_string(i));
+    });
+  }
+  while (service.entered < kContexts) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  service.release.Set();
+  for (auto& client : clients) {
+    client.join();
+  }
+
+  ASSERT_EQ(static_cast<int>(service.handled_on.size()), kContexts);
+  for (int i = 0; i < kContexts; ++i) {
+    ASSERT_EQ(service.handled_on.count(&server.pool().get_context(i)), 1);
+  }
+}
+
+TEST(GeneratedService, EscapesKeywordOptionNames) {
+  ReservedNamesServiceImpl service;
+  TestServer server{service};
+  testing::StartReservedNamesService(
+      service, server.pool(), server.scope(),
+      {.delete_ = {.outstanding_requests = 2},
+       .new_ = {.outstanding_requests = 2},
+       .default_ = {.outstanding_requests = 2}});
+  server.pool().Start();
+
+  auto stub = ReservedNamesService::NewStub(server.NewChannel());
+  Item request;
+  request.set_name("item");
+  {
+    grpc::ClientContext client_context;
+    Item response;
+    ASSERT_TRUE(stub->Delete(&client_context, request, &response).ok());
+    ASSERT_EQ(response.name(), "delete item");
+  }
+  {
+    grpc::ClientContext client_context;
+    Item response;
+    ASSERT_TRUE(stub->New(&client_context, request, &response).ok());
+    ASSERT_EQ(response.name(), "new item");
+  }
+  {
+    grpc::ClientContext client_context;
+    Item response;
+    ASSERT_TRUE(stub->Default(&client_context, request, &response).ok());
+    ASSERT_EQ(response.name(), "default item");
+  }
+}
+
+}  // namespace
+}  // namespace agrpc
@@ -0,0 +1,316 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// protoc plugin generating `<file>.agrpc.h` next to `<file>.grpc.pb.h`. For
+// every service it declares a CRTP base class whose `Derived` implements the
+// methods as `agrpc::task`s, and a `Start<Service>` function serving all
+// methods on every context of a `GrpcContextPool` through `agrpc::serve`.
+// Calls reach the derived class through templates, there are no virtual
+// functions or method tables.
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <google/protobuf/compiler/code_generator.h>
+#include <google/protobuf/compiler/plugin.h>
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/io/printer.h>
+#include <google/protobuf/io/zero_copy_stream.h>
+
+namespace agrpc {
+
+namespace {
+
+using google::protobuf::Descriptor;
+using google::protobuf::FileDescriptor;
+using google::protobuf::MethodDescriptor;
+using google::protobuf::ServiceDescriptor;
+using google::protobuf::compiler::CodeGenerator;
+using google::protobuf::compiler::GeneratorContext;
+using google::protobuf::io::Printer;
+
+using Variables = std::map<std::string, std::string>;
+
+std::string StripProto(const std::string& file_name) {
+  constexpr std::string_view kSuffix = ".proto";
+  if (file_name.size() >= kSuffix.size() &&
+      file_name.compare(file_name.size() - kSuffix.size(), kSuffix.size(),
+                        kSuffix) == 0) {
+    return file_name.substr(0, file_name.size() - kSuffix.size());
+  }
+  return file_name;
+}
+
+std::string DotsToColons(const std::string& name) {
+  std::string result;
+  for (char c : name) {
+    if (c == '.') {
+      result += "::";
+    } else {
+      result += c;
+    }
+  }
+  return result;
+}
+
+// The C++20 keywords and alternative tokens, sorted.
+constexpr std::string_view kCppKeywords[] = {
+    "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor",
+    "bool", "break", "case", "catch", "char", "char16_t", "char32_t", "char8_t",
+    "class", "co_await", "co_return", "co_yield", "compl", "concept", "const",
+    "const_cast", "consteval", "constexpr", "constinit", "continue", "decltype",
+    "default", "delete", "do", "double", "dynamic_cast", "else", "enum",
+    "explicit", "export", "extern", "false", "float", "for", "friend", "goto",
+    "if", "inline", "int", "long", "mutable", "namespace", "new", "noexcept",
+    "not", "not_eq", "nullptr", "operator", "or", "or_eq", "private",
+    "protected", "public", "register", "reinterpret_cast", "requires", "return",
+    "short", "signed", "sizeof", "static", "static_assert", "static_cast",
+    "struct", "switch", "template", "this", "thread_local", "throw", "true",
+    "try", "typedef", "typeid", "typename", "union", "unsigned", "using",
+    "virtual", "void", "volatile", "wchar_t", "while", "xor", "xor_eq",
+};
+
+bool IsCppKeyword(std::string_view name) {
+  return std::binary_search(std::begin(kCppKeywords), std::end(kCppKeywords),
+                            name);
+}
+
+// `SayHello` -> `say_hello`. Names that come out as C++ keywords get a
+// trailing underscore, e.g. `Delete` -> `delete_`.
+std::string ToSnakeCase(const std::string& name) {
+  std::string result;
+  for (std::size_t i = 0; i < name.size(); ++i) {
+    auto c = static_cast<unsigned char>(name[i]);
+    if (std::isupper(c)) {
+      if (i > 0) {
+        result += '_';
+      }
+      result += static_cast<char>(std::tolower(c));
+    } else {
+      result += static_cast<char>(c);
+    }
+  }
+  if (IsCppKeyword(result)) {
+    result += '_';
+  }
+  return result;
+}
+
+std::string HeaderGuard(const std::string& file_name) {
+  std::string guard;
+  for (char c : file_name) {
+    auto uc = static_cast<unsigned char>(c);
+    guard += std::isalnum(uc) ? static_cast<char>(std::toupper(uc)) : '_';
+  }
+  return guard + "_AGRPC_H_";
+}
+
+// The fully qualified C++ name of a message, e.g. `::pkg::Outer_Inner`.
+std::string ClassName(const Descriptor* message) {
+  std::string name = message->name();
+  for (auto* outer = message->containing_type(); outer != nullptr;
+       outer = outer->containing_type()) {
+    name = outer->name() + "_" + name;
+  }
+  const std::string& package = message->file()->package();
+  return package.empty() ? "::" + name
+                         : "::" + DotsToColons(package) + "::" + name;
+}
+
+std::string ResponderType(const MethodDescriptor* method) {
+  std::string request = ClassName(method->input_type());
+  std::string response = ClassName(method->output_type());
+  if (method->client_streaming() && method->server_streaming()) {
+    return "::grpc::ServerAsyncReaderWriter<" + response + ", " + request + ">";
+  }
+  if (method->client_streaming()) {
+    return "::grpc::ServerAsyncReader<" + response + ", " + request + ">";
+  }
+  if (method->server_streaming()) {
+    return "::grpc::ServerAsyncWriter<" + response + ">";
+  }
+  return "::grpc::ServerAsyncResponseWriter<" + response + ">";
+}
+
+Variables MethodVariables(const MethodDescriptor* method) {
+  return {
+      {"service", method->service()->name()},
+      {"method", method->name()},
+      {"option", ToSnakeCase(method->name())},
+      {"request", ClassName(method->input_type())},
+      {"response", ClassName(method->output_type())},
+      {"responder", ResponderType(method)},
+  };
+}
+
+void PrintService(Printer& printer, const ServiceDescriptor* service) {
+  Variables vars{{"service", service->name()}};
+
+  printer.Print(vars,
+                "// `agrpc::serve` options of every method of $service$, "
+                "applied on every\n"
+                "// context.\n"
+                "struct $service$ServeOptions {\n");
+  printer.Indent();
+  for (int i = 0; i < service->method_count(); ++i) {
+    printer.Print(MethodVariables(service->method(i)),
+                  "::agrpc::ServeOptions $option$;\n");
+  }
+  printer.Outdent();
+  printer.Print("};\n\n");
+
+  printer.Print(vars,
+                "// Base of coroutine implementations of $service$. `Derived` "
+                "implements every\n"
+                "// method as\n"
+                "//\n");
+  for (int i = 0; i < service->method_count(); ++i) {
+    printer.Print(
+        MethodVariables(service->method(i)),
+        "//   ::agrpc::task<void> $method$(\n"
+        "//       ::agrpc::GrpcContext::Scheduler scheduler,\n"
+        "//       ::grpc::ServerContext& server_context, $request$& request,\n"
+        "//       $response$& response,\n"
+        "//       $responder$& responder);\n"
+        "//\n");
+  }
+  printer.Print(
+      vars,
+      "// with `request` and `response` taken from a pool, and is started "
+      "with\n"
+      "// `Start$service$`.\n"
+      "template <typename Derived>\n"
+      "class $service$AgrpcBase {\n"
+      " public:\n"
+      "  using AsyncService = $service$::AsyncService;\n"
+      "\n"
+      "  $service$AgrpcBase(const $service$AgrpcBase&) = delete;\n"
+      "  $service$AgrpcBase& operator=(const $service$AgrpcBase&) = "
+      "delete;\n"
+      "\n"
+      "  // To be registered with the server builder.\n"
+      "  AsyncService& async_service() noexcept { return service_; }\n"
+      "\n"
+      " protected:\n"
+      "  $service$AgrpcBase() = default;\n"
+      "  ~$service$AgrpcBase() = default;\n"
+      "\n"
+      " private:\n"
+      "  AsyncService service_;\n"
+      "};\n\n");
+
+  printer.Print(
+      vars,
+      "// Serves every method of `service` on every context of `pool` until "
+      "the server\n"
+      "// is shut down, in tasks spawned into `scope`. Call after building "
+      "the server\n"
+      "// with `service.async_service()` registered.\n"
+      "template <typename Derived>\n"
+      "void Start$service$($service$AgrpcBase<Derived>& service,\n"
+      "    ::agrpc::GrpcContextPool& pool, ::unifex::async_scope& scope,\n"
+      "    const $service$ServeOptions& options = {}) {\n"
+      "  auto& derived = static_cast<Derived&>(service);\n"
+      "  for (std::size_t i = 0; i < pool.size(); ++i) {\n"
+      "    auto scheduler = pool.get_context(i).get_scheduler();\n");
+  printer.Indent();
+  printer.Indent();
+  for (int i = 0; i < service->method_count(); ++i) {
+    printer.Print(
+        MethodVariables(service->method(i)),
+        "scope.spawn(::agrpc::serve(\n"
+        "    scheduler, &$service$::AsyncService::Request$method$,\n"
+        "    service.async_service(),\n"
+        "    [&derived, scheduler](::grpc::ServerContext& server_context,\n"
+        "                          $request$& request,\n"
+        "                          $response$& response,\n"
+        "                          $responder$& responder) {\n"
+        "      return derived.$method$(scheduler, server_context, request,\n"
+        "                              response, responder);\n"
+        "    },\n"
+        "    options.$option$));\n");
+  }
+  printer.Outdent();
+  printer.Outdent();
+  printer.Print("  }\n}\n\n");
+}
+
+class AgrpcGenerator : public CodeGenerator {
+ public:
+  bool Generate(const FileDescriptor* file, const std::string& parameter,
+                GeneratorContext* context,
+                std::string* error) const override {
+    if (file->service_count() == 0) {
+      return true;
+    }
+    std::string base_name = StripProto(file->name());
+    std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> output(
+        context->Open(base_name + ".agrpc.h"));
+    Printer printer(output.get(), '$');
+
+    Variables vars{
+        {"source", file->name()},
+        {"guard", HeaderGuard(base_name)},
+        {"grpc_header", base_name + ".grpc.pb.h"},
+    };
+    printer.Print(vars,
+                  "// Generated by protoc-gen-agrpc. DO NOT EDIT!\n"
+                  "// source: $source$\n"
+                  "\n"
+                  "#ifndef $guard$\n"
+                  "#define $guard$\n"
+                  "\n"
+                  "#include <cstddef>\n"
+                  "\n"
+                  "#include <grpcpp/server_context.h>\n"
+                  "#include <unifex/async_scope.hpp>\n"
+                  "\n"
+                  "#include \"agrpc/context/grpc_context_pool.h\"\n"
+                  "#include \"agrpc/context/serve.h\"\n"
+                  "#include \"agrpc/context/task.h\"\n"
+                  "#include \"$grpc_header$\"\n"
+                  "\n");
+    if (!file->package().empty()) {
+      printer.Print("namespace $namespace$ {\n\n", "namespace",
+                    DotsToColons(file->package()));
+    }
+    for (int i = 0; i < file->service_count(); ++i) {
+      PrintService(printer, file->service(i));
+    }
+    if (!file->package().empty()) {
+      printer.Print("}  // namespace $namespace$\n\n", "namespace",
+                    DotsToColons(file->package()));
+    }
+    printer.Print(vars, "#endif  // $guard$\n");
+    if (printer.failed()) {
+      *error = "Failed to write " + base_name + ".agrpc.h";
+      return false;
+    }
+    return true;
+  }
+};
+
+}  // namespace
+
+}  // namespace agrpc
+
+int main(int argc, char** argv) {
+  agrpc::AgrpcGenerator generator;
+  return google::protobuf::compiler::PluginMain(argc, argv, &generator);
+}
@@ -0,0 +1,70 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/affinity_dispatcher.h"
+
+#include <algorithm>
+
+#include "agrpc/base/logging.h"
+
+namespace agrpc {
+
+AffinityDispatcher::AffinityDispatcher(GrpcContextPool& pool)
+    : stats_(std::make_unique<ContextStats[]>(pool.size())) {
+  AGRPC_CHECK_GT(pool.size(), 0);
+  contexts_.reserve(pool.size());
+  for (std::size_t i = 0; i < pool.size(); ++i) {
+    contexts_.push_back(&pool.get_context(i));
+  }
+}
+
+void AffinityDispatcher::RecordHandoff(
+    std::size_t index, std::chrono::nanoseconds latency) noexcept {
+  auto& stats = stats_[index];
+  auto ns = static_cast<std::uint64_t>(
+      std::max<std::int64_t>(latency.count(), 0));
+  stats.handoffs.Add();
+  stats.handoff_time_ns.Add(ns);
+  std::size_t bucket = ns == 0 ? 0 : 64 - __builtin_clzll(ns);
+  stats.handoff_latency[std::min(bucket, stats.handoff_latency.size() - 1)]
+      .Add();
+}
+
+AffinityDispatcherStats AffinityDispatcher::get_stats() const noexcept {
+  AffinityDispatcherStats result;
+  std::uint64_t handoff_time_ns = 0;
+  for (std::size_t i = 0; i < contexts_.size(); ++i) {
+    const auto& stats = stats_[i];
+    result.local_dispatches += stats.local_dispatches.Read();
+    result.handoffs += stats.handoffs.Read();
+    handoff_time_ns += stats.handoff_time_ns.Read();
+    for (std::size_t j = 0; j < result.handoff_latency.size(); ++j) {
+      result.handoff_latency[j] += stats.handoff_latency[j].Read();
+    }
+  }
+  result.handoff_time = std::chrono::nanoseconds(handoff_time_ns);
+  return result;
+}
+
+std::string_view GetClientMetadata(const grpc::ServerContext& server_context,
+                                   std::string_view name) {
+  const auto& metadata = server_context.client_metadata();
+  auto it = metadata.find(grpc::string_ref(name.data(), name.size()));
+  if (it == metadata.end()) {
+    return {};
+  }
+  return std::string_view(it->second.data(), it->second.size());
+}
+
+}  // namespace agrpc
@@ -0,0 +1,234 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_CONTEXT_AFFINITY_DISPATCHER_H_
+#define AGRPC_CONTEXT_AFFINITY_DISPATCHER_H_
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <grpcpp/server_context.h>
+
+#include <unifex/get_stop_token.hpp>
+#include <unifex/receiver_concepts.hpp>
+#include <unifex/stop_token_concepts.hpp>
+#include <unifex/type_traits.hpp>
+
+#include "agrpc/base/align.h"
+#include "agrpc/base/counter.h"
+#include "agrpc/context/grpc_context.h"
+#include "agrpc/context/grpc_context_pool.h"
+
+namespace agrpc {
+
+struct AffinityDispatcherStats {
+  // Number of buckets of `handoff_latency`.
+  static constexpr std::size_t kLatencyBuckets = 32;
+
+  // Dispatches that were already on the owning context.
+  std::uint64_t local_dispatches = 0;
+  // Dispatches that moved to the owning context.
+  std::uint64_t handoffs = 0;
+  // Total time from starting a handoff to running on the owning context.
+  std::chrono::nanoseconds handoff_time{0};
+  // Histogram of handoff latencies. Bucket `i` counts handoffs that took less
+  // than 2^i nanoseconds, and at least half of that for `i > 0`. The last
+  // bucket also counts everything longer.
+  std::array<std::uint64_t, kLatencyBuckets> handoff_latency{};
+};
+
+// Moves calls to the context that owns their key, so that calls for the same
+// user or shard always run on the same thread and find its `ContextLocal`
+// caches warm. gRPC hands calls to whichever completion queue it likes, so the
+// handler hops over once the request is in:
+//
+//   agrpc::AffinityDispatcher dispatcher{pool};
+//   ...
+//   if (!co_await agrpc::AsyncRequest(scheduler, ..., request, writer)) {
+//     co_return;
+//   }
+//   co_await dispatcher.Dispatch(request.user_id());
+//   // Now on the owning context, use its scheduler from here on.
+//   auto owner = dispatcher.GetOwner(request.user_id()).get_scheduler();
+//
+// gRPC objects of the call may be used from the owning context, but
+// operations on them complete on the context the call was requested on.
+class AffinityDispatcher {
+ public:
+  class DispatchSender;
+
+  // Dispatches over the contexts of `pool`, which must outlive the
+  // dispatcher.
+  explicit AffinityDispatcher(GrpcContextPool& pool);
+
+  AffinityDispatcher(const AffinityDispatcher&) = delete;
+  AffinityDispatcher& operator=(const AffinityDispatcher&) = delete;
+
+  // The context owning `key`.
+  template <typename Key>
+  GrpcContext& GetOwner(const Key& key) noexcept {
+    return *contexts_[GetOwnerIndex(std::hash<Key>{}(key))];
+  }
+
+  // Completes on the context owning `key`. Completes inline if started there
+  // already, otherwise through the owner's remote queue. Completes with done
+  // if stop was requested by the time it gets there.
+  template <typename Key>
+  DispatchSender Dispatch(const Key& key) noexcept;
+
+  // Same as `Dispatch` for a key that has been hashed already.
+  DispatchSender DispatchHash(std::size_t hash) noexcept;
+
+  // Snapshot of the counters summed over all contexts. Safe to call from any
+  // thread.
+  AffinityDispatcherStats get_stats() const noexcept;
+
+ private:
+  using OperationBase = detail::GrpcContextAccess::OperationBase;
+
+  // Only written by the thread of the context with the same index.
+  struct alignas(hardware_destructive_interference_size) ContextStats {
+    SingleWriterCounter local_dispatches;
+    SingleWriterCounter handoffs;
+    SingleWriterCounter handoff_time_ns;
+    std::array<SingleWriterCounter, AffinityDispatcherStats::kLatencyBuckets>
+        handoff_latency;
+  };
+
+  template <typename Receiver>
+  class Operation;
+
+  std::size_t GetOwnerIndex(std::size_t hash) const noexcept;
+
+  void RecordHandoff(std::size_t index,
+                     std::chrono::nanoseconds latency) noexcept;
+
+  std::vector<GrpcContext*> contexts_;
+  std::unique_ptr<ContextStats[]> stats_;
+};
+
+// The value of the client metadata entry `name` of a call, or an empty view if
+// there is none. For dispatching on a key that the client sends as metadata.
+std::string_view GetClientMetadata(const grpc::ServerContext& server_context,
+                                   std::string_view name);
+
+template <typename Receiver>
+class AffinityDispatcher::Operation : private OperationBase {
+ public:
+  template <typename Receiver2>
+  explicit Operation(AffinityDispatcher& dispatcher, std::size_t index,
+                     Receiver2&& r)
+      : dispatcher_(dispatcher), index_(index), receiver_((Receiver2 &&) r) {}
+
+  void start() noexcept {
+    auto& owner = *dispatcher_.contexts_[index_];
+    if (detail::GrpcContextAccess::IsRunningOnThisThread(owner)) {
+      dispatcher_.stats_[index_].local_dispatches.Add();
+      Complete();
+      return;
+    }
+    start_time_ = std::chrono::steady_clock::now();
+    this->execute_ = &Operation::OnArrival;
+    detail::GrpcContextAccess::Schedule(owner,
+                                        static_cast<OperationBase*>(this));
+  }
+
+ private:
+  static void OnArrival(OperationBase* op) noexcept {
+    auto& self = *static_cast<Operation*>(op);
+    self.dispatcher_.RecordHandoff(
+        self.index_, std::chrono::steady_clock::now() - self.start_time_);
+    self.Complete();
+  }
+
+  void Complete() noexcept {
+    if constexpr (!unifex::is_stop_never_possible_v<
+                      unifex::stop_token_type_t<Receiver>>) {
+      if (unifex::get_stop_token(receiver_).stop_requested()) {
+        unifex::set_done(std::move(receiver_));
+        return;
+      }
+    }
+    if constexpr (noexcept(unifex::set_value(std::move(receiver_)))) {
+      unifex::set_value(std::move(receiver_));
+    } else {
+      UNIFEX_TRY { unifex::set_value(std::move(receiver_)); }
+      UNIFEX_CATCH(...) {
+        unifex::set_error(std::move(receiver_), std::current_exception());
+      }
+    }
+  }
+
+  AffinityDispatcher& dispatcher_;
+  std::size_t index_;
+  std::chrono::steady_clock::time_point start_time_;
+  Receiver receiver_;
+};
+
+class AffinityDispatcher::DispatchSender {
+ public:
+  template <template <typename...> class Variant,
+            template <typename...> class Tuple>
+  using value_types = Variant<Tuple<>>;
+
+  template <template <typename...> class Variant>
+  using error_types = Variant<std::exception_ptr>;
+
+  static constexpr bool sends_done = true;
+
+  explicit DispatchSender(AffinityDispatcher& dispatcher,
+                          std::size_t index) noexcept
+      : dispatcher_(dispatcher), index_(index) {}
+
+  template <typename Receiver>
+  Operation<unifex::remove_cvref_t<Receiver>> connect(Receiver&& r) const& {
+    return Operation<unifex::remove_cvref_t<Receiver>>{dispatcher_, index_,
+                                                       (Receiver &&) r};
+  }
+
+ private:
+  AffinityDispatcher& dispatcher_;
+  std::size_t index_;
+};
+
+template <typename Key>
+AffinityDispatcher::DispatchSender AffinityDispatcher::Dispatch(
+    const Key& key) noexcept {
+  return DispatchHash(std::hash<Key>{}(key));
+}
+
+inline AffinityDispatcher::DispatchSender AffinityDispatcher::DispatchHash(
+    std::size_t hash) noexcept {
+  return DispatchSender{*this, GetOwnerIndex(hash)};
+}
+
+inline std::size_t AffinityDispatcher::GetOwnerIndex(
+    std::size_t hash) const noexcept {
+  // `std::hash` of integers is the identity, so mix the bits before taking the
+  // remainder.
+  std::uint64_t mixed = static_cast<std::uint64_t>(hash) * 0x9e3779b97f4a7c15u;
+  return static_cast<std::size_t>((mixed >> 32) % contexts_.size());
+}
+
+}  // namespace agrpc
+
+#endif  // AGRPC_CONTEXT_AFFINITY_DISPATCHER_H_
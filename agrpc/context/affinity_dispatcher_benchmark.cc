@@ -0,0 +1,134 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/affinity_dispatcher.h"
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/task.hpp>
+
+#include "benchmark/benchmark.h"
+
+#include "agrpc/base/counter.h"
+#include "agrpc/context/context_local.h"
+#include "agrpc/context/grpc_context_pool.h"
+
+// Calls for a fixed set of keys arrive on the contexts of a pool in turn, like
+// gRPC spreads them over its completion queues. Each call looks its key up in
+// a per-context cache that holds a quarter of the keys. Without affinity every
+// context sees every key; with it each context only sees the keys it owns,
+// which fit into its cache.
+
+namespace agrpc {
+
+namespace {
+
+constexpr std::size_t kContexts = 4;
+constexpr std::size_t kKeys = 4096;
+constexpr std::size_t kCacheSlots = kKeys / kContexts;
+
+// Direct-mapped cache of keys.
+class KeyCache {
+ public:
+  KeyCache() : slots_(kCacheSlots, ~std::uint64_t{0}) {}
+
+  void Lookup(std::uint64_t key) noexcept {
+    auto& slot = slots_[key % slots_.size()];
+    if (slot == key) {
+      hits_.Add();
+    } else {
+      misses_.Add();
+      slot = key;
+    }
+  }
+
+  std::uint64_t hits() const noexcept { return hits_.Read(); }
+  std::uint64_t misses() const noexcept { return misses_.Read(); }
+
+ private:
+  std::vector<std::uint64_t> slots_;
+  SingleWriterCounter hits_;
+  SingleWriterCounter misses_;
+};
+
+// Intentionally leaked, the run threads live until the process exits.
+GrpcContextPool& GetRunningPool() {
+  static auto* pool = [] {
+    auto* pool = new GrpcContextPool{kContexts};
+    pool->Start();
+    return pool;
+  }();
+  return *pool;
+}
+
+unifex::task<void> HandleCall(GrpcContext::Scheduler arrival,
+                              AffinityDispatcher* dispatcher,
+                              ContextLocal<KeyCache>& cache,
+                              std::uint64_t key) {
+  co_await unifex::schedule(arrival);
+  if (dispatcher) {
+    co_await dispatcher->Dispatch(key);
+  }
+  cache->Lookup(key);
+}
+
+void RunCalls(benchmark::State& state, bool with_affinity) {
+  auto& pool = GetRunningPool();
+  AffinityDispatcher dispatcher{pool};
+  ContextLocal<KeyCache> cache;
+  std::mt19937_64 random{42};
+  std::uniform_int_distribution<std::uint64_t> keys{0, kKeys - 1};
+
+  while (state.KeepRunning()) {
+    unifex::sync_wait(HandleCall(pool.get_next_scheduler(),
+                                 with_affinity ? &dispatcher : nullptr, cache,
+                                 keys(random)));
+  }
+
+  std::uint64_t hits = 0;
+  std::uint64_t misses = 0;
+  cache.ForEach([&](GrpcContext&, const KeyCache& c) {
+    hits += c.hits();
+    misses += c.misses();
+  });
+  state.counters["hit_rate"] =
+      static_cast<double>(hits) / static_cast<double>(hits + misses);
+  auto stats = dispatcher.get_stats();
+  if (stats.handoffs != 0) {
+    state.counters["handoff_ns"] =
+        static_cast<double>(stats.handoff_time.count()) /
+        static_cast<double>(stats.handoffs);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+}  // namespace
+
+void Benchmark_CacheWithoutAffinity(benchmark::State& state) {
+  RunCalls(state, false);
+}
+
+BENCHMARK(Benchmark_CacheWithoutAffinity)->UseRealTime();
+
+void Benchmark_CacheWithAffinity(benchmark::State& state) {
+  RunCalls(state, true);
+}
+
+BENCHMARK(Benchmark_CacheWithAffinity)->UseRealTime();
+
+}  // namespace agrpc
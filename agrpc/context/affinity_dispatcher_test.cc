@@ -0,0 +1,151 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/affinity_dispatcher.h"
+
+#include <chrono>
+#include <cstdint>
+#include <set>
+#include <thread>
+
+#include <unifex/inplace_stop_token.hpp>
+#include <unifex/let_value.hpp>
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/then.hpp>
+#include <unifex/with_query_value.hpp>
+
+#include "gtest/gtest.h"
+
+namespace agrpc {
+namespace {
+
+std::thread::id GetRunThread(GrpcContext& context) {
+  return *unifex::sync_wait(
+      unifex::then(unifex::schedule(context.get_scheduler()),
+                   [] { return std::this_thread::get_id(); }));
+}
+
+class AffinityDispatcherTest : public ::testing::Test {
+ protected:
+  AffinityDispatcherTest() { pool_.Start(); }
+
+  ~AffinityDispatcherTest() override {
+    pool_.ShutDown();
+    pool_.Join();
+  }
+
+  // Dispatches `key` from the run loop of `from` and returns the thread it
+  // completed on.
+  std::thread::id DispatchFrom(GrpcContext& from, int key) {
+    return *unifex::sync_wait(unifex::let_value(
+        unifex::schedule(from.get_scheduler()), [&, key] {
+          return unifex::then(dispatcher_.Dispatch(key), [] {
+            return std::this_thread::get_id();
+          });
+        }));
+  }
+
+  // A context that does not own `key`.
+  GrpcContext& GetOther(int key) {
+    auto& owner = dispatcher_.GetOwner(key);
+    return &owner == &pool_.get_context(0) ? pool_.get_context(1)
+                                           : pool_.get_context(0);
+  }
+
+  GrpcContextPool pool_{2};
+  AffinityDispatcher dispatcher_{pool_};
+};
+
+TEST_F(AffinityDispatcherTest, OwnerIsStablePerKey) {
+  std::set<GrpcContext*> owners;
+  for (int key = 0; key < 64; ++key) {
+    auto& owner = dispatcher_.GetOwner(key);
+    ASSERT_EQ(&dispatcher_.GetOwner(key), &owner);
+    owners.insert(&owner);
+  }
+  // Keys are spread over all contexts.
+  ASSERT_EQ(owners.size(), pool_.size());
+}
+
+TEST_F(AffinityDispatcherTest, DispatchOnTheOwnerCompletesInline) {
+  constexpr int kKey = 7;
+  auto& owner = dispatcher_.GetOwner(kKey);
+  ASSERT_EQ(DispatchFrom(owner, kKey), GetRunThread(owner));
+
+  auto stats = dispatcher_.get_stats();
+  ASSERT_EQ(stats.local_dispatches, 1);
+  ASSERT_EQ(stats.handoffs, 0);
+}
+
+TEST_F(AffinityDispatcherTest, DispatchFromAnotherContextHandsOff) {
+  constexpr int kKey = 7;
+  auto& owner = dispatcher_.GetOwner(kKey);
+  ASSERT_EQ(DispatchFrom(GetOther(kKey), kKey), GetRunThread(owner));
+
+  auto stats = dispatcher_.get_stats();
+  ASSERT_EQ(stats.local_dispatches, 0);
+  ASSERT_EQ(stats.handoffs, 1);
+}
+
+TEST_F(AffinityDispatcherTest, DispatchFromOutsideHandsOff) {
+  constexpr int kKey = 7;
+  auto thread = unifex::sync_wait(unifex::then(
+      dispatcher_.Dispatch(kKey), [] { return std::this_thread::get_id(); }));
+  ASSERT_EQ(*thread, GetRunThread(dispatcher_.GetOwner(kKey)));
+  ASSERT_EQ(dispatcher_.get_stats().handoffs, 1);
+}
+
+TEST_F(AffinityDispatcherTest, DispatchCompletesWithDoneOnStop) {
+  unifex::inplace_stop_source stop_source;
+  stop_source.request_stop();
+  auto result = unifex::sync_wait(unifex::with_query_value(
+      dispatcher_.Dispatch(7), unifex::get_stop_token,
+      stop_source.get_token()));
+  ASSERT_FALSE(result.has_value());
+}
+
+TEST_F(AffinityDispatcherTest, LatencyHistogramAccountsForEveryHandoff) {
+  constexpr int kHandoffs = 100;
+  for (int i = 0; i < kHandoffs; ++i) {
+    DispatchFrom(GetOther(i), i);
+  }
+
+  auto stats = dispatcher_.get_stats();
+  ASSERT_EQ(stats.handoffs, kHandoffs);
+  std::uint64_t counted = 0;
+  // Bucket `i` holds latencies in [2^(i-1), 2^i), so the bucket bounds bracket
+  // the total handoff time.
+  std::chrono::nanoseconds lower{0};
+  std::chrono::nanoseconds upper{0};
+  for (std::size_t i = 0; i < stats.handoff_latency.size(); ++i) {
+    auto count = stats.handoff_latency[i];
+    counted += count;
+    if (i > 0) {
+      lower += std::chrono::nanoseconds(count << (i - 1));
+    }
+    if (i + 1 < stats.handoff_latency.size()) {
+      upper += std::chrono::nanoseconds(count << i);
+    } else {
+      upper = std::chrono::nanoseconds::max();
+    }
+  }
+  ASSERT_EQ(counted, kHandoffs);
+  ASSERT_GT(stats.handoff_time.count(), 0);
+  ASSERT_LE(lower, stats.handoff_time);
+  ASSERT_GE(upper, stats.handoff_time);
+}
+
+}  // namespace
+}  // namespace agrpc
@@ -0,0 +1,121 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/arena_pool.h"
+
+#include <algorithm>
+
+#include "agrpc/base/logging.h"
+
+namespace agrpc {
+
+namespace {
+
+google::protobuf::ArenaOptions MakeArenaOptions(char* initial_block,
+                                                std::size_t size) {
+  google::protobuf::ArenaOptions options;
+  options.initial_block = initial_block;
+  options.initial_block_size = size;
+  // Blocks beyond the initial one grow from its size.
+  options.start_block_size = size;
+  return options;
+}
+
+// Outgrown idle arenas freed by one `Acquire` at most.
+constexpr std::size_t kMaxFreedPerAcquire = 4;
+
+std::size_t GetBytesBucket(std::size_t bytes) noexcept {
+  std::size_t bucket = bytes == 0 ? 0 : 64 - __builtin_clzll(bytes);
+  return std::min(bucket, ArenaPoolStats::kBytesBuckets - 1);
+}
+
+}  // namespace
+
+ArenaPool::PooledArena::PooledArena(std::size_t block_size)
+    : initial_block(new char[block_size]),
+      initial_block_size(block_size),
+      arena(MakeArenaOptions(initial_block.get(), block_size)) {}
+
+ArenaPool::ArenaPool(ArenaPoolOptions options) : options_(options) {
+  // Smaller initial blocks cannot even hold the arena's block header.
+  AGRPC_CHECK_GE(options_.min_initial_block_size, 64);
+  AGRPC_CHECK_GE(options_.max_initial_block_size,
+                 options_.min_initial_block_size);
+}
+
+ArenaPool::~ArenaPool() = default;
+
+ArenaPool::Lease ArenaPool::Acquire() {
+  auto& free_list = free_lists_.get();
+  std::size_t block_size = GetInitialBlockSize(free_list);
+  for (std::size_t freed = 0;
+       freed < kMaxFreedPerAcquire && !free_list.arenas.empty(); ++freed) {
+    auto arena = std::move(free_list.arenas.back());
+    free_list.arenas.pop_back();
+    free_list.idle.store(free_list.arenas.size(), std::memory_order_relaxed);
+    if (arena->initial_block_size >= block_size) {
+      free_list.hits.Add();
+      return Lease{*this, std::move(arena)};
+    }
+    // Calls have grown since this arena was built, so it is freed and a bigger
+    // one is built instead.
+  }
+  free_list.misses.Add();
+  return Lease{*this, std::make_unique<PooledArena>(block_size)};
+}
+
+void ArenaPool::Release(std::unique_ptr<PooledArena> arena) noexcept {
+  std::size_t bytes_used = arena->arena.SpaceUsed();
+  arena->arena.Reset();
+  if (detail::GrpcContextAccess::GetCurrent() == nullptr) {
+    return;
+  }
+  auto& free_list = free_lists_.get();
+  free_list.bytes_used[GetBytesBucket(bytes_used)].Add();
+  // Let the estimate follow the largest recent call and decay by 1/16 per call
+  // otherwise, so that one outlier does not size arenas forever.
+  free_list.recent_bytes_used =
+      std::max(bytes_used, free_list.recent_bytes_used -
+                               free_list.recent_bytes_used / 16);
+  if (free_list.arenas.size() < options_.max_idle) {
+    free_list.arenas.push_back(std::move(arena));
+    free_list.idle.store(free_list.arenas.size(), std::memory_order_relaxed);
+  }
+}
+
+std::size_t ArenaPool::GetInitialBlockSize(
+    const FreeList& free_list) const noexcept {
+  std::size_t size =
+      std::clamp(free_list.recent_bytes_used, options_.min_initial_block_size,
+                 options_.max_initial_block_size);
+  // Round up to a power of two, so that small changes in usage do not make
+  // every idle arena too small.
+  std::size_t rounded = std::size_t{1} << (64 - __builtin_clzll(size - 1));
+  return std::min(rounded, options_.max_initial_block_size);
+}
+
+ArenaPoolStats ArenaPool::get_stats() const {
+  ArenaPoolStats stats;
+  free_lists_.ForEach([&](GrpcContext&, const FreeList& free_list) {
+    stats.hits += free_list.hits.Read();
+    stats.misses += free_list.misses.Read();
+    stats.idle += free_list.idle.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < ArenaPoolStats::kBytesBuckets; ++i) {
+      stats.bytes_used[i] += free_list.bytes_used[i].Read();
+    }
+  });
+  return stats;
+}
+
+}  // namespace agrpc
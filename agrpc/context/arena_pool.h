@@ -0,0 +1,181 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_CONTEXT_ARENA_POOL_H_
+#define AGRPC_CONTEXT_ARENA_POOL_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <google/protobuf/arena.h>
+
+#include "agrpc/base/counter.h"
+#include "agrpc/context/context_local.h"
+
+namespace agrpc {
+
+struct ArenaPoolOptions {
+  // Bounds of the initial block of an arena. Within them, the initial block is
+  // sized from the bytes recent calls used on the same context, rounded up to
+  // a power of two.
+  std::size_t min_initial_block_size = 512;
+  std::size_t max_initial_block_size = 64 * 1024;
+
+  // High-water mark of idle arenas per context. Arenas released while it is
+  // reached are freed instead.
+  std::size_t max_idle = 256;
+};
+
+struct ArenaPoolStats {
+  // Number of buckets of `bytes_used`.
+  static constexpr std::size_t kBytesBuckets = 32;
+
+  // Leases that reused an idle arena as is.
+  std::uint64_t hits = 0;
+  // Leases that built a new arena, because none was idle or the idle ones'
+  // initial blocks were too small.
+  std::uint64_t misses = 0;
+  // Arenas idle in the pool right now.
+  std::uint64_t idle = 0;
+  // Histogram of the bytes used per lease. Bucket `i` counts leases that used
+  // less than 2^i bytes, and at least half of that for `i > 0`. The last
+  // bucket also counts everything larger.
+  std::array<std::uint64_t, kBytesBuckets> bytes_used{};
+};
+
+// Recycles `google::protobuf::Arena`s for the messages of one method, so that
+// a call's messages come out of one block that is reset in one go instead of
+// being built from and freed to the heap field by field:
+//
+//   agrpc::ArenaPool arenas;
+//   ...
+//   agrpc::ArenaPool::Lease lease = arenas.Acquire();
+//   auto* request = lease.Create<helloworld::HelloRequest>();
+//   auto* reply = lease.Create<helloworld::HelloReply>();
+//   ... any AsyncRead, AsyncWrite or AsyncFinish using them ...
+//   // The lease resets the arena and gives it back when destroyed.
+//
+// Arena-owned messages work with all senders, gRPC parses into and
+// serializes from them as usual. They must not be used after their lease is
+// gone. Each context keeps its own free list, which only its run loop thread
+// touches. One pool per method gives every method its own block sizes and
+// histogram.
+class ArenaPool {
+ private:
+  // An arena whose initial block is allocated with it, so that a reset keeps
+  // that block.
+  struct PooledArena {
+    explicit PooledArena(std::size_t block_size);
+
+    std::unique_ptr<char[]> initial_block;
+    std::size_t initial_block_size;
+    google::protobuf::Arena arena;
+  };
+
+ public:
+  class Lease;
+
+  explicit ArenaPool(ArenaPoolOptions options = {});
+
+  ArenaPool(const ArenaPool&) = delete;
+  ArenaPool& operator=(const ArenaPool&) = delete;
+
+  ~ArenaPool();
+
+  // An idle arena of the current context, or a new one if there is none. Must
+  // be called from a context's run loop. Idle arenas that calls have outgrown
+  // are freed as they come up, a few per call, so that a jump in call size
+  // does not make one call free the whole list.
+  Lease Acquire();
+
+  // Snapshot of the counters summed over all contexts. Safe to call from any
+  // thread.
+  ArenaPoolStats get_stats() const;
+
+ private:
+  struct FreeList {
+    std::vector<std::unique_ptr<PooledArena>> arenas;
+    // Size of `arenas`, readable from other threads.
+    std::atomic<std::size_t> idle{0};
+    // Decaying maximum of the bytes used by recent leases.
+    std::size_t recent_bytes_used = 0;
+    SingleWriterCounter hits;
+    SingleWriterCounter misses;
+    std::array<SingleWriterCounter, ArenaPoolStats::kBytesBuckets> bytes_used;
+  };
+
+  void Release(std::unique_ptr<PooledArena> arena) noexcept;
+
+  std::size_t GetInitialBlockSize(const FreeList& free_list) const noexcept;
+
+  ArenaPoolOptions options_;
+  ContextLocal<FreeList> free_lists_;
+};
+
+// Exclusive use of one arena of an `ArenaPool` until destroyed.
+class ArenaPool::Lease {
+ public:
+  Lease() = default;
+
+  Lease(Lease&& other) noexcept
+      : pool_(std::exchange(other.pool_, nullptr)),
+        arena_(std::move(other.arena_)) {}
+
+  Lease& operator=(Lease&& other) noexcept {
+    if (this != &other) {
+      Reset();
+      pool_ = std::exchange(other.pool_, nullptr);
+      arena_ = std::move(other.arena_);
+    }
+    return *this;
+  }
+
+  ~Lease() { Reset(); }
+
+  explicit operator bool() const noexcept { return arena_ != nullptr; }
+
+  google::protobuf::Arena& arena() noexcept { return arena_->arena; }
+
+  // A new message of type `T` owned by the arena.
+  template <typename T>
+  T* Create() {
+    return google::protobuf::Arena::CreateMessage<T>(&arena());
+  }
+
+  // Resets the arena and gives it back to the pool, which invalidates all
+  // messages created on it.
+  void Reset() noexcept {
+    if (arena_ != nullptr) {
+      std::exchange(pool_, nullptr)->Release(std::move(arena_));
+    }
+  }
+
+ private:
+  friend ArenaPool;
+
+  Lease(ArenaPool& pool, std::unique_ptr<PooledArena> arena) noexcept
+      : pool_(&pool), arena_(std::move(arena)) {}
+
+  ArenaPool* pool_ = nullptr;
+  std::unique_ptr<PooledArena> arena_;
+};
+
+}  // namespace agrpc
+
+#endif  // AGRPC_CONTEXT_ARENA_POOL_H_
@@ -0,0 +1,196 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/arena_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unifex/task.hpp>
+#include <unifex/then.hpp>
+
+#include "gtest/gtest.h"
+
+#include "agrpc/context/rpcs.h"
+#include "agrpc/testing/echo.grpc.pb.h"
+#include "agrpc/testing/echo_server_fixture.h"
+#include "agrpc/testing/grpc_context_helpers.h"
+
+namespace agrpc {
+namespace {
+
+using testing::EchoRequest;
+using testing::EchoResponse;
+using testing::EchoService;
+using testing::RunOnContext;
+using testing::ShutDownAndDrain;
+
+std::uint64_t Sum(const ArenaPoolStats& stats) {
+  std::uint64_t total = 0;
+  for (auto count : stats.bytes_used) {
+    total += count;
+  }
+  return total;
+}
+
+TEST(ArenaPool, CreatesMessagesOnTheArena) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  ArenaPool pool;
+
+  RunOnContext(context, [&] {
+    auto lease = pool.Acquire();
+    auto* request = lease.Create<EchoRequest>();
+    ASSERT_EQ(request->GetArena(), &lease.arena());
+    request->set_message("hello");
+    EchoRequest copy;
+    ASSERT_TRUE(copy.ParseFromString(request->SerializeAsString()));
+    ASSERT_EQ(copy.message(), "hello");
+  });
+
+  ShutDownAndDrain(context);
+}
+
+TEST(ArenaPool, ReusesReleasedArenas) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  ArenaPool pool;
+
+  RunOnContext(context, [&] {
+    google::protobuf::Arena* first = nullptr;
+    {
+      auto lease = pool.Acquire();
+      first = &lease.arena();
+      lease.Create<EchoRequest>()->set_message("hello");
+    }
+    auto lease = pool.Acquire();
+    ASSERT_EQ(&lease.arena(), first);
+    ASSERT_EQ(lease.arena().SpaceUsed(), 0);
+  });
+
+  auto stats = pool.get_stats();
+  ASSERT_EQ(stats.hits, 1);
+  ASSERT_EQ(stats.misses, 1);
+  ASSERT_EQ(Sum(stats), 2);
+
+  ShutDownAndDrain(context);
+}
+
+TEST(ArenaPool, SizesInitialBlockFromRecentCalls) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  ArenaPool pool{{.min_initial_block_size = 512,
+                  .max_initial_block_size = 64 * 1024}};
+
+  RunOnContext(context, [&] {
+    {
+      auto lease = pool.Acquire();
+      lease.Create<EchoRequest>()->set_message(
+          std::string(16 * 1024, 'x'));
+    }
+    // The idle arena's initial block is too small for calls this size, so it
+    // is rebuilt.
+    auto lease = pool.Acquire();
+  });
+
+  auto stats = pool.get_stats();
+  ASSERT_EQ(stats.hits, 0);
+  ASSERT_EQ(stats.misses, 2);
+
+  ShutDownAndDrain(context);
+}
+
+TEST(ArenaPool, FreesAFewOutgrownArenasPerAcquire) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  ArenaPool pool{{.min_initial_block_size = 512,
+                  .max_initial_block_size = 64 * 1024}};
+
+  RunOnContext(context, [&] {
+    {
+      std::vector<ArenaPool::Lease> leases;
+      for (int i = 0; i < 8; ++i) {
+        leases.push_back(pool.Acquire());
+      }
+    }
+    ASSERT_EQ(pool.get_stats().idle, 8);
+    {
+      auto lease = pool.Acquire();
+      lease.Create<EchoRequest>()->set_message(std::string(16 * 1024, 'x'));
+    }
+    // All idle arenas are too small now, but only some are freed at once.
+    auto lease = pool.Acquire();
+    auto idle = pool.get_stats().idle;
+    ASSERT_GT(idle, 0);
+    ASSERT_LT(idle, 8);
+  });
+
+  ShutDownAndDrain(context);
+}
+
+class ArenaPoolStreamTest : public testing::EchoServerFixture {
+ protected:
+  // Echoes the messages of one `EchoStream` call, reading and writing them
+  // through messages on a leased arena.
+  unifex::task<void> EchoOnArena(ArenaPool& pool) {
+    grpc::ServerContext server_context;
+    grpc::ServerAsyncReaderWriter<EchoResponse, EchoRequest> stream{
+        &server_context};
+    if (!co_await AsyncRequest(scheduler(),
+                               &EchoService::AsyncService::RequestEchoStream,
+                               service_, server_context, stream)) {
+      co_return;
+    }
+    auto lease = pool.Acquire();
+    auto* request = lease.Create<EchoRequest>();
+    auto* response = lease.Create<EchoResponse>();
+    while (co_await AsyncRead(scheduler(), stream, *request)) {
+      EXPECT_EQ(request->GetArena(), &lease.arena());
+      response->set_message(request->message());
+      co_await AsyncWrite(scheduler(), stream, *response);
+    }
+    co_await AsyncFinish(scheduler(), stream, grpc::Status::OK);
+  }
+};
+
+TEST_F(ArenaPoolStreamTest, ReadsAndWritesArenaMessages) {
+  ArenaPool pool{{.min_initial_block_size = 512}};
+  std::atomic<bool> served{false};
+  scope_.spawn(unifex::then(EchoOnArena(pool), [&] { served = true; }));
+
+  grpc::ClientContext client_context;
+  auto stream = stub_->EchoStream(&client_context);
+  for (std::size_t size : {16, 4 * 1024, 32 * 1024}) {
+    EchoRequest request;
+    request.set_message(std::string(size, 'x'));
+    ASSERT_TRUE(stream->Write(request));
+    EchoResponse response;
+    ASSERT_TRUE(stream->Read(&response));
+    ASSERT_EQ(response.message(), request.message());
+  }
+  ASSERT_TRUE(stream->WritesDone());
+  ASSERT_TRUE(stream->Finish().ok());
+  while (!served) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  // One arena served the whole call and was given back once.
+  auto stats = pool.get_stats();
+  ASSERT_EQ(stats.misses, 1);
+  ASSERT_EQ(Sum(stats), 1);
+}
+
+}  // namespace
+}  // namespace agrpc
@@ -0,0 +1,46 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/async_manual_reset_event.h"
+
+namespace agrpc {
+
+bool AsyncManualResetEvent::IsSetOrEnqueue(
+    detail::AsyncWaiter* waiter) noexcept {
+  void* old_state = state_.load(std::memory_order_acquire);
+  do {
+    if (old_state == this) {
+      return true;
+    }
+    waiter->next_waiter_ = static_cast<detail::AsyncWaiter*>(old_state);
+  } while (!state_.compare_exchange_weak(old_state, waiter,
+                                         std::memory_order_release,
+                                         std::memory_order_acquire));
+  return false;
+}
+
+void AsyncManualResetEvent::Set() noexcept {
+  void* old_state = state_.exchange(this, std::memory_order_acq_rel);
+  if (old_state != this && old_state != nullptr) {
+    detail::ResumeWaiters(
+        detail::ReverseWaiters(static_cast<detail::AsyncWaiter*>(old_state)));
+  }
+}
+
+void AsyncManualResetEvent::Reset() noexcept {
+  void* expected = this;
+  state_.compare_exchange_strong(expected, nullptr, std::memory_order_relaxed);
+}
+
+}  // namespace agrpc
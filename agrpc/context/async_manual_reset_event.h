@@ -0,0 +1,127 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_CONTEXT_ASYNC_MANUAL_RESET_EVENT_H_
+#define AGRPC_CONTEXT_ASYNC_MANUAL_RESET_EVENT_H_
+
+#include <atomic>
+#include <exception>
+#include <utility>
+
+#include <unifex/type_traits.hpp>
+
+#include "agrpc/context/async_waiter.h"
+
+namespace agrpc {
+
+// An event that handlers on any `GrpcContext` can wait for, e.g. until a
+// shared cache has been loaded:
+//
+//   co_await cache_loaded.Wait();
+//
+// Waiting on a set event completes inline. Otherwise the handler is suspended
+// and resumed on its own context once the event is set; waiters on the same
+// context are handed over together. Everything is lock-free and waiting
+// allocates nothing. Waiting cannot be cancelled.
+class AsyncManualResetEvent {
+ public:
+  class WaitSender;
+
+  explicit AsyncManualResetEvent(bool initially_set = false) noexcept
+      : state_(initially_set ? static_cast<void*>(this) : nullptr) {}
+
+  AsyncManualResetEvent(const AsyncManualResetEvent&) = delete;
+  AsyncManualResetEvent& operator=(const AsyncManualResetEvent&) = delete;
+
+  // Completes once the event is set.
+  WaitSender Wait() noexcept;
+
+  bool is_set() const noexcept {
+    return state_.load(std::memory_order_acquire) == this;
+  }
+
+  // Sets the event and resumes all waiters. Thread-safe.
+  void Set() noexcept;
+
+  // Clears the event if it is set. Thread-safe.
+  void Reset() noexcept;
+
+ private:
+  template <typename Receiver>
+  class Operation;
+
+  // Waits for the event and returns false, or returns true if it is set.
+  bool IsSetOrEnqueue(detail::AsyncWaiter* waiter) noexcept;
+
+  // `this` if set, otherwise null or the top of a stack of waiters.
+  std::atomic<void*> state_;
+};
+
+template <typename Receiver>
+class AsyncManualResetEvent::Operation : private detail::AsyncWaiter {
+  using OperationBase = detail::GrpcContextAccess::OperationBase;
+
+ public:
+  template <typename Receiver2>
+  explicit Operation(AsyncManualResetEvent& event, Receiver2&& r)
+      : event_(event), receiver_((Receiver2 &&) r) {}
+
+  void start() noexcept {
+    this->context_ = detail::GrpcContextAccess::GetCurrent();
+    this->execute_ = &Operation::OnSet;
+    if (event_.IsSetOrEnqueue(this)) {
+      detail::SetValueOrError(std::move(receiver_));
+    }
+  }
+
+ private:
+  static void OnSet(OperationBase* op) noexcept {
+    detail::SetValueOrError(std::move(static_cast<Operation*>(op)->receiver_));
+  }
+
+  AsyncManualResetEvent& event_;
+  Receiver receiver_;
+};
+
+class AsyncManualResetEvent::WaitSender {
+ public:
+  template <template <typename...> class Variant,
+            template <typename...> class Tuple>
+  using value_types = Variant<Tuple<>>;
+
+  template <template <typename...> class Variant>
+  using error_types = Variant<std::exception_ptr>;
+
+  static constexpr bool sends_done = false;
+
+  explicit WaitSender(AsyncManualResetEvent& event) noexcept : event_(event) {}
+
+  template <typename Receiver>
+  Operation<unifex::remove_cvref_t<Receiver>> connect(Receiver&& r) const& {
+    return Operation<unifex::remove_cvref_t<Receiver>>{event_,
+                                                       (Receiver &&) r};
+  }
+
+ private:
+  AsyncManualResetEvent& event_;
+};
+
+inline AsyncManualResetEvent::WaitSender
+AsyncManualResetEvent::Wait() noexcept {
+  return WaitSender{*this};
+}
+
+}  // namespace agrpc
+
+#endif  // AGRPC_CONTEXT_ASYNC_MANUAL_RESET_EVENT_H_
@@ -0,0 +1,75 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/async_manual_reset_event.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/task.hpp>
+
+#include "gtest/gtest.h"
+
+#include "agrpc/context/grpc_context_pool.h"
+
+namespace agrpc {
+namespace {
+
+TEST(AsyncManualResetEvent, WaitOnSetEventCompletesInline) {
+  AsyncManualResetEvent event{true};
+  ASSERT_TRUE(event.is_set());
+  unifex::sync_wait(event.Wait());
+  event.Reset();
+  ASSERT_FALSE(event.is_set());
+}
+
+unifex::task<void> WaitOn(GrpcContext::Scheduler scheduler,
+                          AsyncManualResetEvent& event,
+                          std::atomic<int>& resumed) {
+  co_await unifex::schedule(scheduler);
+  co_await event.Wait();
+  resumed.fetch_add(1);
+}
+
+TEST(AsyncManualResetEvent, SetResumesAllWaiters) {
+  constexpr int kWaiters = 8;
+  GrpcContextPool pool{2};
+  pool.Start();
+
+  AsyncManualResetEvent event;
+  std::atomic<int> resumed{0};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kWaiters; ++i) {
+    threads.emplace_back([&, scheduler = pool.get_next_scheduler()] {
+      unifex::sync_wait(WaitOn(scheduler, event, resumed));
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  ASSERT_EQ(resumed.load(), 0);
+  event.Set();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(resumed.load(), kWaiters);
+
+  pool.ShutDown();
+  pool.Join();
+}
+
+}  // namespace
+}  // namespace agrpc
@@ -0,0 +1,64 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/async_mutex.h"
+
+#include "agrpc/base/logging.h"
+
+namespace agrpc {
+
+AsyncMutex::~AsyncMutex() {
+  AGRPC_CHECK(state_.load(std::memory_order_relaxed) == kNotLocked,
+              "AsyncMutex destroyed while locked.");
+}
+
+bool AsyncMutex::LockOrEnqueue(detail::AsyncWaiter* waiter) noexcept {
+  auto old_state = state_.load(std::memory_order_acquire);
+  while (true) {
+    if (old_state == kNotLocked) {
+      if (state_.compare_exchange_weak(old_state, kLockedNoWaiters,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed)) {
+        return true;
+      }
+    } else {
+      waiter->next_waiter_ = reinterpret_cast<detail::AsyncWaiter*>(old_state);
+      if (state_.compare_exchange_weak(
+              old_state, reinterpret_cast<std::uintptr_t>(waiter),
+              std::memory_order_release, std::memory_order_relaxed)) {
+        return false;
+      }
+    }
+  }
+}
+
+void AsyncMutex::Unlock() noexcept {
+  auto* next = waiters_;
+  if (!next) {
+    auto old_state = kLockedNoWaiters;
+    if (state_.compare_exchange_strong(old_state, kNotLocked,
+                                       std::memory_order_release,
+                                       std::memory_order_relaxed)) {
+      return;
+    }
+    // Waiters arrived meanwhile. Take them over, the lock stays held.
+    old_state = state_.exchange(kLockedNoWaiters, std::memory_order_acquire);
+    next = detail::ReverseWaiters(
+        reinterpret_cast<detail::AsyncWaiter*>(old_state));
+  }
+  waiters_ = next->next_waiter_;
+  detail::ResumeWaiter(next);
+}
+
+}  // namespace agrpc
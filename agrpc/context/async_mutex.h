@@ -0,0 +1,142 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_CONTEXT_ASYNC_MUTEX_H_
+#define AGRPC_CONTEXT_ASYNC_MUTEX_H_
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <utility>
+
+#include <unifex/type_traits.hpp>
+
+#include "agrpc/context/async_waiter.h"
+
+namespace agrpc {
+
+// A mutex for handlers on different `GrpcContext`s. Instead of blocking the run
+// loop, a handler that finds it locked is suspended and resumed on its own
+// context once it holds the lock:
+//
+//   co_await mutex.Lock();
+//   ... touch the shared state ...
+//   mutex.Unlock();
+//
+// Locking an unlocked mutex and unlocking one without waiters is a single CAS,
+// and waiting allocates nothing. Waiters get the lock in the order they
+// arrived. Waiting cannot be cancelled.
+class AsyncMutex {
+ public:
+  class LockSender;
+
+  AsyncMutex() noexcept = default;
+
+  AsyncMutex(const AsyncMutex&) = delete;
+  AsyncMutex& operator=(const AsyncMutex&) = delete;
+
+  // Must not be destroyed while locked.
+  ~AsyncMutex();
+
+  // Completes once the lock is held. Completes inline if the mutex is
+  // unlocked, otherwise on the context it was started on.
+  LockSender Lock() noexcept;
+
+  // Returns whether the lock was acquired.
+  bool TryLock() noexcept;
+
+  // Hands the lock over to the next waiter, if any. Must only be called by the
+  // holder, from any thread.
+  void Unlock() noexcept;
+
+ private:
+  template <typename Receiver>
+  class Operation;
+
+  static constexpr std::uintptr_t kNotLocked = 1;
+  static constexpr std::uintptr_t kLockedNoWaiters = 0;
+
+  // Locks the mutex and returns true, or queues `waiter` and returns false.
+  bool LockOrEnqueue(detail::AsyncWaiter* waiter) noexcept;
+
+  // Either `kNotLocked`, `kLockedNoWaiters` or the top of a stack of waiters
+  // that arrived since the holder last looked.
+  std::atomic<std::uintptr_t> state_{kNotLocked};
+  // Waiters in arrival order, only accessed by the holder.
+  detail::AsyncWaiter* waiters_ = nullptr;
+};
+
+template <typename Receiver>
+class AsyncMutex::Operation : private detail::AsyncWaiter {
+  using OperationBase = detail::GrpcContextAccess::OperationBase;
+
+ public:
+  template <typename Receiver2>
+  explicit Operation(AsyncMutex& mutex, Receiver2&& r)
+      : mutex_(mutex), receiver_((Receiver2 &&) r) {}
+
+  void start() noexcept {
+    this->context_ = detail::GrpcContextAccess::GetCurrent();
+    this->execute_ = &Operation::OnLocked;
+    if (mutex_.LockOrEnqueue(this)) {
+      detail::SetValueOrError(std::move(receiver_));
+    }
+  }
+
+ private:
+  static void OnLocked(OperationBase* op) noexcept {
+    detail::SetValueOrError(std::move(static_cast<Operation*>(op)->receiver_));
+  }
+
+  AsyncMutex& mutex_;
+  Receiver receiver_;
+};
+
+class AsyncMutex::LockSender {
+ public:
+  template <template <typename...> class Variant,
+            template <typename...> class Tuple>
+  using value_types = Variant<Tuple<>>;
+
+  template <template <typename...> class Variant>
+  using error_types = Variant<std::exception_ptr>;
+
+  static constexpr bool sends_done = false;
+
+  explicit LockSender(AsyncMutex& mutex) noexcept : mutex_(mutex) {}
+
+  template <typename Receiver>
+  Operation<unifex::remove_cvref_t<Receiver>> connect(Receiver&& r) const& {
+    return Operation<unifex::remove_cvref_t<Receiver>>{mutex_,
+                                                       (Receiver &&) r};
+  }
+
+ private:
+  AsyncMutex& mutex_;
+};
+
+inline AsyncMutex::LockSender AsyncMutex::Lock() noexcept {
+  return LockSender{*this};
+}
+
+inline bool AsyncMutex::TryLock() noexcept {
+  auto expected = kNotLocked;
+  return state_.compare_exchange_strong(expected, kLockedNoWaiters,
+                                        std::memory_order_acquire,
+                                        std::memory_order_relaxed);
+}
+
+}  // namespace agrpc
+
+#endif  // AGRPC_CONTEXT_ASYNC_MUTEX_H_
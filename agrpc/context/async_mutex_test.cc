@@ -0,0 +1,77 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/async_mutex.h"
+
+#include <thread>
+#include <vector>
+
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/task.hpp>
+
+#include "gtest/gtest.h"
+
+#include "agrpc/context/grpc_context_pool.h"
+
+namespace agrpc {
+namespace {
+
+TEST(AsyncMutex, UncontendedLockCompletesInline) {
+  AsyncMutex mutex;
+  unifex::sync_wait(mutex.Lock());
+  ASSERT_FALSE(mutex.TryLock());
+  mutex.Unlock();
+  ASSERT_TRUE(mutex.TryLock());
+  mutex.Unlock();
+}
+
+unifex::task<void> Increment(GrpcContext::Scheduler scheduler,
+                             AsyncMutex& mutex, int& counter, int times) {
+  co_await unifex::schedule(scheduler);
+  for (int i = 0; i < times; ++i) {
+    co_await mutex.Lock();
+    // Give other contexts a chance to contend.
+    int value = counter;
+    co_await yield(scheduler);
+    counter = value + 1;
+    mutex.Unlock();
+  }
+}
+
+TEST(AsyncMutex, ExcludesHandlersOnOtherContexts) {
+  constexpr int kHandlers = 8;
+  constexpr int kTimes = 200;
+  GrpcContextPool pool{4};
+  pool.Start();
+
+  AsyncMutex mutex;
+  int counter = 0;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kHandlers; ++i) {
+    threads.emplace_back([&, scheduler = pool.get_next_scheduler()] {
+      unifex::sync_wait(Increment(scheduler, mutex, counter, kTimes));
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(counter, kHandlers * kTimes);
+
+  pool.ShutDown();
+  pool.Join();
+}
+
+}  // namespace
+}  // namespace agrpc
@@ -0,0 +1,74 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/async_semaphore.h"
+
+namespace agrpc {
+
+// A waiter announces itself in `waiting_` before it checks the count a last
+// time, and `Release` bumps the count before it checks `waiting_`. Both are
+// sequentially consistent, so either the waiter sees the permit or `Release`
+// sees the waiter and hands the permit over under the lock. Permits are only
+// taken past `waiting_` under the lock, and only while nobody is queued, so a
+// released permit goes to the oldest waiter.
+
+bool AsyncSemaphore::AcquireOrEnqueue(detail::AsyncWaiter* waiter) noexcept {
+  if (TryAcquire()) {
+    return true;
+  }
+  std::lock_guard lock{mutex_};
+  waiting_.fetch_add(1, std::memory_order_seq_cst);
+  if (!head_ && TakePermit()) {
+    waiting_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+  waiter->next_waiter_ = nullptr;
+  if (tail_) {
+    tail_->next_waiter_ = waiter;
+  } else {
+    head_ = waiter;
+  }
+  tail_ = waiter;
+  return false;
+}
+
+void AsyncSemaphore::Release(std::size_t n) noexcept {
+  count_.fetch_add(static_cast<std::int64_t>(n), std::memory_order_seq_cst);
+  if (waiting_.load(std::memory_order_seq_cst) == 0) {
+    return;
+  }
+  detail::AsyncWaiter* woken = nullptr;
+  detail::AsyncWaiter* woken_tail = nullptr;
+  {
+    std::lock_guard lock{mutex_};
+    while (head_ && TakePermit()) {
+      auto* waiter = head_;
+      head_ = waiter->next_waiter_;
+      if (!head_) {
+        tail_ = nullptr;
+      }
+      waiter->next_waiter_ = nullptr;
+      if (woken_tail) {
+        woken_tail->next_waiter_ = waiter;
+      } else {
+        woken = waiter;
+      }
+      woken_tail = waiter;
+      waiting_.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+  detail::ResumeWaiters(woken);
+}
+
+}  // namespace agrpc
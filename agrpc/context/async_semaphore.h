@@ -0,0 +1,159 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_CONTEXT_ASYNC_SEMAPHORE_H_
+#define AGRPC_CONTEXT_ASYNC_SEMAPHORE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <utility>
+
+#include <unifex/type_traits.hpp>
+
+#include "agrpc/context/async_waiter.h"
+
+namespace agrpc {
+
+// A counting semaphore for handlers on different `GrpcContext`s, e.g. to bound
+// the calls that use a backend at the same time:
+//
+//   agrpc::AsyncSemaphore backend_slots{16};
+//   ...
+//   co_await backend_slots.Acquire();
+//   ... call the backend ...
+//   backend_slots.Release();
+//
+// A handler that finds no permit left is suspended and resumed on its own
+// context once it got one, in arrival order. Nobody overtakes a queued waiter:
+// while one waits, `TryAcquire` fails and `Acquire` queues up behind it.
+// Acquiring while permits are left and releasing while nobody waits are
+// lock-free; only waiting and waking take a lock. Waiting allocates nothing and
+// cannot be cancelled.
+class AsyncSemaphore {
+ public:
+  class AcquireSender;
+
+  explicit AsyncSemaphore(std::size_t initial_count) noexcept
+      : count_(static_cast<std::int64_t>(initial_count)) {}
+
+  AsyncSemaphore(const AsyncSemaphore&) = delete;
+  AsyncSemaphore& operator=(const AsyncSemaphore&) = delete;
+
+  // Completes once a permit was taken. Completes inline if one is left,
+  // otherwise on the context it was started on.
+  AcquireSender Acquire() noexcept;
+
+  // Returns whether a permit was taken. Fails while a handler waits, even if
+  // the permit it waits for was just released.
+  bool TryAcquire() noexcept;
+
+  // Returns `n` permits, from any thread.
+  void Release(std::size_t n = 1) noexcept;
+
+ private:
+  template <typename Receiver>
+  class Operation;
+
+  // Takes a permit and returns true, or queues `waiter` and returns false.
+  bool AcquireOrEnqueue(detail::AsyncWaiter* waiter) noexcept;
+
+  // Takes a permit regardless of waiters.
+  bool TakePermit() noexcept;
+
+  std::atomic<std::int64_t> count_;
+  // Number of queued waiters, which tells `Release` whether to take the lock.
+  std::atomic<std::size_t> waiting_{0};
+
+  std::mutex mutex_;
+  detail::AsyncWaiter* head_ = nullptr;
+  detail::AsyncWaiter* tail_ = nullptr;
+};
+
+template <typename Receiver>
+class AsyncSemaphore::Operation : private detail::AsyncWaiter {
+  using OperationBase = detail::GrpcContextAccess::OperationBase;
+
+ public:
+  template <typename Receiver2>
+  explicit Operation(AsyncSemaphore& semaphore, Receiver2&& r)
+      : semaphore_(semaphore), receiver_((Receiver2 &&) r) {}
+
+  void start() noexcept {
+    this->context_ = detail::GrpcContextAccess::GetCurrent();
+    this->execute_ = &Operation::OnAcquired;
+    if (semaphore_.AcquireOrEnqueue(this)) {
+      detail::SetValueOrError(std::move(receiver_));
+    }
+  }
+
+ private:
+  static void OnAcquired(OperationBase* op) noexcept {
+    detail::SetValueOrError(std::move(static_cast<Operation*>(op)->receiver_));
+  }
+
+  AsyncSemaphore& semaphore_;
+  Receiver receiver_;
+};
+
+class AsyncSemaphore::AcquireSender {
+ public:
+  template <template <typename...> class Variant,
+            template <typename...> class Tuple>
+  using value_types = Variant<Tuple<>>;
+
+  template <template <typename...> class Variant>
+  using error_types = Variant<std::exception_ptr>;
+
+  static constexpr bool sends_done = false;
+
+  explicit AcquireSender(AsyncSemaphore& semaphore) noexcept
+      : semaphore_(semaphore) {}
+
+  template <typename Receiver>
+  Operation<unifex::remove_cvref_t<Receiver>> connect(Receiver&& r) const& {
+    return Operation<unifex::remove_cvref_t<Receiver>>{semaphore_,
+                                                       (Receiver &&) r};
+  }
+
+ private:
+  AsyncSemaphore& semaphore_;
+};
+
+inline AsyncSemaphore::AcquireSender AsyncSemaphore::Acquire() noexcept {
+  return AcquireSender{*this};
+}
+
+inline bool AsyncSemaphore::TryAcquire() noexcept {
+  return waiting_.load(std::memory_order_seq_cst) == 0 && TakePermit();
+}
+
+inline bool AsyncSemaphore::TakePermit() noexcept {
+  // Sequentially consistent for the handshake with `Release`.
+  auto count = count_.load(std::memory_order_seq_cst);
+  while (count > 0) {
+    if (count_.compare_exchange_weak(count, count - 1,
+                                     std::memory_order_acquire,
+                                     std::memory_order_relaxed)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace agrpc
+
+#endif  // AGRPC_CONTEXT_ASYNC_SEMAPHORE_H_
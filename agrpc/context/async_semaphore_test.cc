@@ -0,0 +1,119 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/async_semaphore.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/task.hpp>
+
+#include "gtest/gtest.h"
+
+#include "agrpc/context/grpc_context_pool.h"
+#include "agrpc/testing/grpc_context_helpers.h"
+
+namespace agrpc {
+namespace {
+
+TEST(AsyncSemaphore, TryAcquireTakesPermits) {
+  AsyncSemaphore semaphore{2};
+  ASSERT_TRUE(semaphore.TryAcquire());
+  unifex::sync_wait(semaphore.Acquire());
+  ASSERT_FALSE(semaphore.TryAcquire());
+  semaphore.Release(2);
+  ASSERT_TRUE(semaphore.TryAcquire());
+}
+
+TEST(AsyncSemaphore, NothingOvertakesAWaiter) {
+  GrpcContext context;
+  AsyncSemaphore semaphore{0};
+  int acquired = 0;
+  auto on_acquired = [&] { ++acquired; };
+  using Receiver = testing::InvokeReceiver<decltype(on_acquired)>;
+  auto first = unifex::connect(semaphore.Acquire(), Receiver{&on_acquired});
+  auto second = unifex::connect(semaphore.Acquire(), Receiver{&on_acquired});
+  testing::RunOnContext(context, [&] {
+    unifex::start(first);
+    unifex::start(second);
+  });
+  ASSERT_EQ(acquired, 0);
+
+  // The permit goes to the first waiter, not to `TryAcquire`.
+  semaphore.Release();
+  ASSERT_FALSE(semaphore.TryAcquire());
+  testing::RunUntil(context, [&] { return acquired == 1; });
+
+  // Still one waiter queued.
+  semaphore.Release(2);
+  testing::RunUntil(context, [&] { return acquired == 2; });
+  ASSERT_TRUE(semaphore.TryAcquire());
+  ASSERT_FALSE(semaphore.TryAcquire());
+
+  testing::ShutDownAndDrain(context);
+}
+
+unifex::task<void> UsePermit(GrpcContext::Scheduler scheduler,
+                             AsyncSemaphore& semaphore,
+                             std::atomic<int>& holders,
+                             std::atomic<int>& max_holders, int times) {
+  co_await unifex::schedule(scheduler);
+  for (int i = 0; i < times; ++i) {
+    co_await semaphore.Acquire();
+    int now = holders.fetch_add(1) + 1;
+    int max = max_holders.load();
+    while (now > max && !max_holders.compare_exchange_weak(max, now)) {
+    }
+    co_await yield(scheduler);
+    holders.fetch_sub(1);
+    semaphore.Release();
+  }
+}
+
+TEST(AsyncSemaphore, BoundsConcurrentHolders) {
+  constexpr int kPermits = 3;
+  constexpr int kHandlers = 8;
+  GrpcContextPool pool{4};
+  pool.Start();
+
+  AsyncSemaphore semaphore{kPermits};
+  std::atomic<int> holders{0};
+  std::atomic<int> max_holders{0};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kHandlers; ++i) {
+    threads.emplace_back([&, scheduler = pool.get_next_scheduler()] {
+      unifex::sync_wait(
+          UsePermit(scheduler, semaphore, holders, max_holders, 200));
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_LE(max_holders.load(), kPermits);
+  ASSERT_EQ(holders.load(), 0);
+  // All permits are back.
+  for (int i = 0; i < kPermits; ++i) {
+    ASSERT_TRUE(semaphore.TryAcquire());
+  }
+  ASSERT_FALSE(semaphore.TryAcquire());
+
+  pool.ShutDown();
+  pool.Join();
+}
+
+}  // namespace
+}  // namespace agrpc
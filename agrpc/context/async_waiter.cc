@@ -0,0 +1,39 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/async_waiter.h"
+
+namespace agrpc::detail {
+
+void ResumeWaiters(AsyncWaiter* waiters) noexcept {
+  while (waiters) {
+    auto* context = waiters->context_;
+    if (!context) {
+      auto* waiter = std::exchange(waiters, waiters->next_waiter_);
+      waiter->execute_(waiter);
+      continue;
+    }
+    GrpcContextAccess::OperationQueue batch;
+    while (waiters && waiters->context_ == context) {
+      batch.push_back(std::exchange(waiters, waiters->next_waiter_));
+    }
+    if (GrpcContextAccess::IsRunningOnThisThread(*context)) {
+      GrpcContextAccess::ScheduleLocal(*context, std::move(batch));
+    } else {
+      GrpcContextAccess::ScheduleRemote(*context, std::move(batch));
+    }
+  }
+}
+
+}  // namespace agrpc::detail
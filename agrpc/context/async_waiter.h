@@ -0,0 +1,76 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_CONTEXT_ASYNC_WAITER_H_
+#define AGRPC_CONTEXT_ASYNC_WAITER_H_
+
+#include <exception>
+#include <utility>
+
+#include <unifex/receiver_concepts.hpp>
+
+#include "agrpc/context/grpc_context.h"
+
+namespace agrpc::detail {
+
+// An operation suspended on one of the coroutine synchronization primitives,
+// e.g. `AsyncMutex`. It is resumed on the context it was started on.
+struct AsyncWaiter : GrpcContextAccess::OperationBase {
+  // The context the waiter was started on, see `GrpcContextAccess::GetCurrent`.
+  // Null if it was started elsewhere, in which case it is resumed inline by
+  // whoever wakes it up.
+  GrpcContext* context_ = nullptr;
+  AsyncWaiter* next_waiter_ = nullptr;
+};
+
+// Resumes the waiters of the list starting at `waiters`, in order. Waiters on
+// the same context that follow each other are handed over in one batch, so
+// they cost at most one wakeup of the context.
+void ResumeWaiters(AsyncWaiter* waiters) noexcept;
+
+inline void ResumeWaiter(AsyncWaiter* waiter) noexcept {
+  waiter->next_waiter_ = nullptr;
+  ResumeWaiters(waiter);
+}
+
+// Reverses a list linked through `next_waiter_`, e.g. a lock-free stack of
+// waiters into arrival order.
+inline AsyncWaiter* ReverseWaiters(AsyncWaiter* waiters) noexcept {
+  AsyncWaiter* reversed = nullptr;
+  while (waiters) {
+    auto* next = waiters->next_waiter_;
+    waiters->next_waiter_ = reversed;
+    reversed = waiters;
+    waiters = next;
+  }
+  return reversed;
+}
+
+// Completes `receiver` with no value, or with the exception `set_value`
+// threw.
+template <typename Receiver>
+void SetValueOrError(Receiver&& receiver) noexcept {
+  if constexpr (noexcept(unifex::set_value(std::move(receiver)))) {
+    unifex::set_value(std::move(receiver));
+  } else {
+    UNIFEX_TRY { unifex::set_value(std::move(receiver)); }
+    UNIFEX_CATCH(...) {
+      unifex::set_error(std::move(receiver), std::current_exception());
+    }
+  }
+}
+
+}  // namespace agrpc::detail
+
+#endif  // AGRPC_CONTEXT_ASYNC_WAITER_H_
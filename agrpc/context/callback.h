@@ -0,0 +1,595 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_CONTEXT_CALLBACK_H_
+#define AGRPC_CONTEXT_CALLBACK_H_
+
+#include <atomic>
+#include <exception>
+#include <type_traits>
+#include <utility>
+
+#include <grpcpp/server_context.h>
+#include <grpcpp/support/server_callback.h>
+#include <grpcpp/support/status.h>
+
+#include <unifex/get_stop_token.hpp>
+#include <unifex/inplace_stop_token.hpp>
+#include <unifex/manual_lifetime.hpp>
+#include <unifex/receiver_concepts.hpp>
+#include <unifex/sender_concepts.hpp>
+#include <unifex/type_traits.hpp>
+
+#include "agrpc/base/logging.h"
+#include "agrpc/context/rpcs.h"
+
+// A backend on gRPC's callback API. Operations complete right on the threads
+// gRPC runs reactor callbacks on, without passing through a completion queue
+// and a `GrpcContext` run loop. Coroutine handlers written against the CPOs
+// of `rpcs.h` run on either backend:
+//
+//   template <typename Executor, typename ServerContext, typename Responder>
+//   agrpc::task<void> Echo(Executor executor, ServerContext& server_context,
+//                          EchoRequest& request, EchoResponse& response,
+//                          Responder& responder) {
+//     response.set_message(request.message());
+//     co_await agrpc::AsyncFinish(executor, responder, response,
+//                                 grpc::Status::OK);
+//   }
+//
+//   class EchoServiceImpl : public EchoService::CallbackService {
+//     grpc::ServerUnaryReactor* Echo(grpc::CallbackServerContext* context,
+//                                    const EchoRequest* request,
+//                                    EchoResponse* response) override {
+//       return agrpc::StartCallbackUnary(
+//           context, request, response,
+//           [](auto&&... args) { return ::Echo(args...); });
+//     }
+//   };
+//
+// Handlers are called as `handler(executor, server_context, request, response,
+// responder)`, the shape `agrpc::serve` handlers get from generated skeletons,
+// with a mutable `request` as well. Their tasks start inline on the thread gRPC
+// called the service method on. Stop is requested from their receiver when the
+// call is cancelled. There is no scheduler to hop to; work that must not run on
+// gRPC's threads is to be moved elsewhere, e.g. with an `OffloadPool`.
+
+namespace agrpc {
+
+// Executor of the callback backend, passed to handlers in place of a
+// `GrpcContext::Scheduler`.
+struct CallbackExecutor {
+  friend bool operator==(CallbackExecutor, CallbackExecutor) noexcept {
+    return true;
+  }
+  friend bool operator!=(CallbackExecutor, CallbackExecutor) noexcept {
+    return false;
+  }
+};
+
+namespace detail {
+
+// An operation waiting for a reactor callback.
+struct CallbackOperationBase {
+  void (*complete_)(CallbackOperationBase*, bool ok) noexcept;
+};
+
+// Starts an operation of a reactor through `initiate` and completes with the
+// `ok` of the reactor callback it waits for in `*slot`.
+template <typename Initiate>
+class CallbackSender {
+  template <typename Receiver>
+  class Operation : private CallbackOperationBase {
+   public:
+    template <typename Receiver2>
+    explicit Operation(CallbackOperationBase** slot, Initiate initiate,
+                       Receiver2&& r)
+        : slot_(slot),
+          initiate_(std::move(initiate)),
+          receiver_((Receiver2 &&) r) {}
+
+    void start() noexcept {
+      this->complete_ = &Operation::OnComplete;
+      *slot_ = this;
+      initiate_();
+    }
+
+   private:
+    static void OnComplete(CallbackOperationBase* op, bool ok) noexcept {
+      auto& self = *static_cast<Operation*>(op);
+      if constexpr (noexcept(unifex::set_value(std::move(self.receiver_),
+                                               ok))) {
+        unifex::set_value(std::move(self.receiver_), ok);
+      } else {
+        UNIFEX_TRY { unifex::set_value(std::move(self.receiver_), ok); }
+        UNIFEX_CATCH(...) {
+          unifex::set_error(std::move(self.receiver_),
+                            std::current_exception());
+        }
+      }
+    }
+
+    CallbackOperationBase** slot_;
+    Initiate initiate_;
+    Receiver receiver_;
+  };
+
+ public:
+  template <template <typename...> class Variant,
+            template <typename...> class Tuple>
+  using value_types = Variant<Tuple<bool>>;
+
+  template <template <typename...> class Variant>
+  using error_types = Variant<std::exception_ptr>;
+
+  static constexpr bool sends_done = false;
+
+  explicit CallbackSender(CallbackOperationBase** slot,
+                          Initiate initiate) noexcept
+      : slot_(slot), initiate_(std::move(initiate)) {}
+
+  template <typename Receiver>
+  Operation<unifex::remove_cvref_t<Receiver>> connect(Receiver&& r) && {
+    return Operation<unifex::remove_cvref_t<Receiver>>{
+        slot_, std::move(initiate_), (Receiver &&) r};
+  }
+
+ private:
+  CallbackOperationBase** slot_;
+  Initiate initiate_;
+};
+
+inline void CompleteCallbackOperation(CallbackOperationBase*& slot,
+                                      bool ok) noexcept {
+  if (auto* op = std::exchange(slot, nullptr)) {
+    op->complete_(op, ok);
+  }
+}
+
+// What all responders share: the operations waiting for reactor callbacks and
+// the lifetime of the reactor. The reactor deletes itself once gRPC is done
+// with the call and the handler returned.
+template <typename Reactor>
+class CallbackReactor : public Reactor, public BackendResponder {
+ public:
+  void OnSendInitialMetadataDone(bool ok) override {
+    CompleteCallbackOperation(metadata_op_, ok);
+  }
+
+  void OnCancel() override {
+    cancelled_.store(true, std::memory_order_relaxed);
+    stop_source_.request_stop();
+  }
+
+  void OnDone() override {
+    CompleteCallbackOperation(finish_op_,
+                              !cancelled_.load(std::memory_order_relaxed));
+    Unref();
+  }
+
+  // The call's stop token, stop is requested when the call is cancelled.
+  unifex::inplace_stop_token get_stop_token() const noexcept {
+    return stop_source_.get_token();
+  }
+
+ protected:
+  // Called once the handler returned. Finishes the call if the handler did
+  // not.
+  void OnHandlerDone() noexcept {
+    if (!finish_started_) {
+      finish_started_ = true;
+      this->Finish(grpc::Status(grpc::StatusCode::INTERNAL,
+                                "Handler returned without finishing"));
+    }
+    Unref();
+  }
+
+  void Unref() noexcept {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+ public:
+  CallbackOperationBase* metadata_op_ = nullptr;
+  CallbackOperationBase* read_op_ = nullptr;
+  CallbackOperationBase* write_op_ = nullptr;
+  CallbackOperationBase* finish_op_ = nullptr;
+  // Only touched by the handler.
+  bool finish_started_ = false;
+
+ private:
+  // One for gRPC and one for the handler.
+  std::atomic<int> refs_{2};
+  std::atomic<bool> cancelled_{false};
+  unifex::inplace_stop_source stop_source_;
+};
+
+}  // namespace detail
+
+// Responder of a unary call.
+template <typename Response>
+class CallbackResponseWriter
+    : public detail::CallbackReactor<grpc::ServerUnaryReactor> {
+ public:
+  // `response` is the message gRPC sends once finished.
+  explicit CallbackResponseWriter(Response* response) noexcept
+      : response_(response) {}
+
+  Response& response() noexcept { return *response_; }
+
+ private:
+  Response* response_;
+};
+
+// Responder of a server-streaming call.
+template <typename Response>
+class CallbackWriter
+    : public detail::CallbackReactor<grpc::ServerWriteReactor<Response>> {
+ public:
+  void OnWriteDone(bool ok) override {
+    detail::CompleteCallbackOperation(this->write_op_, ok);
+  }
+};
+
+// Responder of a client-streaming call.
+template <typename Response, typename Request>
+class CallbackReader
+    : public detail::CallbackReactor<grpc::ServerReadReactor<Request>> {
+ public:
+  // `response` is the message gRPC sends once finished.
+  explicit CallbackReader(Response* response) noexcept
+      : response_(response) {}
+
+  void OnReadDone(bool ok) override {
+    detail::CompleteCallbackOperation(this->read_op_, ok);
+  }
+
+  Response& response() noexcept { return *response_; }
+
+ private:
+  Response* response_;
+};
+
+// Responder of a bidirectional-streaming call.
+template <typename Response, typename Request>
+class CallbackReaderWriter
+    : public detail::CallbackReactor<
+          grpc::ServerBidiReactor<Request, Response>> {
+ public:
+  void OnReadDone(bool ok) override {
+    detail::CompleteCallbackOperation(this->read_op_, ok);
+  }
+
+  void OnWriteDone(bool ok) override {
+    detail::CompleteCallbackOperation(this->write_op_, ok);
+  }
+};
+
+namespace detail {
+
+// gRPC hands out the request of unary and server-streaming calls as const,
+// although it is a message of the call that nothing else touches until the
+// reactor is done. Handlers get it mutable, like from `agrpc::serve`.
+template <typename Request>
+Request& GetMutableRequest(const Request* request) noexcept {
+  return *const_cast<Request*>(request);
+}
+
+template <typename Responder, typename Initiate>
+auto MakeCallbackSender(Responder& responder,
+                        CallbackOperationBase* Responder::*slot,
+                        Initiate initiate) {
+  return CallbackSender<Initiate>(&(responder.*slot), std::move(initiate));
+}
+
+template <typename Response>
+void SetResponse(Response& target, const Response& response) {
+  if (&target != &response) {
+    target = response;
+  }
+}
+
+// Runs `handler` for a call with `Responder`, keeping the handler and its
+// operation alive as long as the reactor.
+template <typename Responder, typename Handler, typename Request,
+          typename Response>
+class CallbackCall : public Responder {
+ public:
+  template <typename... Args>
+  explicit CallbackCall(Handler handler, Args&&... args)
+      : Responder((Args &&) args...), handler_(std::move(handler)) {}
+
+  ~CallbackCall() override {
+    if (started_) {
+      op_.destruct();
+    }
+  }
+
+  void Start(grpc::CallbackServerContext& server_context, Request& request,
+             Response& response) noexcept {
+    UNIFEX_TRY {
+      op_.construct_with([&] {
+        return unifex::connect(handler_(CallbackExecutor{}, server_context,
+                                        request, response,
+                                        static_cast<Responder&>(*this)),
+                               Receiver{this});
+      });
+      started_ = true;
+    }
+    UNIFEX_CATCH(const std::exception& e) {
+      AGRPC_LOG_ERROR("Handler failed to start: {}", e.what());
+      this->OnHandlerDone();
+      return;
+    }
+    unifex::start(op_.get());
+  }
+
+ private:
+  struct Receiver {
+    CallbackCall* call;
+
+    template <typename... Values>
+    void set_value(Values&&...) && noexcept {
+      call->OnHandlerDone();
+    }
+
+    void set_error(std::exception_ptr e) && noexcept {
+      UNIFEX_TRY { std::rethrow_exception(std::move(e)); }
+      UNIFEX_CATCH(const std::exception& e) {
+        AGRPC_LOG_ERROR("Handler failed: {}", e.what());
+      }
+      UNIFEX_CATCH(...) {
+        AGRPC_LOG_ERROR("Handler failed with an unknown exception");
+      }
+      call->OnHandlerDone();
+    }
+
+    void set_done() && noexcept { call->OnHandlerDone(); }
+
+    friend unifex::inplace_stop_token tag_invoke(
+        unifex::tag_t<unifex::get_stop_token>, const Receiver& r) noexcept {
+      return r.call->get_stop_token();
+    }
+  };
+
+  using HandlerSender =
+      std::invoke_result_t<Handler&, CallbackExecutor,
+                           grpc::CallbackServerContext&, Request&, Response&,
+                           Responder&>;
+  using Operation = unifex::connect_result_t<HandlerSender, Receiver>;
+
+  Handler handler_;
+  bool started_ = false;
+  unifex::manual_lifetime<Operation> op_;
+};
+
+}  // namespace detail
+
+// Starts `handler` for a unary call. To be returned from the method of a
+// `CallbackService`.
+template <typename Request, typename Response, typename Handler>
+grpc::ServerUnaryReactor* StartCallbackUnary(
+    grpc::CallbackServerContext* server_context, const Request* request,
+    Response* response, Handler handler) {
+  using Call = detail::CallbackCall<CallbackResponseWriter<Response>, Handler,
+                                    Request, Response>;
+  auto* call = new Call(std::move(handler), response);
+  call->Start(*server_context, detail::GetMutableRequest(request), *response);
+  return call;
+}
+
+// Starts `handler` for a server-streaming call. `response` is a message the
+// handler may fill in and write repeatedly.
+template <typename Request, typename Response, typename Handler>
+grpc::ServerWriteReactor<Response>* StartCallbackServerStreaming(
+    grpc::CallbackServerContext* server_context, const Request* request,
+    Handler handler) {
+  struct Call : detail::CallbackCall<CallbackWriter<Response>, Handler,
+                                     Request, Response> {
+    using detail::CallbackCall<CallbackWriter<Response>, Handler, Request,
+                               Response>::CallbackCall;
+    Response response;
+  };
+  auto* call = new Call(std::move(handler));
+  call->Start(*server_context, detail::GetMutableRequest(request),
+              call->response);
+  return call;
+}
+
+// Starts `handler` for a client-streaming call. `request` is a message to read
+// into.
+template <typename Request, typename Response, typename Handler>
+grpc::ServerReadReactor<Request>* StartCallbackClientStreaming(
+    grpc::CallbackServerContext* server_context, Response* response,
+    Handler handler) {
+  struct Call : detail::CallbackCall<CallbackReader<Response, Request>,
+                                     Handler, Request, Response> {
+    using detail::CallbackCall<CallbackReader<Response, Request>, Handler,
+                               Request, Response>::CallbackCall;
+    Request request;
+  };
+  auto* call = new Call(std::move(handler), response);
+  call->Start(*server_context, call->request, *response);
+  return call;
+}
+
+// Starts `handler` for a bidirectional-streaming call. `request` is a message
+// to read into, `response` one to fill in and write repeatedly.
+template <typename Request, typename Response, typename Handler>
+grpc::ServerBidiReactor<Request, Response>* StartCallbackBidiStreaming(
+    grpc::CallbackServerContext* server_context, Handler handler) {
+  struct Call : detail::CallbackCall<CallbackReaderWriter<Response, Request>,
+                                     Handler, Request, Response> {
+    using detail::CallbackCall<CallbackReaderWriter<Response, Request>,
+                               Handler, Request, Response>::CallbackCall;
+    Request request;
+    Response response;
+  };
+  auto* call = new Call(std::move(handler));
+  call->Start(*server_context, call->request, call->response);
+  return call;
+}
+
+// AsyncRead
+template <typename Response, typename Request>
+auto tag_invoke(tag_t<AsyncRead>, CallbackExecutor,
+                CallbackReader<Response, Request>& reader, Request& request) {
+  return detail::MakeCallbackSender(
+      reader, &CallbackReader<Response, Request>::read_op_,
+      [&reader, &request] { reader.StartRead(&request); });
+}
+
+template <typename Response, typename Request>
+auto tag_invoke(tag_t<AsyncRead>, CallbackExecutor,
+                CallbackReaderWriter<Response, Request>& reader_writer,
+                Request& request) {
+  return detail::MakeCallbackSender(
+      reader_writer, &CallbackReaderWriter<Response, Request>::read_op_,
+      [&reader_writer, &request] { reader_writer.StartRead(&request); });
+}
+
+// AsyncWrite
+template <typename Response>
+auto tag_invoke(tag_t<AsyncWrite>, CallbackExecutor,
+                CallbackWriter<Response>& writer, const Response& response) {
+  return detail::MakeCallbackSender(
+      writer, &CallbackWriter<Response>::write_op_,
+      [&writer, &response] { writer.StartWrite(&response); });
+}
+
+template <typename Response, typename Request>
+auto tag_invoke(tag_t<AsyncWrite>, CallbackExecutor,
+                CallbackReaderWriter<Response, Request>& reader_writer,
+                const Response& response) {
+  return detail::MakeCallbackSender(
+      reader_writer, &CallbackReaderWriter<Response, Request>::write_op_,
+      [&reader_writer, &response] { reader_writer.StartWrite(&response); });
+}
+
+// AsyncFinish
+template <typename Response>
+auto tag_invoke(tag_t<AsyncFinish>, CallbackExecutor,
+                CallbackResponseWriter<Response>& writer,
+                const Response& response, const grpc::Status& status) {
+  return detail::MakeCallbackSender(
+      writer, &CallbackResponseWriter<Response>::finish_op_,
+      [&writer, &response, status] {
+        detail::SetResponse(writer.response(), response);
+        writer.finish_started_ = true;
+        writer.Finish(status);
+      });
+}
+
+template <typename Response>
+auto tag_invoke(tag_t<AsyncFinish>, CallbackExecutor,
+                CallbackWriter<Response>& writer,
+                const grpc::Status& status) {
+  return detail::MakeCallbackSender(writer,
+                                    &CallbackWriter<Response>::finish_op_,
+                                    [&writer, status] {
+                                      writer.finish_started_ = true;
+                                      writer.Finish(status);
+                                    });
+}
+
+template <typename Response, typename Request>
+auto tag_invoke(tag_t<AsyncFinish>, CallbackExecutor,
+                CallbackReader<Response, Request>& reader,
+                const Response& response, const grpc::Status& status) {
+  return detail::MakeCallbackSender(
+      reader, &CallbackReader<Response, Request>::finish_op_,
+      [&reader, &response, status] {
+        detail::SetResponse(reader.response(), response);
+        reader.finish_started_ = true;
+        reader.Finish(status);
+      });
+}
+
+template <typename Response, typename Request>
+auto tag_invoke(tag_t<AsyncFinish>, CallbackExecutor,
+                CallbackReaderWriter<Response, Request>& reader_writer,
+                const grpc::Status& status) {
+  return detail::MakeCallbackSender(
+      reader_writer, &CallbackReaderWriter<Response, Request>::finish_op_,
+      [&reader_writer, status] {
+        reader_writer.finish_started_ = true;
+        reader_writer.Finish(status);
+      });
+}
+
+// AsyncWriteAndFinish
+template <typename Response>
+auto tag_invoke(tag_t<AsyncWriteAndFinish>, CallbackExecutor,
+                CallbackWriter<Response>& writer, const Response& response,
+                grpc::WriteOptions options, const grpc::Status& status) {
+  return detail::MakeCallbackSender(
+      writer, &CallbackWriter<Response>::finish_op_,
+      [&writer, &response, options, status] {
+        writer.finish_started_ = true;
+        writer.StartWriteAndFinish(&response, options, status);
+      });
+}
+
+template <typename Response, typename Request>
+auto tag_invoke(tag_t<AsyncWriteAndFinish>, CallbackExecutor,
+                CallbackReaderWriter<Response, Request>& reader_writer,
+                const Response& response, grpc::WriteOptions options,
+                const grpc::Status& status) {
+  return detail::MakeCallbackSender(
+      reader_writer, &CallbackReaderWriter<Response, Request>::finish_op_,
+      [&reader_writer, &response, options, status] {
+        reader_writer.finish_started_ = true;
+        reader_writer.StartWriteAndFinish(&response, options, status);
+      });
+}
+
+// AsyncFinishWithError
+template <typename Response>
+auto tag_invoke(tag_t<AsyncFinishWithError>, CallbackExecutor,
+                CallbackResponseWriter<Response>& writer,
+                const grpc::Status& status) {
+  return detail::MakeCallbackSender(
+      writer, &CallbackResponseWriter<Response>::finish_op_,
+      [&writer, status] {
+        writer.finish_started_ = true;
+        writer.Finish(status);
+      });
+}
+
+template <typename Response, typename Request>
+auto tag_invoke(tag_t<AsyncFinishWithError>, CallbackExecutor,
+                CallbackReader<Response, Request>& reader,
+                const grpc::Status& status) {
+  return detail::MakeCallbackSender(
+      reader, &CallbackReader<Response, Request>::finish_op_,
+      [&reader, status] {
+        reader.finish_started_ = true;
+        reader.Finish(status);
+      });
+}
+
+// AsyncSendInitialMetadata
+template <typename Responder,
+          detail::EnableIfBackendResponder<Responder> = 0>
+auto tag_invoke(tag_t<AsyncSendInitialMetadata>, CallbackExecutor,
+                Responder& responder) {
+  return detail::MakeCallbackSender(
+      responder, &Responder::metadata_op_,
+      [&responder] { responder.StartSendInitialMetadata(); });
+}
+
+}  // namespace agrpc
+
+#endif  // AGRPC_CONTEXT_CALLBACK_H_
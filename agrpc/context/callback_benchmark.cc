@@ -0,0 +1,169 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/callback.h"
+
+#include <memory>
+
+#include <grpcpp/create_channel.h>
+#include <grpcpp/security/credentials.h>
+#include <grpcpp/security/server_credentials.h>
+#include <grpcpp/support/channel_arguments.h>
+#include <unifex/async_scope.hpp>
+#include <unifex/sync_wait.hpp>
+
+#include "benchmark/benchmark.h"
+
+#include "agrpc/base/thread.h"
+#include "agrpc/context/grpc_context_pool.h"
+#include "agrpc/context/serve.h"
+#include "agrpc/context/task.h"
+#include "agrpc/testing/echo.grpc.pb.h"
+
+// Compares the same handler served through completion queues, one
+// `GrpcContext` per CPU, with serving it through gRPC's callback API, where
+// gRPC runs it on its own threads. Every benchmark thread is a client with its
+// own connection.
+
+namespace agrpc {
+
+namespace {
+
+using testing::EchoRequest;
+using testing::EchoResponse;
+using testing::EchoService;
+
+// Number of `AsyncRequest`s kept outstanding per context.
+constexpr std::size_t kAcceptorsPerContext = 16;
+
+template <typename Executor, typename ServerContext, typename Responder>
+task<void> HandleEcho(Executor executor, ServerContext&,
+                      const EchoRequest& request, EchoResponse& response,
+                      Responder& responder) {
+  response.set_message(request.message());
+  co_await AsyncFinish(executor, responder, response, grpc::Status::OK);
+}
+
+class CompletionQueueServer {
+ public:
+  CompletionQueueServer() {
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort("127.0.0.1:0", grpc::InsecureServerCredentials(),
+                             &port_);
+    builder.RegisterService(&service_);
+    pool_ = std::make_unique<GrpcContextPool>(builder,
+                                              GetNumberOfProcessorsAvailable());
+    server_ = builder.BuildAndStart();
+    for (std::size_t i = 0; i < pool_->size(); ++i) {
+      auto scheduler = pool_->get_context(i).get_scheduler();
+      scope_.spawn(serve(
+          scheduler, &EchoService::AsyncService::RequestEcho, service_,
+          [scheduler](auto& server_context, auto& request, auto& response,
+                      auto& responder) {
+            return HandleEcho(scheduler, server_context, request, response,
+                              responder);
+          },
+          {.outstanding_requests = kAcceptorsPerContext}));
+    }
+    pool_->Start();
+  }
+
+  ~CompletionQueueServer() {
+    server_->Shutdown();
+    pool_->ShutDown();
+    pool_->Join();
+    unifex::sync_wait(scope_.cleanup());
+  }
+
+  int port() const noexcept { return port_; }
+
+ private:
+  int port_{0};
+  EchoService::AsyncService service_;
+  std::unique_ptr<GrpcContextPool> pool_;
+  std::unique_ptr<grpc::Server> server_;
+  unifex::async_scope scope_;
+};
+
+class CallbackServer {
+ public:
+  CallbackServer() {
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort("127.0.0.1:0", grpc::InsecureServerCredentials(),
+                             &port_);
+    builder.RegisterService(&service_);
+    server_ = builder.BuildAndStart();
+  }
+
+  ~CallbackServer() { server_->Shutdown(); }
+
+  int port() const noexcept { return port_; }
+
+ private:
+  class Service : public EchoService::CallbackService {
+    grpc::ServerUnaryReactor* Echo(grpc::CallbackServerContext* context,
+                                   const EchoRequest* request,
+                                   EchoResponse* response) override {
+      return StartCallbackUnary(context, request, response,
+                                [](auto&&... args) {
+                                  return HandleEcho(args...);
+                                });
+    }
+  };
+
+  int port_{0};
+  Service service_;
+  std::unique_ptr<grpc::Server> server_;
+};
+
+template <typename Server>
+void RunEchoClient(benchmark::State& state) {
+  static Server server;
+
+  // Keep each client thread on its own connection.
+  grpc::ChannelArguments args;
+  args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+  auto stub = EchoService::NewStub(grpc::CreateCustomChannel(
+      fmt::format("127.0.0.1:{}", server.port()),
+      grpc::InsecureChannelCredentials(), args));
+
+  EchoRequest request;
+  request.set_message("hello");
+  while (state.KeepRunning()) {
+    grpc::ClientContext client_context;
+    EchoResponse response;
+    auto status = stub->Echo(&client_context, request, &response);
+    if (!status.ok()) {
+      state.SkipWithError(status.error_message().c_str());
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+}  // namespace
+
+void Benchmark_CompletionQueue(benchmark::State& state) {
+  RunEchoClient<CompletionQueueServer>(state);
+}
+
+BENCHMARK(Benchmark_CompletionQueue)->ThreadRange(1, 64)->UseRealTime();
+
+void Benchmark_Callback(benchmark::State& state) {
+  RunEchoClient<CallbackServer>(state);
+}
+
+BENCHMARK(Benchmark_Callback)->ThreadRange(1, 64)->UseRealTime();
+
+}  // namespace agrpc
@@ -0,0 +1,205 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/callback.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <fmt/core.h>
+#include <grpcpp/create_channel.h>
+#include <grpcpp/security/credentials.h>
+#include <grpcpp/security/server_credentials.h>
+#include <grpcpp/server.h>
+#include <grpcpp/server_builder.h>
+#include <unifex/inplace_stop_token.hpp>
+
+#include "gtest/gtest.h"
+
+#include "agrpc/context/async_manual_reset_event.h"
+#include "agrpc/context/task.h"
+#include "agrpc/testing/echo.grpc.pb.h"
+
+namespace agrpc {
+namespace {
+
+using testing::EchoRequest;
+using testing::EchoResponse;
+using testing::EchoService;
+
+using Writer = CallbackResponseWriter<EchoResponse>;
+using Handler =
+    std::function<task<void>(CallbackExecutor, grpc::CallbackServerContext&,
+                             EchoRequest&, EchoResponse&, Writer&)>;
+
+template <typename Predicate>
+void WaitUntil(Predicate done) {
+  while (!done()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+// Serves `Echo` through `handler_` on gRPC's callback API. The reactor of each
+// call holds a token that `reactor_alive()` watches.
+class CallbackTest : public ::testing::Test {
+ protected:
+  CallbackTest() {
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort("127.0.0.1:0", grpc::InsecureServerCredentials(),
+                             &port_);
+    builder.RegisterService(&service_);
+    server_ = builder.BuildAndStart();
+    stub_ = EchoService::NewStub(
+        grpc::CreateChannel(fmt::format("127.0.0.1:{}", port_),
+                            grpc::InsecureChannelCredentials()));
+  }
+
+  ~CallbackTest() override { server_->Shutdown(); }
+
+  grpc::Status Echo(grpc::ClientContext& client_context,
+                    EchoResponse& response) {
+    EchoRequest request;
+    request.set_message("hello");
+    return stub_->Echo(&client_context, request, &response);
+  }
+
+  bool reactor_alive() {
+    std::lock_guard lock{service_.mutex};
+    return !service_.reactor_token.expired();
+  }
+
+  class Service : public EchoService::CallbackService {
+   public:
+    grpc::ServerUnaryReactor* Echo(grpc::CallbackServerContext* context,
+                                   const EchoRequest* request,
+                                   EchoResponse* response) override {
+      auto token = std::make_shared<int>(0);
+      {
+        std::lock_guard lock{mutex};
+        reactor_token = token;
+      }
+      return StartCallbackUnary(
+          context, request, response,
+          [this, token](auto executor, auto& server_context, auto& request,
+                        auto& response, auto& writer) {
+            return handler(executor, server_context, request, response,
+                           writer);
+          });
+    }
+
+    Handler handler;
+    std::mutex mutex;
+    std::weak_ptr<int> reactor_token;
+  };
+
+  int port_{0};
+  Service service_;
+  std::unique_ptr<grpc::Server> server_;
+  std::unique_ptr<EchoService::Stub> stub_;
+};
+
+TEST_F(CallbackTest, FinishesWithTheHandlersResponse) {
+  service_.handler = [](CallbackExecutor executor,
+                        grpc::CallbackServerContext&, EchoRequest& request,
+                        EchoResponse& response, Writer& writer) -> task<void> {
+    // The request is handed over mutable.
+    request.mutable_message()->append("!");
+    response.set_message(request.message());
+    co_await AsyncFinish(executor, writer, response, grpc::Status::OK);
+  };
+
+  grpc::ClientContext client_context;
+  EchoResponse response;
+  ASSERT_TRUE(Echo(client_context, response).ok());
+  ASSERT_EQ(response.message(), "hello!");
+  WaitUntil([&] { return !reactor_alive(); });
+}
+
+TEST_F(CallbackTest, FinishesWhenTheHandlerDidNot) {
+  service_.handler = [](CallbackExecutor, grpc::CallbackServerContext&,
+                        EchoRequest&, EchoResponse&, Writer&) -> task<void> {
+    co_return;
+  };
+
+  grpc::ClientContext client_context;
+  EchoResponse response;
+  auto status = Echo(client_context, response);
+  ASSERT_EQ(status.error_code(), grpc::StatusCode::INTERNAL);
+  // The handler returned before gRPC called `OnDone`.
+  WaitUntil([&] { return !reactor_alive(); });
+}
+
+TEST_F(CallbackTest, KeepsTheReactorUntilTheHandlerReturns) {
+  std::atomic<bool> finished{false};
+  AsyncManualResetEvent release;
+  service_.handler = [&](CallbackExecutor executor,
+                         grpc::CallbackServerContext&, EchoRequest& request,
+                         EchoResponse& response, Writer& writer) -> task<void> {
+    response.set_message(request.message());
+    co_await AsyncFinish(executor, writer, response, grpc::Status::OK);
+    // Resumed from `OnDone`.
+    finished = true;
+    co_await release.Wait();
+  };
+
+  grpc::ClientContext client_context;
+  EchoResponse response;
+  ASSERT_TRUE(Echo(client_context, response).ok());
+  WaitUntil([&] { return finished.load(); });
+  // gRPC is done with the call, but the handler still runs.
+  ASSERT_TRUE(reactor_alive());
+
+  // Resumes and returns the handler right here.
+  release.Set();
+  ASSERT_FALSE(reactor_alive());
+}
+
+TEST_F(CallbackTest, RequestsStopWhenTheClientCancels) {
+  std::atomic<bool> started{false};
+  std::atomic<bool> finish_ok{true};
+  AsyncManualResetEvent stopped;
+  service_.handler = [&](CallbackExecutor executor,
+                         grpc::CallbackServerContext&, EchoRequest&,
+                         EchoResponse& response, Writer& writer) -> task<void> {
+    auto on_stop = [&] { stopped.Set(); };
+    unifex::inplace_stop_callback<decltype(on_stop)> callback{
+        writer.get_stop_token(), on_stop};
+    started = true;
+    co_await stopped.Wait();
+    finish_ok = co_await AsyncFinish(executor, writer, response,
+                                     grpc::Status::CANCELLED);
+  };
+
+  grpc::ClientContext client_context;
+  grpc::Status status;
+  std::thread client{[&] {
+    EchoResponse response;
+    status = Echo(client_context, response);
+  }};
+  WaitUntil([&] { return started.load(); });
+  client_context.TryCancel();
+  client.join();
+
+  ASSERT_EQ(status.error_code(), grpc::StatusCode::CANCELLED);
+  WaitUntil([&] { return !reactor_alive(); });
+  // The finish of a cancelled call reports failure.
+  ASSERT_FALSE(finish_ok);
+}
+
+}  // namespace
+}  // namespace agrpc
@@ -0,0 +1,391 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_CONTEXT_CHANNEL_H_
+#define AGRPC_CONTEXT_CHANNEL_H_
+
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <unifex/receiver_concepts.hpp>
+#include <unifex/type_traits.hpp>
+
+#include "agrpc/base/logging.h"
+#include "agrpc/context/async_waiter.h"
+
+namespace agrpc {
+
+// A bounded queue for passing items between handlers, typically on different
+// `GrpcContext`s, e.g. from a decoding stage to an aggregating one:
+//
+//   agrpc::Channel<Record> records{1024};
+//
+//   // Producers, on any context.
+//   if (!co_await records.Send(std::move(record))) {
+//     // Closed.
+//   }
+//
+//   // The consumer.
+//   while (std::optional<Record> record = co_await records.Receive()) {
+//     ...
+//   }
+//
+// `Send` suspends while the channel is full and `Receive` while it is empty.
+// Suspended handlers are resumed on their own context through its queues, and
+// only when they have to: a consumer that was woken up for the first item of
+// a burst finds the rest buffered, so the burst costs one wakeup. Any number
+// of producers and consumers may use a channel. Operations that do not have to
+// wait still complete through the local queue when started on a context, so
+// that receive loops don't grow the stack.
+template <typename T>
+class Channel {
+  // Items are moved around under the channel's lock.
+  static_assert(std::is_nothrow_move_constructible_v<T>);
+
+ public:
+  class SendSender;
+  class ReceiveSender;
+
+  explicit Channel(std::size_t capacity) : buffer_(capacity) {
+    AGRPC_CHECK_GT(capacity, 0);
+  }
+
+  Channel(const Channel&) = delete;
+  Channel& operator=(const Channel&) = delete;
+
+  // Completes with true once `value` is in the channel, or with false if the
+  // channel is closed.
+  SendSender Send(T value);
+
+  // Completes with the next item, or with an empty optional once the channel
+  // is closed and drained.
+  ReceiveSender Receive() noexcept;
+
+  // Makes pending and future sends fail, and receives fail once the buffered
+  // items are gone. Thread-safe.
+  void Close();
+
+ private:
+  struct SendWaiter : detail::AsyncWaiter {
+    T* value_;
+    bool sent_ = false;
+  };
+
+  struct ReceiveWaiter : detail::AsyncWaiter {
+    std::optional<T> value_;
+  };
+
+  // A FIFO list of waiters linked through `next_waiter_`.
+  template <typename Waiter>
+  struct WaiterList {
+    Waiter* head = nullptr;
+    Waiter* tail = nullptr;
+
+    bool empty() const noexcept { return head == nullptr; }
+
+    void push_back(Waiter* waiter) noexcept {
+      waiter->next_waiter_ = nullptr;
+      if (tail) {
+        tail->next_waiter_ = waiter;
+      } else {
+        head = waiter;
+      }
+      tail = waiter;
+    }
+
+    Waiter* pop_front() noexcept {
+      auto* waiter = head;
+      head = static_cast<Waiter*>(waiter->next_waiter_);
+      if (!head) {
+        tail = nullptr;
+      }
+      return waiter;
+    }
+  };
+
+  template <typename Receiver>
+  class SendOperation;
+
+  template <typename Receiver>
+  class ReceiveOperation;
+
+  // Hands the value over or queues `waiter`. Returns the waiter to resume, if
+  // any, which is `waiter` itself unless it has to wait.
+  detail::AsyncWaiter* StartSend(SendWaiter* waiter) noexcept;
+  detail::AsyncWaiter* StartReceive(ReceiveWaiter* waiter) noexcept;
+
+  std::mutex mutex_;
+  // Ring buffer of `size_` items starting at `head_`.
+  std::vector<std::optional<T>> buffer_;
+  std::size_t head_ = 0;
+  std::size_t size_ = 0;
+  bool closed_ = false;
+  // Receivers only wait while the buffer is empty, senders while it is full.
+  WaiterList<SendWaiter> senders_;
+  WaiterList<ReceiveWaiter> receivers_;
+};
+
+template <typename T>
+template <typename Receiver>
+class Channel<T>::SendOperation : private SendWaiter {
+  using OperationBase = detail::GrpcContextAccess::OperationBase;
+
+ public:
+  template <typename Receiver2>
+  explicit SendOperation(Channel& channel, T value, Receiver2&& r)
+      : channel_(channel),
+        item_(std::move(value)),
+        receiver_((Receiver2 &&) r) {}
+
+  void start() noexcept {
+    this->context_ = detail::GrpcContextAccess::GetCurrent();
+    this->execute_ = &SendOperation::OnComplete;
+    this->value_ = &item_;
+    if (auto* waiter = channel_.StartSend(this)) {
+      detail::ResumeWaiter(waiter);
+    }
+  }
+
+ private:
+  static void OnComplete(OperationBase* op) noexcept {
+    auto& self = *static_cast<SendOperation*>(op);
+    bool sent = self.sent_;
+    if constexpr (noexcept(unifex::set_value(std::move(self.receiver_),
+                                             sent))) {
+      unifex::set_value(std::move(self.receiver_), sent);
+    } else {
+      UNIFEX_TRY { unifex::set_value(std::move(self.receiver_), sent); }
+      UNIFEX_CATCH(...) {
+        unifex::set_error(std::move(self.receiver_),
+                          std::current_exception());
+      }
+    }
+  }
+
+  Channel& channel_;
+  T item_;
+  Receiver receiver_;
+};
+
+template <typename T>
+template <typename Receiver>
+class Channel<T>::ReceiveOperation : private ReceiveWaiter {
+  using OperationBase = detail::GrpcContextAccess::OperationBase;
+
+ public:
+  template <typename Receiver2>
+  explicit ReceiveOperation(Channel& channel, Receiver2&& r)
+      : channel_(channel), receiver_((Receiver2 &&) r) {}
+
+  void start() noexcept {
+    this->context_ = detail::GrpcContextAccess::GetCurrent();
+    this->execute_ = &ReceiveOperation::OnComplete;
+    if (auto* waiter = channel_.StartReceive(this)) {
+      detail::ResumeWaiter(waiter);
+    }
+  }
+
+ private:
+  static void OnComplete(OperationBase* op) noexcept {
+    auto& self = *static_cast<ReceiveOperation*>(op);
+    if constexpr (noexcept(unifex::set_value(std::move(self.receiver_),
+                                             std::move(self.value_)))) {
+      unifex::set_value(std::move(self.receiver_), std::move(self.value_));
+    } else {
+      UNIFEX_TRY {
+        unifex::set_value(std::move(self.receiver_), std::move(self.value_));
+      }
+      UNIFEX_CATCH(...) {
+        unifex::set_error(std::move(self.receiver_), std::current_exception());
+      }
+    }
+  }
+
+  Channel& channel_;
+  Receiver receiver_;
+};
+
+template <typename T>
+class Channel<T>::SendSender {
+ public:
+  template <template <typename...> class Variant,
+            template <typename...> class Tuple>
+  using value_types = Variant<Tuple<bool>>;
+
+  template <template <typename...> class Variant>
+  using error_types = Variant<std::exception_ptr>;
+
+  static constexpr bool sends_done = false;
+
+  explicit SendSender(Channel& channel, T value)
+      : channel_(channel), value_(std::move(value)) {}
+
+  template <typename Receiver>
+  SendOperation<unifex::remove_cvref_t<Receiver>> connect(Receiver&& r) && {
+    return SendOperation<unifex::remove_cvref_t<Receiver>>{
+        channel_, std::move(value_), (Receiver &&) r};
+  }
+
+ private:
+  Channel& channel_;
+  T value_;
+};
+
+template <typename T>
+class Channel<T>::ReceiveSender {
+ public:
+  template <template <typename...> class Variant,
+            template <typename...> class Tuple>
+  using value_types = Variant<Tuple<std::optional<T>>>;
+
+  template <template <typename...> class Variant>
+  using error_types = Variant<std::exception_ptr>;
+
+  static constexpr bool sends_done = false;
+
+  explicit ReceiveSender(Channel& channel) noexcept : channel_(channel) {}
+
+  template <typename Receiver>
+  ReceiveOperation<unifex::remove_cvref_t<Receiver>> connect(
+      Receiver&& r) const& {
+    return ReceiveOperation<unifex::remove_cvref_t<Receiver>>{
+        channel_, (Receiver &&) r};
+  }
+
+ private:
+  Channel& channel_;
+};
+
+template <typename T>
+typename Channel<T>::SendSender Channel<T>::Send(T value) {
+  return SendSender{*this, std::move(value)};
+}
+
+template <typename T>
+typename Channel<T>::ReceiveSender Channel<T>::Receive() noexcept {
+  return ReceiveSender{*this};
+}
+
+template <typename T>
+detail::AsyncWaiter* Channel<T>::StartSend(SendWaiter* waiter) noexcept {
+  detail::AsyncWaiter* woken = nullptr;
+  {
+    std::lock_guard lock{mutex_};
+    if (closed_) {
+      waiter->sent_ = false;
+      return waiter;
+    }
+    if (!receivers_.empty()) {
+      // The buffer is empty, hand the value over directly.
+      auto* receiver = receivers_.pop_front();
+      receiver->value_.emplace(std::move(*waiter->value_));
+      woken = receiver;
+    } else if (size_ < buffer_.size()) {
+      buffer_[(head_ + size_) % buffer_.size()].emplace(
+          std::move(*waiter->value_));
+      ++size_;
+    } else {
+      senders_.push_back(waiter);
+      return nullptr;
+    }
+  }
+  waiter->sent_ = true;
+  if (woken) {
+    // Both complete in one go where they share a context.
+    woken->next_waiter_ = waiter;
+    waiter->next_waiter_ = nullptr;
+    detail::ResumeWaiters(woken);
+    return nullptr;
+  }
+  return waiter;
+}
+
+template <typename T>
+detail::AsyncWaiter* Channel<T>::StartReceive(
+    ReceiveWaiter* waiter) noexcept {
+  SendWaiter* woken = nullptr;
+  {
+    std::lock_guard lock{mutex_};
+    if (size_ == 0) {
+      if (!closed_) {
+        receivers_.push_back(waiter);
+        return nullptr;
+      }
+      waiter->value_.reset();
+      return waiter;
+    }
+    auto& front = buffer_[head_];
+    waiter->value_.emplace(std::move(*front));
+    front.reset();
+    head_ = (head_ + 1) % buffer_.size();
+    --size_;
+    if (!senders_.empty()) {
+      // Refill the slot from the longest waiting sender.
+      woken = senders_.pop_front();
+      buffer_[(head_ + size_) % buffer_.size()].emplace(
+          std::move(*woken->value_));
+      ++size_;
+      woken->sent_ = true;
+    }
+  }
+  if (woken) {
+    woken->next_waiter_ = waiter;
+    waiter->next_waiter_ = nullptr;
+    detail::ResumeWaiters(woken);
+    return nullptr;
+  }
+  return waiter;
+}
+
+template <typename T>
+void Channel<T>::Close() {
+  detail::AsyncWaiter* woken = nullptr;
+  detail::AsyncWaiter* woken_tail = nullptr;
+  auto append = [&](detail::AsyncWaiter* waiter) {
+    waiter->next_waiter_ = nullptr;
+    if (woken_tail) {
+      woken_tail->next_waiter_ = waiter;
+    } else {
+      woken = waiter;
+    }
+    woken_tail = waiter;
+  };
+  {
+    std::lock_guard lock{mutex_};
+    if (closed_) {
+      return;
+    }
+    closed_ = true;
+    while (!senders_.empty()) {
+      auto* sender = senders_.pop_front();
+      sender->sent_ = false;
+      append(sender);
+    }
+    while (!receivers_.empty()) {
+      auto* receiver = receivers_.pop_front();
+      receiver->value_.reset();
+      append(receiver);
+    }
+  }
+  detail::ResumeWaiters(woken);
+}
+
+}  // namespace agrpc
+
+#endif  // AGRPC_CONTEXT_CHANNEL_H_
@@ -0,0 +1,85 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/channel.h"
+
+#include <cstdint>
+#include <optional>
+#include <thread>
+
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/task.hpp>
+
+#include "gtest/gtest.h"
+
+#include "agrpc/context/grpc_context_pool.h"
+
+namespace agrpc {
+namespace {
+
+TEST(Channel, BuffersUntilClosed) {
+  Channel<int> channel{2};
+  ASSERT_EQ(unifex::sync_wait(channel.Send(1)), std::optional<bool>(true));
+  ASSERT_EQ(unifex::sync_wait(channel.Send(2)), std::optional<bool>(true));
+  channel.Close();
+  ASSERT_EQ(unifex::sync_wait(channel.Send(3)), std::optional<bool>(false));
+
+  ASSERT_EQ(**unifex::sync_wait(channel.Receive()), 1);
+  ASSERT_EQ(**unifex::sync_wait(channel.Receive()), 2);
+  ASSERT_FALSE(unifex::sync_wait(channel.Receive())->has_value());
+}
+
+unifex::task<void> Produce(GrpcContext::Scheduler scheduler,
+                           Channel<std::uint64_t>& channel,
+                           std::uint64_t count) {
+  co_await unifex::schedule(scheduler);
+  for (std::uint64_t i = 1; i <= count; ++i) {
+    co_await channel.Send(i);
+  }
+  channel.Close();
+}
+
+unifex::task<std::uint64_t> Consume(GrpcContext::Scheduler scheduler,
+                                    Channel<std::uint64_t>& channel) {
+  co_await unifex::schedule(scheduler);
+  std::uint64_t sum = 0;
+  while (std::optional<std::uint64_t> item = co_await channel.Receive()) {
+    sum += *item;
+  }
+  co_return sum;
+}
+
+TEST(Channel, PassesItemsBetweenContexts) {
+  constexpr std::uint64_t kItems = 10000;
+  GrpcContextPool pool{2};
+  pool.Start();
+
+  // Small enough for both sides to wait on each other.
+  Channel<std::uint64_t> channel{16};
+  std::thread producer{[&] {
+    unifex::sync_wait(Produce(pool.get_context(0).get_scheduler(), channel,
+                              kItems));
+  }};
+  auto sum =
+      unifex::sync_wait(Consume(pool.get_context(1).get_scheduler(), channel));
+  producer.join();
+  ASSERT_EQ(*sum, kItems * (kItems + 1) / 2);
+
+  pool.ShutDown();
+  pool.Join();
+}
+
+}  // namespace
+}  // namespace agrpc
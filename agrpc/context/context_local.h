@@ -0,0 +1,147 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_CONTEXT_CONTEXT_LOCAL_H_
+#define AGRPC_CONTEXT_CONTEXT_LOCAL_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "agrpc/base/likely.h"
+#include "agrpc/base/logging.h"
+#include "agrpc/context/grpc_context.h"
+
+namespace agrpc {
+
+namespace detail {
+
+// Hands out a new slot index for a `ContextLocal`. Indices are never reused,
+// so a context cannot mistake a destroyed instance for that of a new
+// `ContextLocal`.
+std::size_t AllocateContextLocalSlot() noexcept;
+
+}  // namespace detail
+
+// One lazily built `T` per `GrpcContext`, for caches, buffers and counters
+// that handlers on the same context share without locking:
+//
+//   agrpc::ContextLocal<SingleWriterCounter> requests;
+//
+//   // In a handler running on any context.
+//   requests->Add();
+//
+//   // From anywhere, e.g. a stats exporter.
+//   std::uint64_t total = 0;
+//   requests.ForEach([&](GrpcContext&, const SingleWriterCounter& counter) {
+//     total += counter.Read();
+//   });
+//
+// Access from the run loop is a thread-local read and two array lookups. Each
+// `ContextLocal` takes a slot in every context it is used on for as long as
+// the process runs, so they are meant to be long-lived, e.g. static or owned
+// by a service. An instance is destroyed along with its context, on the thread
+// destroying the context.
+template <typename T>
+class ContextLocal : private detail::GrpcContextObserver {
+ public:
+  // Default-constructs the instances.
+  ContextLocal()
+      : slot_(detail::AllocateContextLocalSlot()),
+        factory_([](GrpcContext&) { return std::make_unique<T>(); }) {
+    detail::AddGrpcContextObserver(this);
+  }
+
+  // Builds the instance for a context from `factory(context)`, on the
+  // context's run loop thread.
+  template <typename Factory>
+  explicit ContextLocal(Factory factory)
+      : slot_(detail::AllocateContextLocalSlot()),
+        factory_([factory = std::move(factory)](GrpcContext& context) {
+          return std::unique_ptr<T>(new T(factory(context)));
+        }) {
+    detail::AddGrpcContextObserver(this);
+  }
+
+  ContextLocal(const ContextLocal&) = delete;
+  ContextLocal& operator=(const ContextLocal&) = delete;
+
+  ~ContextLocal() { detail::RemoveGrpcContextObserver(this); }
+
+  // The instance of the context whose run loop is running on this thread.
+  // Must only be called from there.
+  T& get() {
+    auto* context = detail::GrpcContextAccess::GetCurrent();
+    AGRPC_CHECK(context != nullptr,
+                "ContextLocal accessed outside of a GrpcContext.");
+    void*& slot = detail::GrpcContextAccess::GetLocalSlot(*context, slot_);
+    if (AGRPC_UNLIKELY(slot == nullptr)) {
+      slot = Create(*context);
+    }
+    return *static_cast<T*>(slot);
+  }
+
+  T& operator*() { return get(); }
+  T* operator->() { return &get(); }
+
+  // Calls `fn(context, instance)` for every instance built so far. The
+  // instances keep being used by their contexts meanwhile, so `fn` should only
+  // read what is safe to read concurrently, such as `SingleWriterCounter`s or
+  // atomics. Contexts are not destroyed while `fn` runs.
+  template <typename F>
+  void ForEach(F&& fn) const {
+    std::lock_guard lock{mutex_};
+    for (const auto& [context, instance] : instances_) {
+      fn(*context, static_cast<const T&>(*instance));
+    }
+  }
+
+ private:
+  void OnContextDestroyed(GrpcContext& context) noexcept override {
+    // Destroyed once the lock is released.
+    std::unique_ptr<T> instance;
+    {
+      std::lock_guard lock{mutex_};
+      auto it = std::find_if(
+          instances_.begin(), instances_.end(),
+          [&](const auto& entry) { return entry.first == &context; });
+      if (it == instances_.end()) {
+        return;
+      }
+      instance = std::move(it->second);
+      instances_.erase(it);
+    }
+  }
+
+  T* Create(GrpcContext& context) {
+    auto instance = factory_(context);
+    auto* result = instance.get();
+    std::lock_guard lock{mutex_};
+    instances_.emplace_back(&context, std::move(instance));
+    return result;
+  }
+
+  std::size_t slot_;
+  std::function<std::unique_ptr<T>(GrpcContext&)> factory_;
+  mutable std::mutex mutex_;
+  std::vector<std::pair<GrpcContext*, std::unique_ptr<T>>> instances_;
+};
+
+}  // namespace agrpc
+
+#endif  // AGRPC_CONTEXT_CONTEXT_LOCAL_H_
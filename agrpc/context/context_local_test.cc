@@ -0,0 +1,140 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/context_local.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <set>
+
+#include "gtest/gtest.h"
+
+#include "agrpc/base/counter.h"
+#include "agrpc/testing/grpc_context_helpers.h"
+
+namespace agrpc {
+namespace {
+
+using testing::RunOnContext;
+using testing::ShutDownAndDrain;
+
+TEST(ContextLocal, OneInstancePerContext) {
+  GrpcContext a{std::make_unique<grpc::CompletionQueue>()};
+  GrpcContext b{std::make_unique<grpc::CompletionQueue>()};
+  ContextLocal<SingleWriterCounter> counter;
+
+  SingleWriterCounter* first = nullptr;
+  RunOnContext(a, [&] {
+    first = &counter.get();
+    counter->Add();
+  });
+  RunOnContext(a, [&] {
+    ASSERT_EQ(&counter.get(), first);
+    counter->Add();
+  });
+  RunOnContext(b, [&] {
+    ASSERT_NE(&counter.get(), first);
+    counter->Add(5);
+  });
+
+  std::set<GrpcContext*> contexts;
+  std::uint64_t total = 0;
+  counter.ForEach([&](GrpcContext& context, const SingleWriterCounter& c) {
+    contexts.insert(&context);
+    total += c.Read();
+  });
+  ASSERT_EQ(contexts, (std::set<GrpcContext*>{&a, &b}));
+  ASSERT_EQ(total, 7);
+
+  ShutDownAndDrain(a);
+  ShutDownAndDrain(b);
+}
+
+TEST(ContextLocal, FactoryGetsTheContext) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  ContextLocal<GrpcContext*> owner{[](GrpcContext& c) { return &c; }};
+  ContextLocal<int> unrelated;
+
+  RunOnContext(context, [&] {
+    ASSERT_EQ(*owner, &context);
+    ASSERT_EQ(*unrelated, 0);
+  });
+
+  ShutDownAndDrain(context);
+}
+
+// Counts the live instances.
+struct Tracked {
+  static inline int live = 0;
+  Tracked() { ++live; }
+  ~Tracked() { --live; }
+};
+
+TEST(ContextLocal, InstanceIsDestroyedWithItsContext) {
+  ContextLocal<Tracked> tracked;
+  GrpcContext kept{std::make_unique<grpc::CompletionQueue>()};
+  RunOnContext(kept, [&] { tracked.get(); });
+  {
+    GrpcContext destroyed{std::make_unique<grpc::CompletionQueue>()};
+    RunOnContext(destroyed, [&] { tracked.get(); });
+    ASSERT_EQ(Tracked::live, 2);
+    ShutDownAndDrain(destroyed);
+  }
+  ASSERT_EQ(Tracked::live, 1);
+
+  std::set<GrpcContext*> contexts;
+  tracked.ForEach(
+      [&](GrpcContext& context, const Tracked&) { contexts.insert(&context); });
+  ASSERT_EQ(contexts, (std::set<GrpcContext*>{&kept}));
+
+  ShutDownAndDrain(kept);
+}
+
+TEST(ContextLocal, ContextAtAReusedAddressGetsOneInstance) {
+  ContextLocal<SingleWriterCounter> counter;
+  std::optional<GrpcContext> context;
+  for (int i = 0; i < 2; ++i) {
+    context.emplace(std::make_unique<grpc::CompletionQueue>());
+    RunOnContext(*context, [&] { counter->Add(); });
+    ShutDownAndDrain(*context);
+    context.reset();
+  }
+  context.emplace(std::make_unique<grpc::CompletionQueue>());
+  RunOnContext(*context, [&] { counter->Add(); });
+
+  int instances = 0;
+  counter.ForEach([&](GrpcContext& c, const SingleWriterCounter& value) {
+    ASSERT_EQ(&c, &*context);
+    ASSERT_EQ(value.Read(), 1);
+    ++instances;
+  });
+  ASSERT_EQ(instances, 1);
+
+  ShutDownAndDrain(*context);
+}
+
+TEST(ContextLocal, DestroyedBeforeItsContexts) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  {
+    ContextLocal<Tracked> tracked;
+    RunOnContext(context, [&] { tracked.get(); });
+    ASSERT_EQ(Tracked::live, 1);
+  }
+  ASSERT_EQ(Tracked::live, 0);
+  ShutDownAndDrain(context);
+}
+
+}  // namespace
+}  // namespace agrpc
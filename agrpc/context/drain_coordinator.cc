@@ -0,0 +1,125 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/drain_coordinator.h"
+
+#include "agrpc/base/logging.h"
+
+namespace agrpc {
+
+DrainCoordinator::Registration::Registration(
+    DrainCoordinator& coordinator, grpc::ServerContext& server_context)
+    : state_(coordinator.state_),
+      server_context_(server_context),
+      registry_(state_->registries.get()) {
+  if (state_->draining.load(std::memory_order_acquire)) {
+    state_->accepted_while_draining.fetch_add(1, std::memory_order_relaxed);
+  }
+  std::lock_guard lock{registry_.mutex};
+  next_ = registry_.head;
+  if (next_) {
+    next_->prev_ = this;
+  }
+  registry_.head = this;
+  ++registry_.live;
+}
+
+DrainCoordinator::Registration::~Registration() {
+  {
+    std::lock_guard lock{registry_.mutex};
+    if (prev_) {
+      prev_->next_ = next_;
+    } else {
+      registry_.head = next_;
+    }
+    if (next_) {
+      next_->prev_ = prev_;
+    }
+    --registry_.live;
+  }
+  if (state_->draining.load(std::memory_order_acquire)) {
+    state_->OnExit();
+  }
+}
+
+DrainStats DrainCoordinator::Drain(
+    grpc::Server& server, std::chrono::system_clock::time_point deadline,
+    DrainOptions options) {
+  AGRPC_CHECK(detail::GrpcContextAccess::GetCurrent() == nullptr,
+              "Drain must not be called from a run loop thread.");
+  AGRPC_CHECK(!state_->draining.exchange(true, std::memory_order_acq_rel),
+              "Drain can only be called once.");
+  auto start = std::chrono::steady_clock::now();
+  DrainStats stats;
+  stats.in_flight = state_->CountLive();
+
+  server.Shutdown(deadline);
+  auto shutdown_end = std::chrono::steady_clock::now();
+  stats.shutdown_time = shutdown_end - start;
+
+  stats.cancelled = state_->CancelLive();
+  if (stats.cancelled > 0) {
+    std::unique_lock lock{state_->mutex};
+    state_->all_exited.wait_for(lock, options.cancel_grace,
+                                [&] { return state_->CountLive() == 0; });
+  }
+  stats.abandoned = state_->CountLive();
+  stats.accepted_while_draining =
+      state_->accepted_while_draining.load(std::memory_order_relaxed);
+  stats.drain_time = std::chrono::steady_clock::now() - start;
+
+  AGRPC_LOG_INFO(
+      "Drained in {} ms ({} ms in server shutdown): {} calls in flight, {} "
+      "accepted while draining, {} cancelled, {} abandoned.",
+      std::chrono::duration_cast<std::chrono::milliseconds>(stats.drain_time)
+          .count(),
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          stats.shutdown_time)
+          .count(),
+      stats.in_flight, stats.accepted_while_draining, stats.cancelled,
+      stats.abandoned);
+  return stats;
+}
+
+std::size_t DrainCoordinator::State::CountLive() const {
+  std::size_t live = 0;
+  registries.ForEach([&](GrpcContext&, const Registry& registry) {
+    std::lock_guard lock{registry.mutex};
+    live += registry.live;
+  });
+  return live;
+}
+
+std::size_t DrainCoordinator::State::CancelLive() const {
+  std::size_t cancelled = 0;
+  registries.ForEach([&](GrpcContext&, const Registry& registry) {
+    std::lock_guard lock{registry.mutex};
+    for (auto* registration = registry.head; registration;
+         registration = registration->next_) {
+      // Safe from any thread, the handler sees its operations fail.
+      registration->server_context_.TryCancel();
+      ++cancelled;
+    }
+  });
+  return cancelled;
+}
+
+void DrainCoordinator::State::OnExit() noexcept {
+  // Taking the lock orders the exit before or after `Drain` checks, so the
+  // notification is not lost.
+  std::lock_guard lock{mutex};
+  all_exited.notify_all();
+}
+
+}  // namespace agrpc
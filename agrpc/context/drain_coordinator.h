@@ -0,0 +1,157 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_CONTEXT_DRAIN_COORDINATOR_H_
+#define AGRPC_CONTEXT_DRAIN_COORDINATOR_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include <grpcpp/server.h>
+#include <grpcpp/server_context.h>
+
+#include "agrpc/context/context_local.h"
+
+namespace agrpc {
+
+struct DrainOptions {
+  // How long handlers that are still running once the server has shut down
+  // get to return after their calls were cancelled, before `Drain` gives up
+  // on them.
+  std::chrono::nanoseconds cancel_grace = std::chrono::seconds(1);
+};
+
+struct DrainStats {
+  // Calls whose handlers were running when the drain started.
+  std::uint64_t in_flight = 0;
+  // Calls accepted after the drain started, through requests that had been
+  // posted already.
+  std::uint64_t accepted_while_draining = 0;
+  // Calls whose handlers were still running once the server had shut down,
+  // and which were cancelled through their `grpc::ServerContext`.
+  std::uint64_t cancelled = 0;
+  // Calls whose handlers had not returned by the end of
+  // `DrainOptions::cancel_grace`.
+  std::uint64_t abandoned = 0;
+  // Time `grpc::Server::Shutdown` took to finish or cancel every call.
+  std::chrono::nanoseconds shutdown_time{0};
+  // Time of the whole drain.
+  std::chrono::nanoseconds drain_time{0};
+};
+
+// Shuts a server down gracefully: stops accepting calls, lets the calls in
+// flight finish until a deadline, then cancels the rest. Tracks the calls of
+// every `serve` whose options point to it:
+//
+//   agrpc::DrainCoordinator drain;
+//   scope.spawn(agrpc::serve(scheduler, ..., {.drain = &drain}));
+//   ...
+//   // E.g. on SIGTERM during a rolling deploy.
+//   agrpc::DrainStats stats =
+//       drain.Drain(*server, std::chrono::system_clock::now() +
+//                                std::chrono::seconds(10));
+//   pool.ShutDown();
+//   pool.Join();
+//
+// Hand-written accept loops take part by checking `draining()` before posting
+// a request and keeping a `Registration` for each call while handling it.
+class DrainCoordinator {
+  struct Registry;
+  struct State;
+
+ public:
+  // Tracks a call from its acceptance until its handler returned. Must be
+  // created on the run loop thread of a `GrpcContext`, and destroyed before
+  // the call's `grpc::ServerContext`. May outlive the coordinator, e.g. for a
+  // handler `Drain` gave up on.
+  class Registration {
+   public:
+    Registration(DrainCoordinator& coordinator,
+                 grpc::ServerContext& server_context);
+
+    Registration(const Registration&) = delete;
+    Registration& operator=(const Registration&) = delete;
+
+    ~Registration();
+
+   private:
+    friend DrainCoordinator;
+
+    std::shared_ptr<State> state_;
+    grpc::ServerContext& server_context_;
+    Registry& registry_;
+    Registration* prev_ = nullptr;
+    Registration* next_ = nullptr;
+  };
+
+  DrainCoordinator() = default;
+
+  DrainCoordinator(const DrainCoordinator&) = delete;
+  DrainCoordinator& operator=(const DrainCoordinator&) = delete;
+
+  // Whether a drain has started. Acceptors must not post further requests
+  // once it has.
+  bool draining() const noexcept {
+    return state_->draining.load(std::memory_order_acquire);
+  }
+
+  // Stops accepting calls and shuts down `server` with `deadline`: gRPC lets
+  // the calls in flight finish until then and cancels the rest. Handlers still
+  // running afterwards, e.g. waiting for work of their own, have their calls
+  // cancelled through their `grpc::ServerContext` and get
+  // `options.cancel_grace` to return. Blocks until then, so must not be called
+  // from a run loop thread. Can only be called once.
+  //
+  // The contexts must keep running during the drain. Shut them down
+  // afterwards.
+  DrainStats Drain(grpc::Server& server,
+                   std::chrono::system_clock::time_point deadline,
+                   DrainOptions options = {});
+
+ private:
+  // The calls of one context. Locked by its context for every call and by
+  // `Drain`, so only contended while draining.
+  struct Registry {
+    mutable std::mutex mutex;
+    Registration* head = nullptr;
+    std::size_t live = 0;
+  };
+
+  // Shared with the registrations, which may outlive the coordinator.
+  struct State {
+    std::size_t CountLive() const;
+
+    // Cancels the calls of all live registrations. Returns their number.
+    std::size_t CancelLive() const;
+
+    void OnExit() noexcept;
+
+    ContextLocal<Registry> registries;
+    std::atomic<bool> draining{false};
+    std::atomic<std::uint64_t> accepted_while_draining{0};
+    std::mutex mutex;
+    std::condition_variable all_exited;
+  };
+
+  std::shared_ptr<State> state_ = std::make_shared<State>();
+};
+
+}  // namespace agrpc
+
+#endif  // AGRPC_CONTEXT_DRAIN_COORDINATOR_H_
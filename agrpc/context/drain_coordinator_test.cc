@@ -0,0 +1,152 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/drain_coordinator.h"
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <optional>
+#include <thread>
+
+#include <fmt/core.h>
+#include <grpcpp/create_channel.h>
+#include <grpcpp/security/credentials.h>
+#include <grpcpp/security/server_credentials.h>
+#include <grpcpp/server_builder.h>
+#include <unifex/async_scope.hpp>
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/sync_wait.hpp>
+
+#include "gtest/gtest.h"
+
+#include "agrpc/context/grpc_context_pool.h"
+#include "agrpc/context/serve.h"
+#include "agrpc/testing/echo.grpc.pb.h"
+#include "agrpc/testing/grpc_context_helpers.h"
+
+namespace agrpc {
+namespace {
+
+using testing::EchoRequest;
+using testing::EchoResponse;
+using testing::EchoService;
+
+// Serves echo calls that take `delay` through a drain coordinator.
+class DrainedServer {
+ public:
+  explicit DrainedServer(std::chrono::milliseconds delay) {
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort("127.0.0.1:0", grpc::InsecureServerCredentials(),
+                             &port_);
+    builder.RegisterService(&service_);
+    pool_ = std::make_unique<GrpcContextPool>(builder, 1);
+    server_ = builder.BuildAndStart();
+    auto scheduler = pool_->get_context(0).get_scheduler();
+    scope_.spawn(serve(
+        scheduler, &EchoService::AsyncService::RequestEcho, service_,
+        [this, scheduler, delay](
+            grpc::ServerContext&, EchoRequest& request,
+            grpc::ServerAsyncResponseWriter<EchoResponse>& writer)
+            -> task<void> {
+          handler_started_.set_value();
+          co_await unifex::schedule_after(scheduler, delay);
+          EchoResponse response;
+          response.set_message(request.message());
+          co_await AsyncFinish(scheduler, writer, response, grpc::Status::OK);
+        },
+        {.outstanding_requests = 2, .drain = &drain_}));
+    pool_->Start();
+  }
+
+  ~DrainedServer() {
+    pool_->ShutDown();
+    pool_->Join();
+    unifex::sync_wait(scope_.cleanup());
+  }
+
+  std::unique_ptr<EchoService::Stub> NewStub() {
+    return EchoService::NewStub(
+        grpc::CreateChannel(fmt::format("127.0.0.1:{}", port_),
+                            grpc::InsecureChannelCredentials()));
+  }
+
+  void WaitHandlerStarted() { handler_started_.get_future().wait(); }
+
+  DrainStats Drain(std::chrono::system_clock::duration budget) {
+    return drain_.Drain(*server_, std::chrono::system_clock::now() + budget);
+  }
+
+ private:
+  int port_{0};
+  EchoService::AsyncService service_;
+  DrainCoordinator drain_;
+  std::promise<void> handler_started_;
+  std::unique_ptr<GrpcContextPool> pool_;
+  std::unique_ptr<grpc::Server> server_;
+  unifex::async_scope scope_;
+};
+
+TEST(DrainCoordinator, DrainsIdleServer) {
+  DrainedServer server{std::chrono::milliseconds(0)};
+
+  auto stats = server.Drain(std::chrono::seconds(5));
+
+  ASSERT_EQ(stats.in_flight, 0);
+  ASSERT_EQ(stats.cancelled, 0);
+  ASSERT_EQ(stats.abandoned, 0);
+}
+
+TEST(DrainCoordinator, LetsCallsInFlightFinish) {
+  DrainedServer server{std::chrono::milliseconds(100)};
+  auto stub = server.NewStub();
+
+  grpc::Status status;
+  EchoResponse response;
+  std::thread client{[&] {
+    grpc::ClientContext client_context;
+    EchoRequest request;
+    request.set_message("hello");
+    status = stub->Echo(&client_context, request, &response);
+  }};
+  server.WaitHandlerStarted();
+
+  auto stats = server.Drain(std::chrono::seconds(5));
+  client.join();
+
+  ASSERT_TRUE(status.ok());
+  ASSERT_EQ(response.message(), "hello");
+  ASSERT_EQ(stats.in_flight, 1);
+  ASSERT_EQ(stats.abandoned, 0);
+  ASSERT_GE(stats.drain_time, stats.shutdown_time);
+}
+
+TEST(DrainCoordinator, RegistrationOutlivesCoordinator) {
+  GrpcContext context;
+  grpc::ServerContext server_context;
+  auto drain = std::make_unique<DrainCoordinator>();
+  std::optional<DrainCoordinator::Registration> registration;
+  testing::RunOnContext(
+      context, [&] { registration.emplace(*drain, server_context); });
+
+  // E.g. a handler that `Drain` abandoned returning after shutdown.
+  drain.reset();
+  testing::RunOnContext(context, [&] { registration.reset(); });
+
+  ASSERT_FALSE(registration.has_value());
+  testing::ShutDownAndDrain(context);
+}
+
+}  // namespace
+}  // namespace agrpc
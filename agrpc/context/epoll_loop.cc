@@ -0,0 +1,88 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/epoll_loop.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "agrpc/base/logging.h"
+
+namespace agrpc {
+
+EpollLoop::EpollLoop(GrpcContext& context, EpollLoopOptions options)
+    : context_(context),
+      options_(options),
+      epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+      events_(options.max_io_events) {
+  AGRPC_CHECK_GT(options_.max_io_events, 0);
+  AGRPC_CHECK_GE(epoll_fd_, 0, "epoll_create1 failed: {}",
+                 std::strerror(errno));
+}
+
+EpollLoop::~EpollLoop() { close(epoll_fd_); }
+
+void EpollLoop::RunImpl(const bool& should_stop) {
+  AGRPC_DLOG_INFO("Epoll loop started");
+  while (!should_stop && !context_.is_shut_down()) {
+    std::size_t work = context_.Poll();
+    work += DispatchIoEvents(0);
+    if (work != 0) {
+      continue;
+    }
+    // Idle. gRPC events and remotely queued work end the wait right away.
+    context_.RunOne(std::chrono::steady_clock::now() +
+                    options_.max_io_latency);
+  }
+  AGRPC_DLOG_INFO("Epoll loop exited");
+}
+
+int EpollLoop::Register(Waiter* waiter, std::uint32_t events) noexcept {
+  epoll_event event{};
+  event.events = events | EPOLLONESHOT;
+  event.data.ptr = waiter;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, waiter->fd_, &event) != 0) {
+    return errno;
+  }
+  waiter->registered_ = true;
+  return 0;
+}
+
+void EpollLoop::Unregister(Waiter* waiter) noexcept {
+  // Fails only if the file descriptor has been closed meanwhile, in which case
+  // the kernel already dropped the registration.
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, waiter->fd_, nullptr);
+  waiter->registered_ = false;
+}
+
+std::size_t EpollLoop::DispatchIoEvents(int timeout_ms) noexcept {
+  int count = epoll_wait(epoll_fd_, events_.data(),
+                         static_cast<int>(events_.size()), timeout_ms);
+  if (count < 0) {
+    AGRPC_CHECK_EQ(errno, EINTR, "epoll_wait failed: {}",
+                   std::strerror(errno));
+    return 0;
+  }
+  for (int i = 0; i < count; ++i) {
+    auto* waiter = static_cast<Waiter*>(events_[i].data.ptr);
+    Unregister(waiter);
+    waiter->ready_events_ = events_[i].events;
+    detail::GrpcContextAccess::ScheduleLocal(context_, waiter);
+  }
+  return static_cast<std::size_t>(count);
+}
+
+}  // namespace agrpc
@@ -0,0 +1,297 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_CONTEXT_EPOLL_LOOP_H_
+#define AGRPC_CONTEXT_EPOLL_LOOP_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <sys/epoll.h>
+
+#include <unifex/get_stop_token.hpp>
+#include <unifex/manual_lifetime.hpp>
+#include <unifex/receiver_concepts.hpp>
+#include <unifex/stop_token_concepts.hpp>
+#include <unifex/type_traits.hpp>
+
+#include "agrpc/context/grpc_context.h"
+
+namespace agrpc {
+
+struct EpollLoopOptions {
+  // Longest time the loop blocks in the completion queue while idle before it
+  // checks the file descriptors again. gRPC completions and remotely queued
+  // work wake the loop up right away, readiness of a file descriptor is only
+  // noticed within this bound. Smaller values trade idle CPU time for I/O
+  // latency.
+  std::chrono::nanoseconds max_io_latency = std::chrono::milliseconds(1);
+
+  // Maximum number of file descriptor events handled per `epoll_wait`.
+  std::size_t max_io_events = 64;
+};
+
+// Drives a `GrpcContext` and an epoll instance from the same thread, so that
+// handlers can wait for their own sockets, pipes or eventfds without a thread
+// hop:
+//
+//   agrpc::GrpcContext grpc_context{builder.AddCompletionQueue()};
+//   agrpc::EpollLoop loop{grpc_context};
+//   ...
+//   std::uint32_t events = co_await loop.WaitReady(fd, EPOLLIN);
+//   ... read from fd ...
+//   ...
+//   loop.Run(stop_source.get_token());
+//
+// The completion queue has no file descriptor to wait on, so the idle loop
+// blocks in it for at most `EpollLoopOptions::max_io_latency` at a time.
+class EpollLoop {
+ public:
+  class WaitReadySender;
+
+  explicit EpollLoop(GrpcContext& context, EpollLoopOptions options = {});
+
+  EpollLoop(const EpollLoop&) = delete;
+  EpollLoop& operator=(const EpollLoop&) = delete;
+
+  ~EpollLoop();
+
+  // Runs the context and dispatches file descriptor events until stop is
+  // requested or the context is shut down. Used in place of
+  // `GrpcContext::Run`.
+  template <typename StopToken>
+  void Run(StopToken stop_token);
+
+  // Completes on the context with the `EPOLL*` events that are ready on `fd`
+  // out of `events`, or with a `std::error_code` if `fd` cannot be watched.
+  // There must be at most one wait per file descriptor at a time. Completes
+  // with done if stop is requested first.
+  WaitReadySender WaitReady(int fd, std::uint32_t events) noexcept;
+
+  GrpcContext& get_context() noexcept { return context_; }
+
+ private:
+  using OperationBase = detail::GrpcContextAccess::OperationBase;
+
+  struct StopOperation : OperationBase {
+    StopOperation() noexcept {
+      this->execute_ = [](OperationBase* op) noexcept {
+        static_cast<StopOperation*>(op)->should_stop_ = true;
+      };
+    }
+    bool should_stop_ = false;
+  };
+
+  // A wait registered with the epoll instance. Queued on the context once its
+  // file descriptor is ready.
+  struct Waiter : OperationBase {
+    int fd_;
+    std::uint32_t ready_events_ = 0;
+    // Whether the file descriptor is still registered. Only accessed on the
+    // loop thread.
+    bool registered_ = false;
+  };
+
+  template <typename Receiver>
+  class WaitReadyOperation;
+
+  void RunImpl(const bool& should_stop);
+
+  // Registers `waiter` for a single event. Returns 0 or an `errno` value.
+  int Register(Waiter* waiter, std::uint32_t events) noexcept;
+  void Unregister(Waiter* waiter) noexcept;
+
+  // Waits up to `timeout_ms` for file descriptor events and queues their
+  // waiters on the context. Returns the number of waiters queued.
+  std::size_t DispatchIoEvents(int timeout_ms) noexcept;
+
+  GrpcContext& context_;
+  EpollLoopOptions options_;
+  int epoll_fd_;
+  std::vector<epoll_event> events_;
+};
+
+template <typename StopToken>
+void EpollLoop::Run(StopToken stop_token) {
+  StopOperation stop_op;
+  auto on_stop_requested = [&] {
+    detail::GrpcContextAccess::Schedule(context_, &stop_op);
+  };
+  typename StopToken::template callback_type<decltype(on_stop_requested)>
+      stop_callback{std::move(stop_token), std::move(on_stop_requested)};
+  RunImpl(stop_op.should_stop_);
+}
+
+template <typename Receiver>
+class EpollLoop::WaitReadyOperation : private Waiter {
+  friend EpollLoop;
+
+ public:
+  template <typename Receiver2>
+  explicit WaitReadyOperation(EpollLoop& loop, int fd, std::uint32_t events,
+                              Receiver2&& r)
+      : loop_(loop), events_(events), receiver_((Receiver2 &&) r) {
+    this->fd_ = fd;
+  }
+
+  void start() noexcept {
+    auto& context = loop_.context_;
+    if (!detail::GrpcContextAccess::IsRunningOnThisThread(context)) {
+      this->execute_ = &WaitReadyOperation::OnScheduleComplete;
+      detail::GrpcContextAccess::Schedule(context,
+                                          static_cast<OperationBase*>(this));
+    } else {
+      StartWait();
+    }
+  }
+
+ private:
+  static constexpr bool kStoppable =
+      !unifex::is_stop_never_possible_v<unifex::stop_token_type_t<Receiver>>;
+
+  // Brings a stop request over to the loop thread, which owns the
+  // registration.
+  struct CancelOperation : OperationBase {
+    WaitReadyOperation* self;
+  };
+
+  struct CancelCallback {
+    WaitReadyOperation& op;
+    void operator()() noexcept {
+      op.stop_requested_.store(true, std::memory_order_release);
+      detail::GrpcContextAccess::Schedule(op.loop_.context_, &op.cancel_op_);
+    }
+  };
+
+  using StopCallback = typename unifex::stop_token_type_t<
+      Receiver>::template callback_type<CancelCallback>;
+
+  static void OnScheduleComplete(OperationBase* op) noexcept {
+    static_cast<WaitReadyOperation*>(op)->StartWait();
+  }
+
+  // On the loop thread, so the registration cannot fire before the stop
+  // callback is in place.
+  void StartWait() noexcept {
+    this->execute_ = &WaitReadyOperation::OnReady;
+    if (int error = loop_.Register(this, events_); error != 0) {
+      unifex::set_error(std::move(receiver_),
+                        std::error_code(error, std::system_category()));
+      return;
+    }
+    if constexpr (kStoppable) {
+      cancel_op_.execute_ = &WaitReadyOperation::OnCancel;
+      cancel_op_.self = this;
+      stop_callback_.construct(unifex::get_stop_token(receiver_),
+                               CancelCallback{*this});
+    }
+  }
+
+  static void OnReady(OperationBase* op) noexcept {
+    auto& self = *static_cast<WaitReadyOperation*>(op);
+    if constexpr (kStoppable) {
+      self.stop_callback_.destruct();
+      self.ready_ = true;
+      if (self.stop_requested_.load(std::memory_order_acquire) &&
+          !self.cancel_ran_) {
+        // The cancel operation is still queued, it completes us.
+        return;
+      }
+    }
+    self.Complete();
+  }
+
+  static void OnCancel(OperationBase* op) noexcept {
+    auto& self = *static_cast<CancelOperation*>(op)->self;
+    self.cancel_ran_ = true;
+    if (self.registered_) {
+      self.loop_.Unregister(&self);
+      self.stop_callback_.destruct();
+      self.Complete();
+    } else if (self.ready_) {
+      self.Complete();
+    }
+    // Otherwise `OnReady` is queued and completes us.
+  }
+
+  void Complete() noexcept {
+    if (stop_requested_.load(std::memory_order_relaxed)) {
+      unifex::set_done(std::move(receiver_));
+      return;
+    }
+    if constexpr (noexcept(unifex::set_value(std::move(receiver_),
+                                             this->ready_events_))) {
+      unifex::set_value(std::move(receiver_), this->ready_events_);
+    } else {
+      UNIFEX_TRY {
+        unifex::set_value(std::move(receiver_), this->ready_events_);
+      }
+      UNIFEX_CATCH(...) {
+        unifex::set_error(std::move(receiver_), std::current_exception());
+      }
+    }
+  }
+
+  EpollLoop& loop_;
+  std::uint32_t events_;
+  bool ready_ = false;
+  bool cancel_ran_ = false;
+  std::atomic<bool> stop_requested_{false};
+  CancelOperation cancel_op_;
+  unifex::manual_lifetime<StopCallback> stop_callback_;
+  Receiver receiver_;
+};
+
+class EpollLoop::WaitReadySender {
+ public:
+  template <template <typename...> class Variant,
+            template <typename...> class Tuple>
+  using value_types = Variant<Tuple<std::uint32_t>>;
+
+  template <template <typename...> class Variant>
+  using error_types = Variant<std::error_code, std::exception_ptr>;
+
+  static constexpr bool sends_done = true;
+
+  explicit WaitReadySender(EpollLoop& loop, int fd,
+                           std::uint32_t events) noexcept
+      : loop_(loop), fd_(fd), events_(events) {}
+
+  template <typename Receiver>
+  WaitReadyOperation<unifex::remove_cvref_t<Receiver>> connect(
+      Receiver&& r) const& {
+    return WaitReadyOperation<unifex::remove_cvref_t<Receiver>>{
+        loop_, fd_, events_, (Receiver &&) r};
+  }
+
+ private:
+  EpollLoop& loop_;
+  int fd_;
+  std::uint32_t events_;
+};
+
+inline EpollLoop::WaitReadySender EpollLoop::WaitReady(
+    int fd, std::uint32_t events) noexcept {
+  return WaitReadySender{*this, fd, events};
+}
+
+}  // namespace agrpc
+
+#endif  // AGRPC_CONTEXT_EPOLL_LOOP_H_
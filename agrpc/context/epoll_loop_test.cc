@@ -0,0 +1,84 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/epoll_loop.h"
+
+#include <chrono>
+#include <memory>
+#include <system_error>
+#include <thread>
+
+#include <unistd.h>
+
+#include <unifex/inplace_stop_token.hpp>
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/stop_when.hpp>
+#include <unifex/sync_wait.hpp>
+
+#include "gtest/gtest.h"
+
+namespace agrpc {
+namespace {
+
+class EpollLoopTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_EQ(pipe(fds_), 0);
+    thread_ = std::thread{[this] { loop_.Run(stop_source_.get_token()); }};
+  }
+
+  void TearDown() override {
+    stop_source_.request_stop();
+    thread_.join();
+    context_.ShutDown();
+    while (!context_.is_shut_down()) {
+      context_.RunOne();
+    }
+    close(fds_[0]);
+    close(fds_[1]);
+  }
+
+  GrpcContext context_{std::make_unique<grpc::CompletionQueue>()};
+  EpollLoop loop_{context_};
+  unifex::inplace_stop_source stop_source_;
+  std::thread thread_;
+  int fds_[2];
+};
+
+TEST_F(EpollLoopTest, WaitReadyCompletesOnReadableFd) {
+  ASSERT_EQ(write(fds_[1], "x", 1), 1);
+  auto events = unifex::sync_wait(loop_.WaitReady(fds_[0], EPOLLIN));
+  ASSERT_TRUE(events.has_value());
+  ASSERT_TRUE(*events & EPOLLIN);
+
+  // The file descriptor can be waited on again.
+  auto again = unifex::sync_wait(loop_.WaitReady(fds_[0], EPOLLIN));
+  ASSERT_TRUE(again.has_value());
+}
+
+TEST_F(EpollLoopTest, WaitReadyCompletesWithDoneOnStop) {
+  auto events = unifex::sync_wait(unifex::stop_when(
+      loop_.WaitReady(fds_[0], EPOLLIN),
+      unifex::schedule_after(context_.get_scheduler(),
+                             std::chrono::milliseconds(10))));
+  ASSERT_FALSE(events.has_value());
+}
+
+TEST_F(EpollLoopTest, WaitReadyFailsOnBadFd) {
+  ASSERT_THROW(unifex::sync_wait(loop_.WaitReady(-1, EPOLLIN)),
+               std::system_error);
+}
+
+}  // namespace
+}  // namespace agrpc
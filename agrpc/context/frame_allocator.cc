@@ -0,0 +1,122 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/frame_allocator.h"
+
+#include <array>
+#include <new>
+
+#include "agrpc/base/likely.h"
+#include "agrpc/context/context_local.h"
+#include "agrpc/context/grpc_context.h"
+
+namespace agrpc {
+
+namespace {
+
+constexpr std::size_t kSizeClasses =
+    detail::kMaxCachedFrameSize / detail::kFrameSizeClass;
+
+// Most free frames kept per size class. Frames freed beyond that go back to
+// the heap, so that frames moving from context to context cannot pile up.
+constexpr std::size_t kMaxFreeFramesPerClass = 256;
+
+class FrameCache {
+ public:
+  FrameCache() = default;
+
+  FrameCache(const FrameCache&) = delete;
+  FrameCache& operator=(const FrameCache&) = delete;
+
+  ~FrameCache() {
+    for (std::size_t i = 0; i < kSizeClasses; ++i) {
+      while (auto* frame = free_lists_[i].head) {
+        free_lists_[i].head = frame->next;
+        ::operator delete(frame);
+      }
+    }
+  }
+
+  void* Allocate(std::size_t size_class) {
+    auto& free_list = free_lists_[size_class];
+    if (AGRPC_LIKELY(free_list.head != nullptr)) {
+      auto* frame = free_list.head;
+      free_list.head = frame->next;
+      --free_list.size;
+      return frame;
+    }
+    return ::operator new(GetClassSize(size_class));
+  }
+
+  void Deallocate(void* frame, std::size_t size_class) noexcept {
+    auto& free_list = free_lists_[size_class];
+    if (AGRPC_UNLIKELY(free_list.size == kMaxFreeFramesPerClass)) {
+      ::operator delete(frame);
+      return;
+    }
+    free_list.head = new (frame) FreeFrame{free_list.head};
+    ++free_list.size;
+  }
+
+  static std::size_t GetClassSize(std::size_t size_class) noexcept {
+    return (size_class + 1) * detail::kFrameSizeClass;
+  }
+
+ private:
+  struct FreeFrame {
+    FreeFrame* next;
+  };
+
+  struct FreeList {
+    FreeFrame* head = nullptr;
+    std::size_t size = 0;
+  };
+
+  std::array<FreeList, kSizeClasses> free_lists_;
+};
+
+// Never destroyed, since frames may still be freed during static destruction.
+// The cache of each context, with the frames it holds, is still freed when
+// that context is destroyed, see `ContextLocal`.
+ContextLocal<FrameCache>& GetFrameCaches() {
+  static auto* caches = new ContextLocal<FrameCache>();
+  return *caches;
+}
+
+std::size_t GetSizeClass(std::size_t size) noexcept {
+  return (size - 1) / detail::kFrameSizeClass;
+}
+
+}  // namespace
+
+void* detail::AllocateFrame(std::size_t size) {
+  if (size > kMaxCachedFrameSize ||
+      GrpcContextAccess::GetCurrent() == nullptr) {
+    return ::operator new(size <= kMaxCachedFrameSize
+                              ? FrameCache::GetClassSize(GetSizeClass(size))
+                              : size);
+  }
+  return GetFrameCaches()->Allocate(GetSizeClass(size));
+}
+
+void detail::DeallocateFrame(void* frame, std::size_t size) noexcept {
+  if (size > kMaxCachedFrameSize ||
+      GrpcContextAccess::GetCurrent() == nullptr) {
+    ::operator delete(frame);
+    return;
+  }
+  GetFrameCaches()->Deallocate(frame, GetSizeClass(size));
+}
+
+}  // namespace agrpc
@@ -0,0 +1,39 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_CONTEXT_FRAME_ALLOCATOR_H_
+#define AGRPC_CONTEXT_FRAME_ALLOCATOR_H_
+
+#include <cstddef>
+
+namespace agrpc {
+namespace detail {
+
+// Allocation of coroutine frames from size-class free lists of the context
+// running on this thread, see `agrpc::task`. Sizes above
+// `kMaxCachedFrameSize` and threads not running a context use the global
+// heap. Memory may be freed on a different thread than it was allocated on;
+// it then goes to that thread's context, or back to the heap if there is
+// none. The free lists of a context are returned to the heap when the context
+// is destroyed.
+inline constexpr std::size_t kFrameSizeClass = 64;
+inline constexpr std::size_t kMaxCachedFrameSize = 4096;
+
+void* AllocateFrame(std::size_t size);
+void DeallocateFrame(void* frame, std::size_t size) noexcept;
+
+}  // namespace detail
+}  // namespace agrpc
+
+#endif  // AGRPC_CONTEXT_FRAME_ALLOCATOR_H_
@@ -14,7 +14,11 @@
 
 #include "agrpc/context/grpc_context.h"
 
+#include <algorithm>
+#include <chrono>
+#include <mutex>
 #include <utility>
+#include <vector>
 
 #include <unifex/scope_guard.hpp>
 
@@ -27,11 +31,124 @@ static thread_local GrpcContext* current_thread_context;
 
 static constexpr void* remote_queue_event_user_data = nullptr;
 
+// Timer wheel ticks are milliseconds of the steady clock. Deadlines round up,
+// so that timers never fire early by the wheel's clock.
+static TimerWheel::Tick ToTick(std::chrono::steady_clock::time_point now) {
+  return std::chrono::floor<std::chrono::milliseconds>(now.time_since_epoch())
+      .count();
+}
+
+static TimerWheel::Tick ToDeadlineTick(
+    std::chrono::steady_clock::time_point deadline) {
+  return std::chrono::ceil<std::chrono::milliseconds>(
+             deadline.time_since_epoch())
+      .count();
+}
+
+// gRPC's monotonic clock has a different epoch, so the deadline is passed on
+// relative to now.
+static gpr_timespec ToGprDeadline(
+    std::chrono::steady_clock::time_point deadline) {
+  if (deadline == std::chrono::steady_clock::time_point::max()) {
+    return gpr_inf_future(GPR_CLOCK_MONOTONIC);
+  }
+  auto delay = deadline - std::chrono::steady_clock::now();
+  return gpr_time_add(
+      gpr_now(GPR_CLOCK_MONOTONIC),
+      gpr_time_from_nanos(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(delay).count(),
+          GPR_TIMESPAN));
+}
+
+namespace {
+
+struct ObserverRegistry {
+  std::mutex mutex;
+  std::vector<detail::GrpcContextObserver*> observers;
+};
+
+// Never destroyed, since observers may be removed during static destruction.
+ObserverRegistry& GetObserverRegistry() {
+  static auto* registry = new ObserverRegistry();
+  return *registry;
+}
+
+// Marks `context` as running on this thread for the lifetime of the scope.
+class CurrentThreadContextScope {
+ public:
+  explicit CurrentThreadContextScope(GrpcContext* context) noexcept
+      : old_context_(std::exchange(current_thread_context, context)) {}
+
+  ~CurrentThreadContextScope() { current_thread_context = old_context_; }
+
+  CurrentThreadContextScope(const CurrentThreadContextScope&) = delete;
+  CurrentThreadContextScope& operator=(const CurrentThreadContextScope&) =
+      delete;
+
+ private:
+  GrpcContext* old_context_;
+};
+
+}  // namespace
+
 GrpcContext::GrpcContext(
-    std::unique_ptr<grpc::CompletionQueue> completion_queue)
-    : completion_queue_(std::move(completion_queue)) {}
+    std::unique_ptr<grpc::CompletionQueue> completion_queue,
+    GrpcContextOptions options)
+    : completion_queue_(std::move(completion_queue)),
+      options_(options),
+      spin_budget_(options.max_spin_budget),
+      timer_wheel_(ToTick(ReadCoarseSteadyClock())) {
+  AGRPC_CHECK_GT(options_.completion_queue_batch_size, 0);
+  AGRPC_CHECK_GT(options_.local_work_item_budget, 0);
+  AGRPC_CHECK_LE(options_.min_spin_budget, options_.max_spin_budget);
+  timer_shut_down_op_.context_ = this;
+  timer_shut_down_op_.execute_ = [](OperationBase* op) noexcept {
+    static_cast<TimerShutDownOperation*>(op)->context_->ShutDownTimers();
+  };
+}
+
+void GrpcContext::ShutDown() {
+  // Repeating the shutdown would queue `timer_shut_down_op_` twice and touch
+  // a completion queue that is already shut down.
+  if (shut_down_.exchange(true, std::memory_order_acq_rel)) {
+    return;
+  }
+  // A pending timer alarm would hold up the completion queue shutdown, so the
+  // loop thread gets rid of it first.
+  if (IsRunningOnThisThread()) {
+    ShutDownTimers();
+  } else {
+    ScheduleRemote(&timer_shut_down_op_);
+  }
+  completion_queue_->Shutdown();
+}
 
-GrpcContext::~GrpcContext() {}
+GrpcContext::~GrpcContext() {
+  auto& registry = GetObserverRegistry();
+  std::lock_guard lock{registry.mutex};
+  for (auto* observer : registry.observers) {
+    observer->OnContextDestroyed(*this);
+  }
+}
+
+void detail::AddGrpcContextObserver(GrpcContextObserver* observer) {
+  auto& registry = GetObserverRegistry();
+  std::lock_guard lock{registry.mutex};
+  registry.observers.push_back(observer);
+}
+
+void detail::RemoveGrpcContextObserver(
+    GrpcContextObserver* observer) noexcept {
+  auto& registry = GetObserverRegistry();
+  std::lock_guard lock{registry.mutex};
+  auto& observers = registry.observers;
+  observers.erase(std::remove(observers.begin(), observers.end(), observer),
+                  observers.end());
+}
+
+GrpcContext* detail::GrpcContextAccess::GetCurrent() noexcept {
+  return current_thread_context;
+}
 
 bool GrpcContext::IsRunningOnThisThread() const noexcept {
   return this == current_thread_context;
@@ -40,11 +157,8 @@ bool GrpcContext::IsRunningOnThisThread() const noexcept {
 void GrpcContext::RunImpl(const bool& should_stop) {
   AGRPC_DLOG_INFO("Run loop started");
 
-  auto* old_context = std::exchange(current_thread_context, this);
-  unifex::scope_guard g = [=]() noexcept {
-    std::exchange(current_thread_context, old_context);
-    AGRPC_DLOG_INFO("Run loop exited");
-  };
+  CurrentThreadContextScope scope{this};
+  unifex::scope_guard g = []() noexcept { AGRPC_DLOG_INFO("Run loop exited"); };
 
   while (true) {
     // Dequeue and process local queue items (ready to run)
@@ -66,6 +180,55 @@ void GrpcContext::RunImpl(const bool& should_stop) {
   }
 }
 
+std::size_t GrpcContext::Poll() {
+  CurrentThreadContextScope scope{this};
+  std::size_t count = ExecutePendingLocal();
+  if (completion_queue_drained_) {
+    return count;
+  }
+  PollCompletionQueue(options_.completion_queue_batch_size);
+  if (!remote_queue_read_submitted_) {
+    remote_queue_read_submitted_ = TryScheduleRemoteQueuedItems();
+  }
+  return count + ExecutePendingLocal();
+}
+
+std::size_t GrpcContext::RunOne(
+    std::chrono::steady_clock::time_point deadline) {
+  CurrentThreadContextScope scope{this};
+  while (true) {
+    if (ExecuteOneLocal()) {
+      return 1;
+    }
+    if (!remote_queue_read_submitted_) {
+      remote_queue_read_submitted_ = TryScheduleRemoteQueuedItems();
+      if (HasPendingLocal()) {
+        continue;
+      }
+    }
+    if (completion_queue_drained_) {
+      return 0;
+    }
+    // Only block once the remote queue is inactive, so that producers wake us
+    // up.
+    if (!remote_queue_read_submitted_) {
+      continue;
+    }
+    void* tag;
+    bool ok;
+    auto status =
+        completion_queue_->AsyncNext(&tag, &ok, ToGprDeadline(deadline));
+    if (status == grpc::CompletionQueue::GOT_EVENT) {
+      OnCompletionQueueEvent(tag, ok);
+    } else {
+      if (status == grpc::CompletionQueue::SHUTDOWN) {
+        completion_queue_drained_ = true;
+      }
+      return 0;
+    }
+  }
+}
+
 void GrpcContext::ScheduleImpl(OperationBase* op) {
   AGRPC_CHECK(op != nullptr);
   if (IsRunningOnThisThread()) {
@@ -75,16 +238,80 @@ void GrpcContext::ScheduleImpl(OperationBase* op) {
   }
 }
 
+// Operations without a deadline go to the last bucket. The others are spread
+// over logarithmic buckets of their remaining time in microseconds, with
+// bucket 0 for those that have expired.
+static std::size_t GetDeadlineBucket(
+    std::chrono::steady_clock::time_point deadline) noexcept {
+  constexpr std::size_t kNoDeadlineBucket = 63;
+  if (deadline == std::chrono::steady_clock::time_point::max()) {
+    return kNoDeadlineBucket;
+  }
+  auto slack = std::chrono::duration_cast<std::chrono::microseconds>(
+                   deadline - ReadCoarseSteadyClock())
+                   .count();
+  if (slack < 0) {
+    return 0;
+  }
+  std::size_t log2 =
+      63 - __builtin_clzll(static_cast<std::uint64_t>(slack) | 1);
+  return std::min(1 + log2, kNoDeadlineBucket - 1);
+}
+
 void GrpcContext::ScheduleLocal(OperationBase* op) noexcept {
-  local_queue_.push_back(op);
+  if (options_.scheduling_policy == SchedulingPolicy::kEarliestDeadlineFirst &&
+      !executing_by_deadline_) {
+    deadline_queue_.push(op, GetDeadlineBucket(op->deadline_));
+  } else {
+    local_queue_.push_back(op);
+  }
 }
 
 void GrpcContext::ScheduleLocal(OperationQueue ops) noexcept {
-  local_queue_.append(std::move(ops));
+  if (options_.scheduling_policy == SchedulingPolicy::kEarliestDeadlineFirst &&
+      !executing_by_deadline_) {
+    while (!ops.empty()) {
+      ScheduleLocal(ops.pop_front());
+    }
+  } else {
+    local_queue_.append(std::move(ops));
+  }
+}
+
+namespace {
+
+// Limits how much local work a single loop iteration runs, so that a burst of
+// ready operations does not hold up polling the completion and remote queues.
+class LocalWorkBudget {
+ public:
+  explicit LocalWorkBudget(const GrpcContextOptions& options) noexcept
+      : max_items_(options.local_work_item_budget),
+        check_time_(options.local_work_time_budget !=
+                    std::chrono::nanoseconds::max()) {
+    if (check_time_) {
+      end_ = ReadCoarseSteadyClock() + options.local_work_time_budget;
+    }
+  }
+
+  bool IsExhausted(std::size_t items_run) const noexcept {
+    return items_run >= max_items_ ||
+           (check_time_ && items_run != 0 && ReadCoarseSteadyClock() >= end_);
+  }
+
+ private:
+  std::size_t max_items_;
+  bool check_time_;
+  std::chrono::steady_clock::time_point end_;
+};
+
+}  // namespace
+
+bool GrpcContext::HasPendingLocal() const noexcept {
+  return !local_queue_.empty() || !deadline_queue_.empty();
 }
 
 void GrpcContext::ScheduleRemote(OperationBase* op) noexcept {
-  bool processing_thread_was_inactive = remote_queue_.enqueue(op);
+  bool processing_thread_was_inactive = remote_queue_.Enqueue(op);
   if (processing_thread_was_inactive) {
     // We were the first to queue an item and the processing thread
     // is not going to check the queue until we signal it that new
@@ -94,55 +321,302 @@ void GrpcContext::ScheduleRemote(OperationBase* op) noexcept {
   }
 }
 
-void GrpcContext::ExecutePendingLocal() noexcept {
+void GrpcContext::ScheduleRemote(OperationQueue ops) noexcept {
+  if (ops.empty()) {
+    return;
+  }
+  if (remote_queue_.EnqueueAll(std::move(ops))) {
+    SignalRemoteQueue();
+  }
+}
+
+std::size_t GrpcContext::ExecutePendingLocal() noexcept {
+  if (options_.scheduling_policy == SchedulingPolicy::kEarliestDeadlineFirst) {
+    return ExecutePendingByDeadline();
+  }
   if (local_queue_.empty()) {
     AGRPC_DLOG_INFO("local queue is empty");
-    return;
+    return 0;
   }
 
   AGRPC_DLOG_INFO("Processing local queue items");
 
   size_t count = 0;
   auto pending = std::move(local_queue_);
+  LocalWorkBudget budget{options_};
   while (!pending.empty()) {
+    if (AGRPC_UNLIKELY(budget.IsExhausted(count))) {
+      // Leave the rest for the next iteration, ahead of what was queued
+      // meanwhile.
+      starvation_events_.Add();
+      pending.append(std::move(local_queue_));
+      local_queue_ = std::move(pending);
+      break;
+    }
     auto* item = pending.pop_front();
     item->execute_(item);
     ++count;
   }
 
   AGRPC_DLOG_INFO("Processed {} local queue items", count);
+  return count;
 }
 
-bool GrpcContext::AcquireCompletionQueueItems() noexcept {
-  bool got_event = completion_queue_->Next(&event_.tag, &event_.ok);
-  if (AGRPC_UNLIKELY(!got_event))
+std::size_t GrpcContext::ExecutePendingByDeadline() noexcept {
+  if (deadline_queue_.empty()) {
+    AGRPC_DLOG_INFO("local queue is empty");
+    return 0;
+  }
+
+  AGRPC_DLOG_INFO("Processing local queue items by deadline");
+
+  // Work that becomes ready during the pass is held back in `local_queue_`, so
+  // that the pass is bounded like its FIFO counterpart, and so that yielding
+  // gives the loop back even to an operation with an early deadline.
+  size_t count = 0;
+  auto now = ReadCoarseSteadyClock();
+  LocalWorkBudget budget{options_};
+  executing_by_deadline_ = true;
+  while (!deadline_queue_.empty()) {
+    if (AGRPC_UNLIKELY(budget.IsExhausted(count))) {
+      starvation_events_.Add();
+      break;
+    }
+    auto* item = deadline_queue_.pop_front();
+    current_work_expired_ = item->deadline_ < now;
+    if (AGRPC_UNLIKELY(current_work_expired_)) {
+      expired_work_.Add();
+    }
+    item->execute_(item);
+    ++count;
+  }
+  current_work_expired_ = false;
+  executing_by_deadline_ = false;
+  ScheduleLocal(std::move(local_queue_));
+
+  AGRPC_DLOG_INFO("Processed {} local queue items", count);
+  return count;
+}
+
+bool GrpcContext::ExecuteOneLocal() noexcept {
+  // Outside of a pass, `local_queue_` is always empty under
+  // `SchedulingPolicy::kEarliestDeadlineFirst`.
+  if (!local_queue_.empty()) {
+    auto* item = local_queue_.pop_front();
+    item->execute_(item);
+    return true;
+  }
+  if (deadline_queue_.empty()) {
     return false;
-  if (event_.tag == remote_queue_event_user_data) {
+  }
+  auto* item = deadline_queue_.pop_front();
+  current_work_expired_ = item->deadline_ < ReadCoarseSteadyClock();
+  if (AGRPC_UNLIKELY(current_work_expired_)) {
+    expired_work_.Add();
+  }
+  item->execute_(item);
+  current_work_expired_ = false;
+  return true;
+}
+
+bool GrpcContext::AcquireCompletionQueueItems() noexcept {
+  void* tag;
+  bool ok;
+  std::size_t acquired = 0;
+  if (!HasPendingLocal()) {
+    // Nothing else to do, wait for the first event.
+    bool got_event =
+        options_.polling_policy == PollingPolicy::kAdaptiveBusyPoll
+            ? BusyPollCompletionQueue(&tag, &ok)
+            : completion_queue_->Next(&tag, &ok);
+    if (AGRPC_UNLIKELY(!got_event)) {
+      completion_queue_drained_ = true;
+      return false;
+    }
+    OnCompletionQueueEvent(tag, ok);
+    ++acquired;
+  }
+
+  // Drain whatever else is ready without blocking. A shutdown seen here is
+  // reported by the blocking `Next` of a later iteration.
+  PollCompletionQueue(options_.completion_queue_batch_size - acquired);
+  return true;
+}
+
+std::size_t GrpcContext::PollCompletionQueue(std::size_t max_events) noexcept {
+  void* tag;
+  bool ok;
+  std::size_t acquired = 0;
+  for (; acquired < max_events; ++acquired) {
+    auto status = completion_queue_->AsyncNext(
+        &tag, &ok, gpr_time_0(GPR_CLOCK_MONOTONIC));
+    if (status != grpc::CompletionQueue::GOT_EVENT) {
+      if (status == grpc::CompletionQueue::SHUTDOWN) {
+        completion_queue_drained_ = true;
+      }
+      break;
+    }
+    OnCompletionQueueEvent(tag, ok);
+  }
+  return acquired;
+}
+
+bool GrpcContext::BusyPollCompletionQueue(void** tag, bool* ok) noexcept {
+  auto start = std::chrono::steady_clock::now();
+  auto spin_deadline = start + spin_budget_;
+  auto now = start;
+  do {
+    auto status =
+        completion_queue_->AsyncNext(tag, ok, gpr_time_0(GPR_CLOCK_MONOTONIC));
+    now = std::chrono::steady_clock::now();
+    if (status == grpc::CompletionQueue::GOT_EVENT) {
+      spin_hits_.Add();
+      spin_time_ns_.Add(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(now - start)
+              .count());
+      UpdateSpinBudget(now - start);
+      return true;
+    }
+    if (AGRPC_UNLIKELY(status == grpc::CompletionQueue::SHUTDOWN)) {
+      return false;
+    }
+  } while (now < spin_deadline);
+
+  spin_misses_.Add();
+  spin_time_ns_.Add(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(now - start)
+          .count());
+  bool got_event = completion_queue_->Next(tag, ok);
+  UpdateSpinBudget(std::chrono::steady_clock::now() - start);
+  return got_event;
+}
+
+void GrpcContext::UpdateSpinBudget(
+    std::chrono::nanoseconds idle_time) noexcept {
+  // Weight of 1/8 for the newest sample.
+  average_idle_time_ += (idle_time - average_idle_time_) / 8;
+  // Spin through gaps that are expected to end within the maximum budget,
+  // otherwise don't bother.
+  auto wanted = 2 * average_idle_time_;
+  spin_budget_ = wanted <= options_.max_spin_budget
+                     ? std::max(wanted, options_.min_spin_budget)
+                     : options_.min_spin_budget;
+}
+
+void GrpcContext::OnCompletionQueueEvent(void* tag, bool ok) noexcept {
+  if (tag == remote_queue_event_user_data) {
     // Skip processing this item and let the loop check
     // for the remote-queued items next time around.
     remote_queue_read_submitted_ = false;
+  } else if (tag == &timer_alarm_) {
+    OnTimerAlarm(ok);
   } else {
-    auto& completion_state = *reinterpret_cast<OperationBase*>(event_.tag);
-    ScheduleLocal(&completion_state);
+    auto* op = static_cast<OperationBase*>(tag);
+    op->ok_ = ok;
+    ScheduleLocal(op);
   }
-  return true;
 }
 
 bool GrpcContext::TryScheduleRemoteQueuedItems() noexcept {
-  auto queued_items = remote_queue_.try_mark_inactive_or_dequeue_all();
+  if (HasPendingLocal()) {
+    // The loop won't block in this iteration, so keep the queue active and
+    // spare producers the alarm.
+    ScheduleLocal(remote_queue_.DequeueAll());
+    return false;
+  }
+  OperationQueue queued_items;
+  bool marked_inactive =
+      remote_queue_.TryMarkInactiveOrDequeueAll(queued_items);
   if (!queued_items.empty()) {
+    // Even if the queue ended up inactive, items that raced with marking it
+    // so have to be run.
     AGRPC_DLOG_INFO("Schedule remote queued items");
     ScheduleLocal(std::move(queued_items));
-    return false;
   } else {
     AGRPC_DLOG_INFO("Remote queue is empty");
   }
-  return true;
+  return marked_inactive;
+}
+
+void GrpcContext::AddTimer(
+    TimerOperation* op,
+    std::chrono::steady_clock::time_point deadline) noexcept {
+  if (AGRPC_UNLIKELY(timers_shut_down_)) {
+    op->ok_ = false;
+    ScheduleLocal(op);
+    return;
+  }
+  op->ok_ = true;
+  timer_wheel_.Insert(op, ToDeadlineTick(deadline));
+  ArmTimerAlarm();
+}
+
+void GrpcContext::CancelTimer(TimerOperation* op) noexcept {
+  // The alarm is left armed, it finds nothing to do if this was the earliest
+  // timer.
+  timer_wheel_.Remove(op);
+}
+
+void GrpcContext::ArmTimerAlarm() noexcept {
+  auto next = timer_wheel_.GetNextExpiry();
+  if (!next || timers_shut_down_) {
+    return;
+  }
+  if (timer_alarm_armed_) {
+    if (*next < timer_alarm_tick_ && !timer_alarm_cancelled_) {
+      // Re-armed for the earlier expiry once the cancellation comes back.
+      timer_alarm_cancelled_ = true;
+      timer_alarm_.Cancel();
+    }
+    return;
+  }
+  auto deadline = ToGprDeadline(
+      std::chrono::steady_clock::time_point(std::chrono::milliseconds(*next)));
+  timer_alarm_.Set(completion_queue_.get(), deadline, &timer_alarm_);
+  timer_alarm_armed_ = true;
+  timer_alarm_tick_ = *next;
+}
+
+void GrpcContext::OnTimerAlarm(bool ok) noexcept {
+  timer_alarm_armed_ = false;
+  timer_alarm_cancelled_ = false;
+  if (AGRPC_UNLIKELY(timers_shut_down_)) {
+    timer_wheel_.RemoveAll([this](TimerWheel::Entry* entry) {
+      auto* op = static_cast<TimerOperation*>(entry);
+      op->ok_ = false;
+      ScheduleLocal(op);
+    });
+    return;
+  }
+  auto now = ToTick(ReadCoarseSteadyClock());
+  if (ok) {
+    // The coarse clock may lag behind the alarm, which already knows that its
+    // tick has passed.
+    now = std::max(now, timer_alarm_tick_);
+  }
+  timer_wheel_.Advance(now, [this](TimerWheel::Entry* entry) {
+    ScheduleLocal(static_cast<TimerOperation*>(entry));
+  });
+  ArmTimerAlarm();
+}
+
+void GrpcContext::ShutDownTimers() noexcept {
+  timers_shut_down_ = true;
+  if (timer_alarm_armed_) {
+    if (!timer_alarm_cancelled_) {
+      timer_alarm_cancelled_ = true;
+      timer_alarm_.Cancel();
+    }
+  } else {
+    // Nothing is pending on the completion queue, drop the timers right away.
+    OnTimerAlarm(false);
+  }
 }
 
 void GrpcContext::SignalRemoteQueue() {
+  // A deadline in the past fires right away without reading the clock.
   work_alarm_.Set(completion_queue_.get(),
-                  gpr_now(gpr_clock_type::GPR_CLOCK_REALTIME),
+                  gpr_inf_past(gpr_clock_type::GPR_CLOCK_MONOTONIC),
                   remote_queue_event_user_data);
 }
 
@@ -16,29 +16,116 @@
 #define AGRPC_CONTEXT_GRPC_CONTEXT_H_
 
 #include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
 
 #include <grpcpp/alarm.h>
+#include <grpcpp/client_context.h>
 #include <grpcpp/completion_queue.h>
+#include <grpcpp/support/status.h>
 
-#include <unifex/detail/atomic_intrusive_queue.hpp>
 #include <unifex/detail/intrusive_queue.hpp>
+#include <unifex/get_stop_token.hpp>
+#include <unifex/manual_lifetime.hpp>
 #include <unifex/receiver_concepts.hpp>
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/stop_token_concepts.hpp>
 #include <unifex/type_traits.hpp>
 
+#include "agrpc/base/align.h"
+#include "agrpc/base/bucket_queue.h"
+#include "agrpc/base/chrono.h"
+#include "agrpc/base/counter.h"
 #include "agrpc/base/logging.h"
+#include "agrpc/base/sharded_mpsc_queue.h"
+#include "agrpc/base/timer_wheel.h"
 #include "agrpc/context/rpcs.h"
 
 namespace agrpc {
 
-namespace detail {
+enum class SchedulingPolicy {
+  // Run ready operations in the order they became ready.
+  kFifo,
+  // Run ready operations with earlier deadlines first, see
+  // `GrpcContext::Scheduler::WithDeadline`. Operations are bucketed by the
+  // logarithm of their remaining time, so ordering within a factor of two of
+  // slack is FIFO.
+  kEarliestDeadlineFirst,
+};
 
-struct GrpcCompletionQueueEvent {
-  void* tag{nullptr};
-  bool ok{false};
+enum class PollingPolicy {
+  // Block in `CompletionQueue::Next` whenever there is nothing to do.
+  kBlocking,
+  // Spin on zero-deadline `AsyncNext` calls for an adaptive budget before
+  // blocking. Trades CPU time for lower wakeup latency on dedicated cores.
+  kAdaptiveBusyPoll,
 };
 
+struct GrpcContextOptions {
+  // Maximum number of completion queue events acquired per run loop
+  // iteration. The loop blocks in `CompletionQueue::Next` for the first event
+  // and then drains up to `completion_queue_batch_size - 1` ready events with
+  // zero-deadline `AsyncNext` calls, so a burst is dispatched in one pass.
+  std::size_t completion_queue_batch_size = 1;
+
+  SchedulingPolicy scheduling_policy = SchedulingPolicy::kFifo;
+
+  // Budget for running ready operations in one run loop iteration. Once either
+  // is used up, the loop polls the completion and remote queues before running
+  // the rest. The time budget is measured with the coarse steady clock, so it
+  // is only useful in the order of milliseconds. Unlimited by default.
+  std::size_t local_work_item_budget = std::numeric_limits<std::size_t>::max();
+  std::chrono::nanoseconds local_work_time_budget =
+      std::chrono::nanoseconds::max();
+
+  PollingPolicy polling_policy = PollingPolicy::kBlocking;
+
+  // Bounds of the spin budget under `PollingPolicy::kAdaptiveBusyPoll`. The
+  // budget follows the recently observed gap between events: gaps short enough
+  // to fit into `max_spin_budget` are spun through, longer ones only get
+  // `min_spin_budget` before the loop blocks.
+  std::chrono::nanoseconds min_spin_budget = std::chrono::microseconds(1);
+  std::chrono::nanoseconds max_spin_budget = std::chrono::microseconds(50);
+};
+
+struct GrpcContextStats {
+  // Busy polls that got an event within the spin budget.
+  std::uint64_t spin_hits = 0;
+  // Busy polls that ran out of budget and fell back to blocking.
+  std::uint64_t spin_misses = 0;
+  // Total time spent spinning.
+  std::chrono::nanoseconds spin_time{0};
+  // Operations that were run after their deadline had passed.
+  std::uint64_t expired_work = 0;
+  // Iterations that ran out of local work budget with ready operations left.
+  std::uint64_t starvation_events = 0;
+};
+
+class GrpcContext;
+
+namespace detail {
+
+// Lets primitives built outside of `GrpcContext` queue their own operations.
+struct GrpcContextAccess;
+
+// Whether an `AsyncRPCSender` for `AsyncRPC` counts towards the outstanding
+// work of its context while in flight. Operations that gRPC may never
+// complete opt out with a `kCountsAsWork = false` member.
+template <typename AsyncRPC>
+constexpr bool CountsAsOutstandingWork() noexcept {
+  if constexpr (requires { AsyncRPC::kCountsAsWork; }) {
+    return AsyncRPC::kCountsAsWork;
+  } else {
+    return true;
+  }
+}
+
 }  // namespace detail
 
 class GrpcContext {
@@ -48,13 +135,44 @@ class GrpcContext {
   template <typename AsyncRPC>
   class AsyncRPCSender;
 
-  GrpcContext(std::unique_ptr<grpc::CompletionQueue> completion_queue);
+  class ScheduleSender;
+  class ScheduleAtSender;
+  class ScheduleAfterSender;
+
+  GrpcContext(std::unique_ptr<grpc::CompletionQueue> completion_queue,
+              GrpcContextOptions options = {});
 
   ~GrpcContext();
 
   template <typename StopToken>
   void Run(StopToken stopToken);
 
+  // Runs the operations that are ready, then picks up remotely queued work and
+  // completion queue events without blocking and runs what became ready.
+  // Returns the number of operations run. Meant for threads that drive the
+  // context from a loop of their own, see `EpollLoop`. Must not be called
+  // concurrently with `Run`, `RunOne` or itself.
+  std::size_t Poll();
+
+  // Runs at most one operation, waiting until `deadline` for one to become
+  // ready. Returns the number of operations run, i.e. 0 if `deadline` passed
+  // or the context is shut down. Same restrictions as `Poll`.
+  std::size_t RunOne(std::chrono::steady_clock::time_point deadline =
+                         std::chrono::steady_clock::time_point::max());
+
+  // Whether the run loop has seen the completion queue shut down and drained.
+  // `Poll` and `RunOne` return 0 right away from then on. Only meaningful on
+  // the thread driving the context.
+  bool is_shut_down() const noexcept;
+
+  // Whether `ShutDown` has been called, after which no further operations may
+  // be started on the completion queue. Safe to call from any thread.
+  bool is_shutting_down() const noexcept;
+
+  // Shuts down the completion queue. Pending timers complete with done. For
+  // servers, shut the server down first, gracefully through a
+  // `DrainCoordinator` if calls in flight should get to finish. Can be called
+  // from any thread; only the first call has an effect.
   void ShutDown();
 
   Scheduler get_scheduler() noexcept;
@@ -62,11 +180,33 @@ class GrpcContext {
   grpc::CompletionQueue* get_completion_queue() noexcept;
   grpc::ServerCompletionQueue* get_server_completion_queue() noexcept;
 
+  // Number of asynchronous RPC operations and timers started on this context
+  // that have not completed yet, not counting `AsyncNotifyWhenDone`. Safe to
+  // read from any thread, but only a snapshot.
+  std::size_t get_outstanding_work() const noexcept;
+
+  // Snapshot of the run loop counters. Safe to call from any thread.
+  GrpcContextStats get_stats() const noexcept;
+
+  // Whether the operation being run on this context had passed its deadline
+  // when it was dequeued, so that the continuation can short-circuit. Only
+  // meaningful on the run loop thread, and only set under
+  // `SchedulingPolicy::kEarliestDeadlineFirst`.
+  bool is_current_work_expired() const noexcept;
+
  private:
+  friend detail::GrpcContextAccess;
+
   struct OperationBase {
     OperationBase() noexcept {}
     OperationBase* next_;
     void (*execute_)(OperationBase*) noexcept;
+    // The `ok` flag of the completion queue event that completed this
+    // operation.
+    bool ok_;
+    // Orders the operation under `SchedulingPolicy::kEarliestDeadlineFirst`.
+    std::chrono::steady_clock::time_point deadline_ =
+        std::chrono::steady_clock::time_point::max();
   };
 
   struct StopOperation : OperationBase {
@@ -78,10 +218,23 @@ class GrpcContext {
     bool should_stop_ = false;
   };
 
+  // An operation waiting on the timer wheel. Completes with `ok_` set, or
+  // cleared if the timers were shut down.
+  struct TimerOperation : OperationBase, TimerWheel::Entry {};
+
+  template <typename Receiver>
+  class TimerSenderOperation;
+
+  struct TimerShutDownOperation : OperationBase {
+    GrpcContext* context_;
+  };
+
   using OperationQueue =
       unifex::intrusive_queue<OperationBase, &OperationBase::next_>;
-  using AtomicOperationQueue =
-      unifex::atomic_intrusive_queue<OperationBase, &OperationBase::next_>;
+  using RemoteOperationQueue =
+      ShardedMpscQueue<OperationBase, &OperationBase::next_>;
+  using DeadlineOperationQueue =
+      BucketQueue<OperationBase, &OperationBase::next_>;
 
   bool IsRunningOnThisThread() const noexcept;
   void RunImpl(const bool& should_stop);
@@ -90,44 +243,129 @@ class GrpcContext {
   void ScheduleLocal(OperationBase* op) noexcept;
   void ScheduleLocal(OperationQueue ops) noexcept;
   void ScheduleRemote(OperationBase* op) noexcept;
+  // Enqueues all of `ops` at once, waking the loop up at most once.
+  void ScheduleRemote(OperationQueue ops) noexcept;
 
   // Execute all ready-to-run items on the local queue.
   // Will not run other items that were enqueued during the execution of the
   // items that were already enqueued.
   // This bounds the amount of work to a finite amount.
-  void ExecutePendingLocal() noexcept;
+  //
+  // Returns the number of items run.
+  std::size_t ExecutePendingLocal() noexcept;
+  std::size_t ExecutePendingByDeadline() noexcept;
+
+  // Run the next ready item, if any. Returns false if there was none.
+  bool ExecuteOneLocal() noexcept;
+
+  bool HasPendingLocal() const noexcept;
 
   // Check if any completion queue items are available and if so add them
-  // to the local queue.
+  // to the local queue. Only blocks if the local queue is empty.
   //
   // Returns true if successful.
   //
   // Returns false if the completion queue is fully drained and shutdown.
   bool AcquireCompletionQueueItems() noexcept;
 
-  // Collect the contents of the remote queue and pass them to ScheduleLocal
+  // Acquire up to `max_events` completion queue events that are ready, without
+  // blocking. Returns the number of events acquired.
+  std::size_t PollCompletionQueue(std::size_t max_events) noexcept;
+
+  // Wait for the next completion queue event under
+  // `PollingPolicy::kAdaptiveBusyPoll`. Same result as `CompletionQueue::Next`.
+  bool BusyPollCompletionQueue(void** tag, bool* ok) noexcept;
+
+  // Adapt the spin budget to the time it took for an event to arrive.
+  void UpdateSpinBudget(std::chrono::nanoseconds idle_time) noexcept;
+
+  // Route a completion queue event to its operation, or note the remote queue
+  // wakeup.
+  void OnCompletionQueueEvent(void* tag, bool ok) noexcept;
+
+  // Collect the contents of the remote queue and pass them to ScheduleLocal.
+  // The remote queue is only marked inactive, which makes the next producer
+  // arm the wakeup alarm, when the loop is about to block. While local work is
+  // pending, remote items are picked up on the next iteration instead, so
+  // remote wakeups are coalesced into at most one alarm per blocking wait.
   //
-  // Returns true if successful.
+  // Returns true if the remote queue was marked inactive.
   //
   // Returns false if some other thread concurrently enqueued work to the remote
-  // queue.
+  // queue, or if the loop has local work pending.
   bool TryScheduleRemoteQueuedItems() noexcept;
 
   // Wakeup the processing thread to acquire remotely-queued items.
   //
-  // This should only be called after trying to enqueue() work
+  // This should only be called after trying to Enqueue() work
   // to the remote_queue_ and being told that the processing thread
   // is inactive.
   void SignalRemoteQueue();
 
-  grpc::Alarm work_alarm_;
-  detail::GrpcCompletionQueueEvent event_;
+  // Timer wheel, only used on the run loop thread. The wheel is driven by a
+  // single alarm which is armed for the wheel's next expiry.
+  void AddTimer(TimerOperation* op,
+                std::chrono::steady_clock::time_point deadline) noexcept;
+  void CancelTimer(TimerOperation* op) noexcept;
+  void ArmTimerAlarm() noexcept;
+  void OnTimerAlarm(bool ok) noexcept;
+  void ShutDownTimers() noexcept;
+
+  // Only called on the run loop thread, so a plain load and store suffices.
+  void OnWorkStarted() noexcept;
+  void OnWorkFinished() noexcept;
+
+  // Read-mostly state, shared by the run loop and producers.
   std::unique_ptr<grpc::CompletionQueue> completion_queue_;
+  GrpcContextOptions options_;
+  // Set by the first `ShutDown`.
+  std::atomic<bool> shut_down_{false};
 
-  bool remote_queue_read_submitted_{false};
+  // State owned by the run loop thread. It must not share cache lines with
+  // the remote queue, which foreign threads write to.
+  //
+  // The remote queue starts out inactive, i.e. the first producer signals.
+  alignas(hardware_destructive_interference_size) bool
+      remote_queue_read_submitted_{true};
 
   OperationQueue local_queue_;
-  AtomicOperationQueue remote_queue_{false};
+  // Replaces `local_queue_` under `SchedulingPolicy::kEarliestDeadlineFirst`.
+  DeadlineOperationQueue deadline_queue_;
+  bool executing_by_deadline_ = false;
+  bool current_work_expired_ = false;
+  bool completion_queue_drained_ = false;
+
+  // Instances of `ContextLocal`s for this context, indexed by their slot.
+  std::vector<void*> local_slots_;
+
+  std::atomic<std::size_t> outstanding_work_{0};
+
+  // Exponential moving average of the time the loop waited for an event, and
+  // the spin budget derived from it.
+  std::chrono::nanoseconds average_idle_time_{0};
+  std::chrono::nanoseconds spin_budget_{0};
+
+  SingleWriterCounter spin_hits_;
+  SingleWriterCounter spin_misses_;
+  SingleWriterCounter spin_time_ns_;
+  SingleWriterCounter expired_work_;
+  SingleWriterCounter starvation_events_;
+
+  TimerWheel timer_wheel_;
+  grpc::Alarm timer_alarm_;
+  TimerWheel::Tick timer_alarm_tick_ = 0;
+  bool timer_alarm_armed_ = false;
+  // A cancel is pending to re-arm the alarm for an earlier expiry.
+  bool timer_alarm_cancelled_ = false;
+  bool timers_shut_down_ = false;
+  TimerShutDownOperation timer_shut_down_op_;
+
+  // State written by foreign threads. The queue keeps each producer shard and
+  // its inactive flag on separate cache lines; the alarm is only touched by
+  // the producer that wakes the loop up.
+  alignas(hardware_destructive_interference_size)
+      RemoteOperationQueue remote_queue_{false};
+  grpc::Alarm work_alarm_;
 };
 
 inline grpc::CompletionQueue*
@@ -140,6 +378,105 @@ GrpcContext::get_server_completion_queue() noexcept {
   return static_cast<grpc::ServerCompletionQueue*>(completion_queue_.get());
 }
 
+inline std::size_t GrpcContext::get_outstanding_work() const noexcept {
+  return outstanding_work_.load(std::memory_order_relaxed);
+}
+
+inline GrpcContextStats GrpcContext::get_stats() const noexcept {
+  GrpcContextStats stats;
+  stats.spin_hits = spin_hits_.Read();
+  stats.spin_misses = spin_misses_.Read();
+  stats.spin_time = std::chrono::nanoseconds(spin_time_ns_.Read());
+  stats.expired_work = expired_work_.Read();
+  stats.starvation_events = starvation_events_.Read();
+  return stats;
+}
+
+inline bool GrpcContext::is_current_work_expired() const noexcept {
+  return current_work_expired_;
+}
+
+inline bool GrpcContext::is_shut_down() const noexcept {
+  return completion_queue_drained_;
+}
+
+inline bool GrpcContext::is_shutting_down() const noexcept {
+  return shut_down_.load(std::memory_order_acquire);
+}
+
+namespace detail {
+
+struct GrpcContextAccess {
+  using OperationBase = GrpcContext::OperationBase;
+  using OperationQueue = GrpcContext::OperationQueue;
+
+  // The context whose run loop is running on this thread, if any.
+  static GrpcContext* GetCurrent() noexcept;
+
+  static bool IsRunningOnThisThread(const GrpcContext& context) noexcept {
+    return context.IsRunningOnThisThread();
+  }
+
+  // Runs `op` on the context, from any thread.
+  static void Schedule(GrpcContext& context, OperationBase* op) {
+    context.ScheduleImpl(op);
+  }
+
+  // Same as `Schedule`, but only callable on the run loop thread.
+  static void ScheduleLocal(GrpcContext& context, OperationBase* op) noexcept {
+    context.ScheduleLocal(op);
+  }
+
+  static void ScheduleLocal(GrpcContext& context,
+                            OperationQueue ops) noexcept {
+    context.ScheduleLocal(std::move(ops));
+  }
+
+  // Runs `ops` on the context. Only callable off the run loop thread.
+  static void ScheduleRemote(GrpcContext& context,
+                             OperationQueue ops) noexcept {
+    context.ScheduleRemote(std::move(ops));
+  }
+
+  // The `ContextLocal` slot `index` of the context, null until set. Only
+  // callable on the run loop thread.
+  static void*& GetLocalSlot(GrpcContext& context, std::size_t index) {
+    auto& slots = context.local_slots_;
+    if (index >= slots.size()) {
+      slots.resize(index + 1, nullptr);
+    }
+    return slots[index];
+  }
+};
+
+// Told about every `GrpcContext` that is destroyed, so that state kept per
+// context, such as `ContextLocal` instances, can be released with it.
+// `OnContextDestroyed` runs on the thread destroying the context, before any
+// of its members are destroyed, and must not add or remove observers.
+class GrpcContextObserver {
+ public:
+  virtual void OnContextDestroyed(GrpcContext& context) noexcept = 0;
+
+ protected:
+  ~GrpcContextObserver() = default;
+};
+
+// Thread-safe. An observer must be removed before it is destroyed.
+void AddGrpcContextObserver(GrpcContextObserver* observer);
+void RemoveGrpcContextObserver(GrpcContextObserver* observer) noexcept;
+
+}  // namespace detail
+
+inline void GrpcContext::OnWorkStarted() noexcept {
+  outstanding_work_.store(outstanding_work_.load(std::memory_order_relaxed) + 1,
+                          std::memory_order_relaxed);
+}
+
+inline void GrpcContext::OnWorkFinished() noexcept {
+  outstanding_work_.store(outstanding_work_.load(std::memory_order_relaxed) - 1,
+                          std::memory_order_relaxed);
+}
+
 template <typename StopToken>
 void GrpcContext::Run(StopToken stop_token) {
   StopOperation stop_op;
@@ -149,10 +486,6 @@ void GrpcContext::Run(StopToken stop_token) {
   RunImpl(stop_op.should_stop_);
 }
 
-inline void GrpcContext::ShutDown() {
-  completion_queue_->Shutdown();
-}
-
 template <typename AsyncRPC>
 class GrpcContext::AsyncRPCSender {
 
@@ -165,7 +498,11 @@ class GrpcContext::AsyncRPCSender {
     explicit Operation(const AsyncRPCSender& sender, Receiver2&& r)
         : context_(sender.context_),
           rpc_(sender.rpc_),
-          receiver_((Receiver2 &&) r) {}
+          client_context_(sender.client_context_),
+          status_(sender.status_),
+          receiver_((Receiver2 &&) r) {
+      this->deadline_ = sender.deadline_;
+    }
 
     void start() noexcept {
       if (!context_.IsRunningOnThisThread()) {
@@ -178,6 +515,25 @@ class GrpcContext::AsyncRPCSender {
     }
 
    private:
+    static constexpr bool kStoppable = !unifex::is_stop_never_possible_v<
+        unifex::stop_token_type_t<Receiver>>;
+    static constexpr bool kCountsAsWork =
+        detail::CountsAsOutstandingWork<AsyncRPC>();
+
+    // `TryCancel` is thread-safe, so the stop request is not brought over to
+    // the run loop thread. The call then completes with `ok == false`, unless
+    // it had already succeeded.
+    struct CancelCallback {
+      Operation& op;
+      void operator()() noexcept {
+        op.cancelled_.store(true, std::memory_order_relaxed);
+        op.client_context_->TryCancel();
+      }
+    };
+
+    using StopCallback = typename unifex::stop_token_type_t<
+        Receiver>::template callback_type<CancelCallback>;
+
     static void OnScheduleComplete(OperationBase* op) noexcept {
       static_cast<Operation*>(op)->StartAsyncRPC();
     }
@@ -186,12 +542,36 @@ class GrpcContext::AsyncRPCSender {
       AGRPC_CHECK(context_.IsRunningOnThisThread());
       static_cast<OperationBase*>(this)->execute_ =
           &Operation::OnRequestComplete;
+      if constexpr (kCountsAsWork) {
+        context_.OnWorkStarted();
+      }
       rpc_(context_, this);
+      if constexpr (kStoppable) {
+        if (client_context_) {
+          stop_callback_.construct(unifex::get_stop_token(receiver_),
+                                   CancelCallback{*this});
+        }
+      }
     }
 
     static void OnRequestComplete(OperationBase* op) noexcept {
       auto& self = *static_cast<Operation*>(op);
-      auto result = self.context_.event_.ok;
+      if constexpr (kCountsAsWork) {
+        self.context_.OnWorkFinished();
+      }
+      if constexpr (kStoppable) {
+        if (self.client_context_) {
+          self.stop_callback_.destruct();
+          // A stop request that came too late to cancel the call must not
+          // turn its success into done.
+          if (self.cancelled_.load(std::memory_order_relaxed) &&
+              !self.Succeeded()) {
+            unifex::set_done(std::move(self.receiver_));
+            return;
+          }
+        }
+      }
+      auto result = self.ok_;
       if constexpr (noexcept(
                         unifex::set_value(std::move(self.receiver_), result))) {
         unifex::set_value(std::move(self.receiver_), result);
@@ -204,8 +584,16 @@ class GrpcContext::AsyncRPCSender {
       }
     }
 
+    bool Succeeded() const noexcept {
+      return this->ok_ && (status_ == nullptr || status_->ok());
+    }
+
     GrpcContext& context_;
     AsyncRPC rpc_;
+    grpc::ClientContext* client_context_;
+    const grpc::Status* status_;
+    std::atomic<bool> cancelled_{false};
+    unifex::manual_lifetime<StopCallback> stop_callback_;
     Receiver receiver_;
   };
 
@@ -222,17 +610,285 @@ class GrpcContext::AsyncRPCSender {
 
   static constexpr bool sends_done = true;
 
-  explicit AsyncRPCSender(GrpcContext& context, AsyncRPC rpc) noexcept
-      : context_(context), rpc_(rpc) {}
+  // With a `client_context`, a stop request cancels the call and the sender
+  // completes with done, or with the call's result if it succeeded anyway.
+  // Operations that finish a call, whose completion is `ok` even when the call
+  // was cancelled, pass the `status` they receive so success can be told.
+  explicit AsyncRPCSender(
+      Scheduler scheduler, AsyncRPC rpc,
+      grpc::ClientContext* client_context = nullptr,
+      const grpc::Status* status = nullptr) noexcept;
 
   template <typename Receiver>
   Operation<unifex::remove_cvref_t<Receiver>> connect(Receiver&& r) && {
     return Operation<unifex::remove_cvref_t<Receiver>>{*this, (Receiver &&) r};
   }
 
+  // The scheduler of the context the call runs on.
+  Scheduler get_scheduler() const noexcept;
+
  private:
   GrpcContext& context_;
+  std::chrono::steady_clock::time_point deadline_;
   AsyncRPC rpc_;
+  grpc::ClientContext* client_context_;
+  const grpc::Status* status_;
+};
+
+class GrpcContext::ScheduleSender {
+  template <typename Receiver>
+  class Operation : private OperationBase {
+    friend GrpcContext;
+
+   public:
+    template <typename Receiver2>
+    explicit Operation(GrpcContext& context,
+                       std::chrono::steady_clock::time_point deadline,
+                       Receiver2&& r)
+        : context_(context), receiver_((Receiver2 &&) r) {
+      static_cast<OperationBase*>(this)->execute_ = &Operation::Execute;
+      static_cast<OperationBase*>(this)->deadline_ = deadline;
+    }
+
+    void start() noexcept {
+      context_.ScheduleImpl(static_cast<OperationBase*>(this));
+    }
+
+   private:
+    static void Execute(OperationBase* op) noexcept {
+      auto& self = *static_cast<Operation*>(op);
+      if constexpr (!unifex::is_stop_never_possible_v<
+                        unifex::stop_token_type_t<Receiver>>) {
+        if (unifex::get_stop_token(self.receiver_).stop_requested()) {
+          unifex::set_done(std::move(self.receiver_));
+          return;
+        }
+      }
+      if constexpr (noexcept(unifex::set_value(std::move(self.receiver_)))) {
+        unifex::set_value(std::move(self.receiver_));
+      } else {
+        UNIFEX_TRY { unifex::set_value(std::move(self.receiver_)); }
+        UNIFEX_CATCH(...) {
+          unifex::set_error(std::move(self.receiver_),
+                            std::current_exception());
+        }
+      }
+    }
+
+    GrpcContext& context_;
+    Receiver receiver_;
+  };
+
+ public:
+  template <template <typename...> class Variant,
+            template <typename...> class Tuple>
+  using value_types = Variant<Tuple<>>;
+
+  template <template <typename...> class Variant>
+  using error_types = Variant<std::exception_ptr>;
+
+  static constexpr bool sends_done = true;
+
+  explicit ScheduleSender(
+      GrpcContext& context,
+      std::chrono::steady_clock::time_point deadline) noexcept
+      : context_(context), deadline_(deadline) {}
+
+  template <typename Receiver>
+  Operation<unifex::remove_cvref_t<Receiver>> connect(Receiver&& r) const& {
+    return Operation<unifex::remove_cvref_t<Receiver>>{context_, deadline_,
+                                                       (Receiver &&) r};
+  }
+
+ private:
+  GrpcContext& context_;
+  std::chrono::steady_clock::time_point deadline_;
+};
+
+template <typename Receiver>
+class GrpcContext::TimerSenderOperation : private TimerOperation {
+  friend GrpcContext;
+
+ public:
+  template <typename Receiver2>
+  explicit TimerSenderOperation(GrpcContext& context,
+                                std::chrono::steady_clock::time_point deadline,
+                                Receiver2&& r)
+      : context_(context), expiry_(deadline), receiver_((Receiver2 &&) r) {}
+
+  template <typename Receiver2>
+  explicit TimerSenderOperation(GrpcContext& context,
+                                std::chrono::nanoseconds duration,
+                                Receiver2&& r)
+      : context_(context),
+        duration_(duration),
+        relative_(true),
+        receiver_((Receiver2 &&) r) {}
+
+  void start() noexcept {
+    if (relative_) {
+      // Not the coarse clock: it lags by up to its update interval, and the
+      // alarm measures the expiry from the precise one, so the timer would
+      // fire early.
+      expiry_ = std::chrono::steady_clock::now() + duration_;
+    }
+    if (!context_.IsRunningOnThisThread()) {
+      static_cast<OperationBase*>(this)->execute_ =
+          &TimerSenderOperation::OnScheduleComplete;
+      context_.ScheduleRemote(static_cast<OperationBase*>(this));
+    } else {
+      StartTimer();
+    }
+  }
+
+ private:
+  static constexpr bool kStoppable =
+      !unifex::is_stop_never_possible_v<unifex::stop_token_type_t<Receiver>>;
+
+  // Brings a stop request over to the run loop thread, which owns the wheel.
+  struct CancelOperation : OperationBase {
+    TimerSenderOperation* self;
+  };
+
+  struct CancelCallback {
+    TimerSenderOperation& op;
+    void operator()() noexcept {
+      op.stop_requested_.store(true, std::memory_order_release);
+      op.context_.ScheduleImpl(&op.cancel_op_);
+    }
+  };
+
+  using StopCallback = typename unifex::stop_token_type_t<
+      Receiver>::template callback_type<CancelCallback>;
+
+  static void OnScheduleComplete(OperationBase* op) noexcept {
+    static_cast<TimerSenderOperation*>(op)->StartTimer();
+  }
+
+  void StartTimer() noexcept {
+    static_cast<OperationBase*>(this)->execute_ =
+        &TimerSenderOperation::OnExpired;
+    context_.OnWorkStarted();
+    context_.AddTimer(this, expiry_);
+    if constexpr (kStoppable) {
+      cancel_op_.execute_ = &TimerSenderOperation::OnCancel;
+      cancel_op_.self = this;
+      // A stop request that is already pending cancels the timer right away.
+      stop_callback_.construct(unifex::get_stop_token(receiver_),
+                               CancelCallback{*this});
+    }
+  }
+
+  // The timer expired, or was dropped by `GrpcContext::ShutDown` with `ok_`
+  // cleared.
+  static void OnExpired(OperationBase* op) noexcept {
+    auto& self = *static_cast<TimerSenderOperation*>(op);
+    if constexpr (kStoppable) {
+      self.stop_callback_.destruct();
+      self.expired_ = true;
+      if (self.stop_requested_.load(std::memory_order_acquire) &&
+          !self.cancel_ran_) {
+        // The cancel operation is still queued, it completes us.
+        return;
+      }
+    }
+    self.Complete();
+  }
+
+  static void OnCancel(OperationBase* op) noexcept {
+    auto& self = *static_cast<CancelOperation*>(op)->self;
+    self.cancel_ran_ = true;
+    if (self.is_linked()) {
+      self.context_.CancelTimer(&self);
+      self.stop_callback_.destruct();
+      self.Complete();
+    } else if (self.expired_) {
+      self.Complete();
+    }
+    // Otherwise `OnExpired` is queued and completes us.
+  }
+
+  void Complete() noexcept {
+    context_.OnWorkFinished();
+    if (!this->ok_ || stop_requested_.load(std::memory_order_relaxed)) {
+      unifex::set_done(std::move(receiver_));
+      return;
+    }
+    if constexpr (noexcept(unifex::set_value(std::move(receiver_)))) {
+      unifex::set_value(std::move(receiver_));
+    } else {
+      UNIFEX_TRY { unifex::set_value(std::move(receiver_)); }
+      UNIFEX_CATCH(...) {
+        unifex::set_error(std::move(receiver_), std::current_exception());
+      }
+    }
+  }
+
+  GrpcContext& context_;
+  std::chrono::steady_clock::time_point expiry_;
+  std::chrono::nanoseconds duration_{0};
+  bool relative_ = false;
+  bool expired_ = false;
+  bool cancel_ran_ = false;
+  std::atomic<bool> stop_requested_{false};
+  CancelOperation cancel_op_;
+  unifex::manual_lifetime<StopCallback> stop_callback_;
+  Receiver receiver_;
+};
+
+class GrpcContext::ScheduleAtSender {
+ public:
+  template <template <typename...> class Variant,
+            template <typename...> class Tuple>
+  using value_types = Variant<Tuple<>>;
+
+  template <template <typename...> class Variant>
+  using error_types = Variant<std::exception_ptr>;
+
+  static constexpr bool sends_done = true;
+
+  explicit ScheduleAtSender(
+      GrpcContext& context,
+      std::chrono::steady_clock::time_point deadline) noexcept
+      : context_(context), deadline_(deadline) {}
+
+  template <typename Receiver>
+  TimerSenderOperation<unifex::remove_cvref_t<Receiver>> connect(
+      Receiver&& r) const& {
+    return TimerSenderOperation<unifex::remove_cvref_t<Receiver>>{
+        context_, deadline_, (Receiver &&) r};
+  }
+
+ private:
+  GrpcContext& context_;
+  std::chrono::steady_clock::time_point deadline_;
+};
+
+class GrpcContext::ScheduleAfterSender {
+ public:
+  template <template <typename...> class Variant,
+            template <typename...> class Tuple>
+  using value_types = Variant<Tuple<>>;
+
+  template <template <typename...> class Variant>
+  using error_types = Variant<std::exception_ptr>;
+
+  static constexpr bool sends_done = true;
+
+  explicit ScheduleAfterSender(GrpcContext& context,
+                               std::chrono::nanoseconds duration) noexcept
+      : context_(context), duration_(duration) {}
+
+  template <typename Receiver>
+  TimerSenderOperation<unifex::remove_cvref_t<Receiver>> connect(
+      Receiver&& r) const& {
+    return TimerSenderOperation<unifex::remove_cvref_t<Receiver>>{
+        context_, duration_, (Receiver &&) r};
+  }
+
+ private:
+  GrpcContext& context_;
+  std::chrono::nanoseconds duration_;
 };
 
 class GrpcContext::Scheduler {
@@ -241,11 +897,72 @@ class GrpcContext::Scheduler {
   Scheduler& operator=(const Scheduler&) = default;
   ~Scheduler() = default;
 
+  // A scheduler for the same context whose operations carry `deadline`, which
+  // orders them under `SchedulingPolicy::kEarliestDeadlineFirst`.
+  Scheduler WithDeadline(
+      std::chrono::steady_clock::time_point deadline) const noexcept {
+    Scheduler result = *this;
+    result.deadline_ = deadline;
+    return result;
+  }
+
+  // Same as above for system clock deadlines, such as those of
+  // `grpc::ServerContext::deadline()` and `grpc::ClientContext::deadline()`.
+  Scheduler WithDeadline(
+      std::chrono::system_clock::time_point deadline) const noexcept {
+    if (deadline == std::chrono::system_clock::time_point::max()) {
+      return WithDeadline(std::chrono::steady_clock::time_point::max());
+    }
+    return WithDeadline(ReadCoarseSteadyClock() +
+                        (deadline - ReadCoarseSystemClock()));
+  }
+
+  std::chrono::steady_clock::time_point deadline() const noexcept {
+    return deadline_;
+  }
+
  private:
   friend GrpcContext;
 
   explicit Scheduler(GrpcContext& context) noexcept : context_(&context) {}
 
+  friend bool operator==(const Scheduler& a, const Scheduler& b) noexcept {
+    return a.context_ == b.context_;
+  }
+
+  // Completes on the context. When called on the context's thread, the
+  // continuation is enqueued behind the work that is already pending.
+  friend ScheduleSender tag_invoke(tag_t<unifex::schedule>,
+                                   const Scheduler& s) noexcept {
+    return ScheduleSender{*s.context_, s.deadline_};
+  }
+
+  friend std::chrono::steady_clock::time_point tag_invoke(
+      tag_t<unifex::now>, const Scheduler&) noexcept {
+    return std::chrono::steady_clock::now();
+  }
+
+  // Completes on the context once `deadline` has passed, with a resolution of
+  // about a millisecond. Completes with done if stop is requested first, or if
+  // the context is shut down.
+  template <typename Duration>
+  friend ScheduleAtSender tag_invoke(
+      tag_t<unifex::schedule_at>, const Scheduler& s,
+      std::chrono::time_point<std::chrono::steady_clock, Duration>
+          deadline) noexcept {
+    return ScheduleAtSender{*s.context_, deadline};
+  }
+
+  // Same as `schedule_at` with a deadline `duration` from now.
+  template <typename Rep, typename Ratio>
+  friend ScheduleAfterSender tag_invoke(
+      tag_t<unifex::schedule_after>, const Scheduler& s,
+      std::chrono::duration<Rep, Ratio> duration) noexcept {
+    return ScheduleAfterSender{
+        *s.context_,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(duration)};
+  }
+
   // Server AsyncRequest
   template <typename RPC, typename Service, typename Request,
             typename Responder>
@@ -320,6 +1037,12 @@ class GrpcContext::Scheduler {
       grpc::ClientAsyncResponseReader<Response>& reader,
       Response& response, grpc::Status& status);
 
+  template <typename Response>
+  friend auto tag_invoke(
+      tag_t<AsyncFinish>, Scheduler s, grpc::ClientContext& client_context,
+      grpc::ClientAsyncResponseReader<Response>& reader,
+      Response& response, grpc::Status& status);
+
   // Server AsyncWriteAndFinish
   template <typename Response>
   friend auto tag_invoke(
@@ -345,7 +1068,7 @@ class GrpcContext::Scheduler {
   template <typename Response>
   friend auto tag_invoke(
       tag_t<AsyncFinishWithError>, Scheduler s,
-      grpc::ServerAsyncResponseWriter<Response> writer,
+      grpc::ServerAsyncResponseWriter<Response>& writer,
       const grpc::Status& status);
 
   // Server AsyncSendInitialMetadata
@@ -354,13 +1077,47 @@ class GrpcContext::Scheduler {
       tag_t<AsyncSendInitialMetadata>, Scheduler s,
       Responder& responder);
 
+  // Server AsyncNotifyWhenDone
+  friend auto tag_invoke(
+      tag_t<AsyncNotifyWhenDone>, Scheduler s,
+      grpc::ServerContext& server_context);
+
   GrpcContext* context_;
+  std::chrono::steady_clock::time_point deadline_ =
+      std::chrono::steady_clock::time_point::max();
 };
 
 inline GrpcContext::Scheduler GrpcContext::get_scheduler() noexcept {
   return Scheduler{*this};
 }
 
+// Gives the run loop back to other work, for handlers that run for long:
+//
+//   co_await agrpc::yield(scheduler);
+//
+// Completes on the context after the operations that are already ready, and
+// after the loop has polled the completion and remote queues.
+inline GrpcContext::ScheduleSender yield(
+    GrpcContext::Scheduler scheduler) noexcept {
+  return unifex::schedule(scheduler);
+}
+
+template <typename AsyncRPC>
+GrpcContext::AsyncRPCSender<AsyncRPC>::AsyncRPCSender(
+    Scheduler scheduler, AsyncRPC rpc,
+    grpc::ClientContext* client_context, const grpc::Status* status) noexcept
+    : context_(*scheduler.context_),
+      deadline_(scheduler.deadline_),
+      rpc_(rpc),
+      client_context_(client_context),
+      status_(status) {}
+
+template <typename AsyncRPC>
+GrpcContext::Scheduler GrpcContext::AsyncRPCSender<AsyncRPC>::get_scheduler()
+    const noexcept {
+  return context_.get_scheduler().WithDeadline(deadline_);
+}
+
 // Server AsyncRequest
 template <typename RPC, typename Service, typename Request, typename Responder>
 auto tag_invoke(
@@ -369,7 +1126,7 @@ auto tag_invoke(
     Service& service, grpc::ServerContext& server_context, Request& request,
     Responder& responder) {
   return GrpcContext::AsyncRPCSender(
-      *s.context_, [&, rpc](GrpcContext& context, void* tag) {
+      s, [&, rpc](GrpcContext& context, void* tag) {
         auto* cq = context.get_server_completion_queue();
         (service.*rpc)(&server_context, &request, &responder, cq, cq, tag);
       });
@@ -382,7 +1139,7 @@ auto tag_invoke(
     Service& service, grpc::ServerContext& server_context,
     Responder& responder) {
   return GrpcContext::AsyncRPCSender(
-      *s.context_, [&, rpc](GrpcContext& context, void* tag) {
+      s, [&, rpc](GrpcContext& context, void* tag) {
         auto* cq = context.get_server_completion_queue();
         (service.*rpc)(&server_context, &responder, cq, cq, tag);
       });
@@ -395,7 +1152,7 @@ auto tag_invoke(
     grpc::ServerAsyncReader<Response, Request>& reader,
     Request& request) {
   return GrpcContext::AsyncRPCSender(
-      *s.context_, [&](GrpcContext&, void* tag) {
+      s, [&](GrpcContext&, void* tag) {
         reader.Read(&request, tag);
       });
 }
@@ -406,7 +1163,7 @@ auto tag_invoke(
     grpc::ServerAsyncReaderWriter<Response, Request>& reader_writer,
     Request& request) {
   return GrpcContext::AsyncRPCSender(
-      *s.context_, [&](GrpcContext&, void* tag) {
+      s, [&](GrpcContext&, void* tag) {
         reader_writer.Read(&request, tag);
       });
 }
@@ -418,7 +1175,7 @@ auto tag_invoke(
     grpc::ServerAsyncWriter<Response>& writer,
     const Response& response) {
   return GrpcContext::AsyncRPCSender(
-      *s.context_, [&](GrpcContext&, void* tag) {
+      s, [&](GrpcContext&, void* tag) {
         writer.Write(response, tag);
       });
 }
@@ -429,7 +1186,7 @@ auto tag_invoke(
     grpc::ServerAsyncReaderWriter<Response, Request>& reader_writer,
     const Response& response) {
   return GrpcContext::AsyncRPCSender(
-      *s.context_, [&](GrpcContext&, void* tag) {
+      s, [&](GrpcContext&, void* tag) {
         reader_writer.Write(response, tag);
       });
 }
@@ -441,7 +1198,7 @@ auto tag_invoke(
     grpc::ServerAsyncResponseWriter<Response>& writer,
     const Response& response, const grpc::Status& status) {
   return GrpcContext::AsyncRPCSender(
-      *s.context_, [&](GrpcContext&, void* tag) {
+      s, [&](GrpcContext&, void* tag) {
         writer.Finish(response, status, tag);
       });
 }
@@ -452,7 +1209,7 @@ auto tag_invoke(
     grpc::ServerAsyncWriter<Response>& writer,
     const grpc::Status& status) {
   return GrpcContext::AsyncRPCSender(
-      *s.context_, [&](GrpcContext&, void* tag) {
+      s, [&](GrpcContext&, void* tag) {
         writer.Finish(status, tag);
       });
 }
@@ -463,7 +1220,7 @@ auto tag_invoke(
     grpc::ServerAsyncReader<Response, Request>& reader,
     const Response& response, const grpc::Status& status) {
   return GrpcContext::AsyncRPCSender(
-      *s.context_, [&](GrpcContext&, void* tag) {
+      s, [&](GrpcContext&, void* tag) {
         reader.Finish(response, status, tag);
       });
 }
@@ -474,7 +1231,7 @@ auto tag_invoke(
     grpc::ServerAsyncReaderWriter<Response, Request>& reader_writer,
     const grpc::Status& status) {
   return GrpcContext::AsyncRPCSender(
-      *s.context_, [&](GrpcContext&, void* tag) {
+      s, [&](GrpcContext&, void* tag) {
         reader_writer.Finish(status, tag);
       });
 }
@@ -486,11 +1243,25 @@ auto tag_invoke(
     grpc::ClientAsyncResponseReader<Response>& reader,
     Response& response, grpc::Status& status) {
   return GrpcContext::AsyncRPCSender(
-      *s.context_, [&](GrpcContext&, void* tag) {
+      s, [&](GrpcContext&, void* tag) {
         reader.Finish(&response, &status, tag);
       });
 }
 
+template <typename Response>
+auto tag_invoke(
+    tag_t<AsyncFinish>, GrpcContext::Scheduler s,
+    grpc::ClientContext& client_context,
+    grpc::ClientAsyncResponseReader<Response>& reader,
+    Response& response, grpc::Status& status) {
+  return GrpcContext::AsyncRPCSender(
+      s,
+      [&](GrpcContext&, void* tag) {
+        reader.Finish(&response, &status, tag);
+      },
+      &client_context, &status);
+}
+
 // Server AsyncWriteAndFinish
 template <typename Response>
 auto tag_invoke(
@@ -499,7 +1270,7 @@ auto tag_invoke(
     const Response& response, grpc::WriteOptions options,
     const grpc::Status& status) {
   return GrpcContext::AsyncRPCSender(
-      *s.context_, [&](GrpcContext&, void* tag) {
+      s, [&](GrpcContext&, void* tag) {
         writer.WriteAndFinish(response, options, status, tag);
       });
 }
@@ -511,7 +1282,7 @@ auto tag_invoke(
     const Response& response, grpc::WriteOptions options,
     const grpc::Status& status) {
   return GrpcContext::AsyncRPCSender(
-      *s.context_, [&](GrpcContext&, void* tag) {
+      s, [&](GrpcContext&, void* tag) {
         reader_writer.WriteAndFinish(response, options, status, tag);
       });
 }
@@ -523,7 +1294,7 @@ auto tag_invoke(
     grpc::ServerAsyncReader<Response, Request>& reader,
     const grpc::Status& status) {
   return GrpcContext::AsyncRPCSender(
-      *s.context_, [&](GrpcContext&, void* tag) {
+      s, [&](GrpcContext&, void* tag) {
         reader.FinishWithError(status, tag);
       });
 }
@@ -531,10 +1302,10 @@ auto tag_invoke(
 template <typename Response>
 auto tag_invoke(
     tag_t<AsyncFinishWithError>, GrpcContext::Scheduler s,
-    grpc::ServerAsyncResponseWriter<Response> writer,
+    grpc::ServerAsyncResponseWriter<Response>& writer,
     const grpc::Status& status) {
   return GrpcContext::AsyncRPCSender(
-      *s.context_, [&](GrpcContext&, void* tag) {
+      s, [&](GrpcContext&, void* tag) {
         writer.FinishWithError(status, tag);
       });
 }
@@ -545,11 +1316,35 @@ auto tag_invoke(
     tag_t<AsyncSendInitialMetadata>, GrpcContext::Scheduler s,
     Responder& responder) {
   return GrpcContext::AsyncRPCSender(
-      *s.context_, [&](GrpcContext&, void* tag) {
+      s, [&](GrpcContext&, void* tag) {
         responder.SendInitialMetadata(tag);
       });
 }
 
+namespace detail {
+
+// gRPC only delivers the notification if the call gets accepted, so it must
+// not keep the context's outstanding work up when the request fails.
+struct NotifyWhenDoneRPC {
+  static constexpr bool kCountsAsWork = false;
+
+  void operator()(GrpcContext&, void* tag) const {
+    server_context->AsyncNotifyWhenDone(tag);
+  }
+
+  grpc::ServerContext* server_context;
+};
+
+}  // namespace detail
+
+// Server AsyncNotifyWhenDone
+inline auto tag_invoke(
+    tag_t<AsyncNotifyWhenDone>, GrpcContext::Scheduler s,
+    grpc::ServerContext& server_context) {
+  return GrpcContext::AsyncRPCSender(
+      s, detail::NotifyWhenDoneRPC{&server_context});
+}
+
 }  // namespace agrpc
 
 #endif  // AGRPC_CONTEXT_GRPC_CONTEXT_H_
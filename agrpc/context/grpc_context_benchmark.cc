@@ -0,0 +1,70 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/grpc_context.h"
+
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/when_all.hpp>
+
+#include "benchmark/benchmark.h"
+
+#include "agrpc/context/grpc_context_pool.h"
+
+// Latency of hopping from a foreign thread onto a running `GrpcContext` and
+// back: each iteration enqueues to the remote queue, wakes the run loop and
+// waits for the continuation to be signalled from the loop thread.
+
+namespace agrpc {
+
+namespace {
+
+// Intentionally leaked, the run thread lives until the process exits.
+GrpcContextPool& GetRunningContext() {
+  static auto* pool = [] {
+    auto* pool = new GrpcContextPool{1};
+    pool->Start();
+    return pool;
+  }();
+  return *pool;
+}
+
+}  // namespace
+
+void Benchmark_ScheduleRemote(benchmark::State& state) {
+  auto scheduler = GetRunningContext().get_next_scheduler();
+  while (state.KeepRunning()) {
+    unifex::sync_wait(unifex::schedule(scheduler));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(Benchmark_ScheduleRemote)->ThreadRange(1, 16)->UseRealTime();
+
+// A burst of hops enqueued at once is picked up with a single wakeup.
+void Benchmark_ScheduleRemoteBurst(benchmark::State& state) {
+  auto scheduler = GetRunningContext().get_next_scheduler();
+  while (state.KeepRunning()) {
+    unifex::sync_wait(unifex::when_all(
+        unifex::schedule(scheduler), unifex::schedule(scheduler),
+        unifex::schedule(scheduler), unifex::schedule(scheduler),
+        unifex::schedule(scheduler), unifex::schedule(scheduler),
+        unifex::schedule(scheduler), unifex::schedule(scheduler)));
+  }
+  state.SetItemsProcessed(state.iterations() * 8);
+}
+
+BENCHMARK(Benchmark_ScheduleRemoteBurst)->ThreadRange(1, 16)->UseRealTime();
+
+}  // namespace agrpc
@@ -0,0 +1,93 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/grpc_context_pool.h"
+
+#include <utility>
+
+#include "agrpc/base/logging.h"
+
+namespace agrpc {
+
+GrpcContextPool::GrpcContextPool(grpc::ServerBuilder& builder,
+                                 std::size_t size,
+                                 GrpcContextOptions options) {
+  AGRPC_CHECK_GT(size, 0);
+  contexts_.reserve(size);
+  for (std::size_t i = 0; i < size; ++i) {
+    contexts_.push_back(
+        std::make_unique<GrpcContext>(builder.AddCompletionQueue(), options));
+  }
+}
+
+GrpcContextPool::GrpcContextPool(std::size_t size,
+                                 GrpcContextOptions options) {
+  AGRPC_CHECK_GT(size, 0);
+  contexts_.reserve(size);
+  for (std::size_t i = 0; i < size; ++i) {
+    contexts_.push_back(std::make_unique<GrpcContext>(
+        std::make_unique<grpc::CompletionQueue>(), options));
+  }
+}
+
+GrpcContextPool::~GrpcContextPool() {
+  if (!threads_.empty()) {
+    ShutDown();
+    Join();
+  }
+}
+
+void GrpcContextPool::Start() {
+  AGRPC_CHECK(threads_.empty(), "The pool has already been started.");
+  threads_.reserve(contexts_.size());
+  for (auto& context : contexts_) {
+    threads_.emplace_back([this, context = context.get()] {
+      context->Run(stop_source_.get_token());
+    });
+  }
+}
+
+void GrpcContextPool::ShutDown() {
+  for (auto& context : contexts_) {
+    context->ShutDown();
+  }
+}
+
+void GrpcContextPool::Stop() noexcept { stop_source_.request_stop(); }
+
+void GrpcContextPool::Join() {
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+}
+
+GrpcContext::Scheduler GrpcContextPool::get_least_loaded_scheduler() noexcept {
+  // Start from a rotating index so that ties do not always favour the first
+  // context.
+  auto start = next_index_.fetch_add(1, std::memory_order_relaxed);
+  auto* best = contexts_[start % contexts_.size()].get();
+  auto best_load = best->get_outstanding_work();
+  for (std::size_t i = 1; i < contexts_.size() && best_load != 0; ++i) {
+    auto* candidate = contexts_[(start + i) % contexts_.size()].get();
+    auto load = candidate->get_outstanding_work();
+    if (load < best_load) {
+      best = candidate;
+      best_load = load;
+    }
+  }
+  return best->get_scheduler();
+}
+
+}  // namespace agrpc
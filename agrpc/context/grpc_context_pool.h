@@ -0,0 +1,104 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_CONTEXT_GRPC_CONTEXT_POOL_H_
+#define AGRPC_CONTEXT_GRPC_CONTEXT_POOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <grpcpp/server_builder.h>
+
+#include <unifex/inplace_stop_token.hpp>
+
+#include "agrpc/context/grpc_context.h"
+
+namespace agrpc {
+
+// A fixed set of `GrpcContext`s, each driven by its own thread.
+//
+// With a server, the pool adds one completion queue per context to the
+// builder, so that a single `grpc::Server` spreads its calls over all of them:
+//
+//   grpc::ServerBuilder builder;
+//   ...
+//   agrpc::GrpcContextPool pool{builder, std::thread::hardware_concurrency()};
+//   auto server = builder.BuildAndStart();
+//   pool.Start();
+//   ...
+//   server->Shutdown();
+//   pool.ShutDown();
+//   pool.Join();
+class GrpcContextPool {
+ public:
+  // Creates `size` contexts on server completion queues obtained from
+  // `builder`. Must be called before `builder.BuildAndStart()`.
+  GrpcContextPool(grpc::ServerBuilder& builder, std::size_t size,
+                  GrpcContextOptions options = {});
+
+  // Creates `size` contexts on plain completion queues, for client-only use.
+  explicit GrpcContextPool(std::size_t size, GrpcContextOptions options = {});
+
+  GrpcContextPool(const GrpcContextPool&) = delete;
+  GrpcContextPool& operator=(const GrpcContextPool&) = delete;
+
+  // Shuts down and joins the run threads if that has not been done yet.
+  ~GrpcContextPool();
+
+  // Spawns one thread per context running `GrpcContext::Run`.
+  void Start();
+
+  // Shuts down every completion queue. The run threads exit once their queue
+  // is drained. For servers, call this after `grpc::Server::Shutdown()`.
+  void ShutDown();
+
+  // Makes the run threads leave their loops without draining the queues.
+  void Stop() noexcept;
+
+  // Waits for all run threads to exit.
+  void Join();
+
+  std::size_t size() const noexcept { return contexts_.size(); }
+
+  GrpcContext& get_context(std::size_t index) noexcept;
+
+  // Hands out schedulers of the contexts in turn.
+  GrpcContext::Scheduler get_next_scheduler() noexcept;
+
+  // Hands out the scheduler of the context with the least outstanding work.
+  // Loads are sampled without synchronization, so the choice is approximate.
+  GrpcContext::Scheduler get_least_loaded_scheduler() noexcept;
+
+ private:
+  std::vector<std::unique_ptr<GrpcContext>> contexts_;
+  std::vector<std::thread> threads_;
+  unifex::inplace_stop_source stop_source_;
+  std::atomic<std::size_t> next_index_{0};
+};
+
+inline GrpcContext& GrpcContextPool::get_context(std::size_t index) noexcept {
+  return *contexts_[index];
+}
+
+inline GrpcContext::Scheduler GrpcContextPool::get_next_scheduler() noexcept {
+  auto index = next_index_.fetch_add(1, std::memory_order_relaxed);
+  return contexts_[index % contexts_.size()]->get_scheduler();
+}
+
+}  // namespace agrpc
+
+#endif  // AGRPC_CONTEXT_GRPC_CONTEXT_POOL_H_
@@ -0,0 +1,112 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/grpc_context_pool.h"
+
+#include <memory>
+#include <set>
+#include <thread>
+
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/then.hpp>
+
+#include "gtest/gtest.h"
+
+namespace agrpc {
+namespace {
+
+// The id of the thread `scheduler` runs its work on.
+std::thread::id GetRunThread(GrpcContext::Scheduler scheduler) {
+  return *unifex::sync_wait(unifex::then(
+      unifex::schedule(scheduler), [] { return std::this_thread::get_id(); }));
+}
+
+TEST(GrpcContextPool, RunsEachContextOnItsOwnThread) {
+  GrpcContextPool pool{4};
+  pool.Start();
+
+  std::set<std::thread::id> threads;
+  for (std::size_t i = 0; i < pool.size(); ++i) {
+    threads.insert(GetRunThread(pool.get_context(i).get_scheduler()));
+  }
+  ASSERT_EQ(threads.size(), pool.size());
+  ASSERT_EQ(threads.count(std::this_thread::get_id()), 0);
+
+  pool.ShutDown();
+  pool.Join();
+}
+
+TEST(GrpcContextPool, HandsOutSchedulersInTurn) {
+  GrpcContextPool pool{3};
+  pool.Start();
+
+  std::set<std::thread::id> threads;
+  for (std::size_t i = 0; i < pool.size(); ++i) {
+    threads.insert(GetRunThread(pool.get_next_scheduler()));
+  }
+  ASSERT_EQ(threads.size(), pool.size());
+
+  pool.ShutDown();
+  pool.Join();
+}
+
+TEST(GrpcContextPool, LeastLoadedSchedulerBelongsToThePool) {
+  GrpcContextPool pool{2};
+  pool.Start();
+
+  auto scheduler = pool.get_least_loaded_scheduler();
+  ASSERT_TRUE(scheduler == pool.get_context(0).get_scheduler() ||
+              scheduler == pool.get_context(1).get_scheduler());
+  GetRunThread(scheduler);
+
+  pool.ShutDown();
+  pool.Join();
+}
+
+TEST(GrpcContextPool, JoinReturnsOnceTheQueuesAreShutDown) {
+  GrpcContextPool pool{2};
+  pool.Start();
+  GetRunThread(pool.get_next_scheduler());
+
+  pool.ShutDown();
+  pool.Join();
+
+  for (std::size_t i = 0; i < pool.size(); ++i) {
+    ASSERT_TRUE(pool.get_context(i).is_shut_down());
+  }
+}
+
+TEST(GrpcContextPool, DestructorShutsDownAndJoins) {
+  auto pool = std::make_unique<GrpcContextPool>(2);
+  pool->Start();
+  GetRunThread(pool->get_next_scheduler());
+  pool.reset();
+}
+
+TEST(GrpcContextPool, DestructorAfterShutDown) {
+  // The destructor shuts the contexts down a second time.
+  auto pool = std::make_unique<GrpcContextPool>(2);
+  pool->Start();
+  GetRunThread(pool->get_next_scheduler());
+  pool->ShutDown();
+  pool.reset();
+}
+
+TEST(GrpcContextPool, DestructorOfUnstartedPool) {
+  GrpcContextPool pool{2};
+}
+
+}  // namespace
+}  // namespace agrpc
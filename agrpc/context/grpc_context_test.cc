@@ -0,0 +1,595 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/grpc_context.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <grpcpp/alarm.h>
+#include <unifex/async_scope.hpp>
+#include <unifex/inplace_stop_token.hpp>
+#include <unifex/just.hpp>
+#include <unifex/let_done.hpp>
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/stop_when.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/task.hpp>
+#include <unifex/then.hpp>
+
+#include "gtest/gtest.h"
+
+#include "agrpc/testing/grpc_context_helpers.h"
+
+namespace agrpc {
+namespace {
+
+using testing::AsyncAlarm;
+using testing::RunOnContext;
+using testing::RunUntil;
+using testing::ShutDownAndDrain;
+
+// Puts `alarms.size()` events on the completion queue of `context`. Expiring
+// alarms are posted by gRPC's timer thread at some point after their deadline,
+// cancelled ones before `Cancel` returns, so the events are all ready once this
+// returns.
+void QueueReadyEvents(GrpcContext& context, std::vector<grpc::Alarm>& alarms,
+                      unifex::async_scope& scope, std::size_t& completed) {
+  auto deadline = std::chrono::system_clock::now() + std::chrono::hours(1);
+  for (auto& alarm : alarms) {
+    scope.spawn(unifex::then(
+        AsyncAlarm(context.get_scheduler(), alarm, deadline), [&](bool ok) {
+          EXPECT_FALSE(ok);
+          ++completed;
+        }));
+  }
+  // The operations were scheduled remotely, start them on the context.
+  RunUntil(context, [&] {
+    return context.get_outstanding_work() == alarms.size();
+  });
+  for (auto& alarm : alarms) {
+    alarm.Cancel();
+  }
+}
+
+// Runs a context on a thread of its own for the lifetime of the fixture.
+class RunningGrpcContext {
+ public:
+  explicit RunningGrpcContext(GrpcContextOptions options = {})
+      : context_(std::make_unique<grpc::CompletionQueue>(), options),
+        thread_([this] { context_.Run(stop_source_.get_token()); }) {}
+
+  ~RunningGrpcContext() {
+    stop_source_.request_stop();
+    thread_.join();
+    ShutDownAndDrain(context_);
+  }
+
+  GrpcContext& context() noexcept { return context_; }
+
+ private:
+  GrpcContext context_;
+  unifex::inplace_stop_source stop_source_;
+  std::thread thread_;
+};
+
+TEST(GrpcContext, RunOneTimesOutWhenIdle) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  ASSERT_EQ(context.RunOne(std::chrono::steady_clock::now() +
+                           std::chrono::milliseconds(10)),
+            0);
+  ASSERT_EQ(context.Poll(), 0);
+  ShutDownAndDrain(context);
+}
+
+TEST(GrpcContext, RunOneRunsRemotelyScheduledWork) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  std::thread producer{
+      [&] { unifex::sync_wait(unifex::schedule(context.get_scheduler())); }};
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  std::size_t run = 0;
+  while (run == 0 && std::chrono::steady_clock::now() < deadline) {
+    run = context.RunOne(deadline);
+  }
+  ASSERT_EQ(run, 1);
+  producer.join();
+  ShutDownAndDrain(context);
+}
+
+TEST(GrpcContext, PollRunsAllReadyWork) {
+  constexpr std::size_t kProducers = 8;
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  std::vector<std::thread> producers;
+  for (std::size_t i = 0; i < kProducers; ++i) {
+    producers.emplace_back(
+        [&] { unifex::sync_wait(unifex::schedule(context.get_scheduler())); });
+  }
+  std::size_t run = 0;
+  while (run < kProducers) {
+    run += context.Poll();
+  }
+  ASSERT_EQ(run, kProducers);
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  ShutDownAndDrain(context);
+}
+
+TEST(GrpcContext, PollDrainsCompletionQueueInBatches) {
+  constexpr std::size_t kBatchSize = 4;
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>(),
+                      {.completion_queue_batch_size = kBatchSize}};
+  std::vector<grpc::Alarm> alarms(2 * kBatchSize);
+  unifex::async_scope scope;
+  std::size_t completed = 0;
+  QueueReadyEvents(context, alarms, scope, completed);
+
+  ASSERT_EQ(context.Poll(), kBatchSize);
+  ASSERT_EQ(completed, kBatchSize);
+  ASSERT_EQ(context.Poll(), kBatchSize);
+  ASSERT_EQ(completed, 2 * kBatchSize);
+
+  unifex::sync_wait(scope.cleanup());
+  ShutDownAndDrain(context);
+}
+
+TEST(GrpcContext, PollTakesOneEventWithoutBatching) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  std::vector<grpc::Alarm> alarms(3);
+  unifex::async_scope scope;
+  std::size_t completed = 0;
+  QueueReadyEvents(context, alarms, scope, completed);
+
+  for (std::size_t i = 1; i <= alarms.size(); ++i) {
+    ASSERT_EQ(context.Poll(), 1);
+    ASSERT_EQ(completed, i);
+  }
+
+  unifex::sync_wait(scope.cleanup());
+  ShutDownAndDrain(context);
+}
+
+TEST(GrpcContext, BusyPollSpinsBeforeBlocking) {
+  RunningGrpcContext running{
+      {.polling_policy = PollingPolicy::kAdaptiveBusyPoll,
+       .max_spin_budget = std::chrono::milliseconds(10)}};
+  auto scheduler = running.context().get_scheduler();
+  // Gaps well within the maximum budget are spun through.
+  for (int i = 0; i < 200; ++i) {
+    unifex::sync_wait(unifex::schedule(scheduler));
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+
+  auto stats = running.context().get_stats();
+  ASSERT_GT(stats.spin_hits, 0);
+  ASSERT_GT(stats.spin_time.count(), 0);
+}
+
+TEST(GrpcContext, BusyPollFallsBackToBlocking) {
+  RunningGrpcContext running{
+      {.polling_policy = PollingPolicy::kAdaptiveBusyPoll,
+       .min_spin_budget = std::chrono::microseconds(1),
+       .max_spin_budget = std::chrono::microseconds(1)}};
+  auto scheduler = running.context().get_scheduler();
+  // Gaps far beyond the budget end in the blocking `Next`.
+  for (int i = 0; i < 5; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    unifex::sync_wait(unifex::schedule(scheduler));
+  }
+
+  ASSERT_GT(running.context().get_stats().spin_misses, 0);
+}
+
+TEST(GrpcContext, BlockingPolicyNeverSpins) {
+  RunningGrpcContext running;
+  auto scheduler = running.context().get_scheduler();
+  for (int i = 0; i < 5; ++i) {
+    unifex::sync_wait(unifex::schedule(scheduler));
+  }
+
+  auto stats = running.context().get_stats();
+  ASSERT_EQ(stats.spin_hits, 0);
+  ASSERT_EQ(stats.spin_misses, 0);
+  ASSERT_EQ(stats.spin_time.count(), 0);
+}
+
+static_assert(unifex::scheduler<GrpcContext::Scheduler>);
+
+TEST(GrpcContextScheduler, EqualityFollowsTheContext) {
+  GrpcContext a{std::make_unique<grpc::CompletionQueue>()};
+  GrpcContext b{std::make_unique<grpc::CompletionQueue>()};
+  ASSERT_TRUE(a.get_scheduler() == a.get_scheduler());
+  ASSERT_TRUE(a.get_scheduler() ==
+              a.get_scheduler().WithDeadline(std::chrono::steady_clock::now()));
+  ASSERT_FALSE(a.get_scheduler() == b.get_scheduler());
+  ShutDownAndDrain(a);
+  ShutDownAndDrain(b);
+}
+
+TEST(GrpcContextScheduler, ScheduleCompletesOnTheContextThread) {
+  RunningGrpcContext running;
+  auto thread = unifex::sync_wait(
+      unifex::then(unifex::schedule(running.context().get_scheduler()),
+                   [] { return std::this_thread::get_id(); }));
+  ASSERT_TRUE(thread.has_value());
+  ASSERT_NE(*thread, std::this_thread::get_id());
+}
+
+TEST(GrpcContextScheduler, ScheduleOnTheContextQueuesBehindPendingWork) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  unifex::async_scope scope;
+  std::vector<int> order;
+  RunOnContext(context, [&] {
+    scope.spawn(unifex::then(unifex::schedule(context.get_scheduler()),
+                             [&] { order.push_back(2); }));
+    order.push_back(1);
+  });
+  RunUntil(context, [&] { return order.size() == 2; });
+  ASSERT_EQ(order, (std::vector<int>{1, 2}));
+  unifex::sync_wait(scope.cleanup());
+  ShutDownAndDrain(context);
+}
+
+TEST(GrpcContextScheduler, ScheduleAfterWaitsForTheDuration) {
+  RunningGrpcContext running;
+  auto start = std::chrono::steady_clock::now();
+  auto result = unifex::sync_wait(unifex::schedule_after(
+      running.context().get_scheduler(), std::chrono::milliseconds(20)));
+  ASSERT_TRUE(result.has_value());
+  ASSERT_GE(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(20));
+}
+
+TEST(GrpcContextScheduler, ScheduleAtInThePastCompletesRightAway) {
+  RunningGrpcContext running;
+  auto start = std::chrono::steady_clock::now();
+  auto result = unifex::sync_wait(
+      unifex::schedule_at(running.context().get_scheduler(),
+                          start - std::chrono::seconds(1)));
+  ASSERT_TRUE(result.has_value());
+  ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+}
+
+TEST(GrpcContextScheduler, ScheduleAfterCompletesWithDoneOnStop) {
+  RunningGrpcContext running;
+  auto scheduler = running.context().get_scheduler();
+  auto start = std::chrono::steady_clock::now();
+  auto result = unifex::sync_wait(unifex::stop_when(
+      unifex::schedule_after(scheduler, std::chrono::seconds(30)),
+      unifex::schedule_after(scheduler, std::chrono::milliseconds(10))));
+  ASSERT_FALSE(result.has_value());
+  ASSERT_LT(std::chrono::steady_clock::now() - start,
+            std::chrono::seconds(10));
+}
+
+// Spawns a timer of `duration` that records `id` into `fired`, or `-id` if it
+// completes with done.
+void SpawnTimer(unifex::async_scope& scope, GrpcContext& context,
+                std::chrono::milliseconds duration, int id,
+                std::vector<int>& fired) {
+  scope.spawn(unifex::let_done(
+      unifex::then(unifex::schedule_after(context.get_scheduler(), duration),
+                   [&fired, id] { fired.push_back(id); }),
+      [&fired, id] {
+        fired.push_back(-id);
+        return unifex::just();
+      }));
+}
+
+TEST(GrpcContextTimer, TimersFireInDeadlineOrder) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  unifex::async_scope scope;
+  std::vector<int> fired;
+  SpawnTimer(scope, context, std::chrono::milliseconds(30), 3, fired);
+  SpawnTimer(scope, context, std::chrono::milliseconds(10), 1, fired);
+  SpawnTimer(scope, context, std::chrono::milliseconds(20), 2, fired);
+  RunUntil(context, [&] { return fired.size() == 3; });
+  ASSERT_EQ(fired, (std::vector<int>{1, 2, 3}));
+  unifex::sync_wait(scope.cleanup());
+  ShutDownAndDrain(context);
+}
+
+TEST(GrpcContextTimer, CancelledTimerLeavesOthersPending) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  unifex::async_scope scope;
+  std::vector<int> fired;
+  SpawnTimer(scope, context, std::chrono::milliseconds(20), 2, fired);
+  // Stopped by an earlier timer, which cancels its entry on the wheel.
+  scope.spawn(unifex::let_done(
+      unifex::stop_when(
+          unifex::then(unifex::schedule_after(context.get_scheduler(),
+                                              std::chrono::hours(1)),
+                       [&] { fired.push_back(1); }),
+          unifex::schedule_after(context.get_scheduler(),
+                                 std::chrono::milliseconds(5))),
+      [&] {
+        fired.push_back(-1);
+        return unifex::just();
+      }));
+  RunUntil(context, [&] { return fired.size() == 2; });
+  ASSERT_EQ(fired, (std::vector<int>{-1, 2}));
+  unifex::sync_wait(scope.cleanup());
+  ShutDownAndDrain(context);
+}
+
+TEST(GrpcContextTimer, ShutDownCompletesPendingTimersWithDone) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  unifex::async_scope scope;
+  std::vector<int> fired;
+  SpawnTimer(scope, context, std::chrono::hours(1), 1, fired);
+  SpawnTimer(scope, context, std::chrono::hours(2), 2, fired);
+  // The timers were scheduled remotely, start them on the context.
+  RunUntil(context, [&] { return context.get_outstanding_work() == 2; });
+  ASSERT_TRUE(fired.empty());
+
+  // From a foreign thread, so the timers are shut down by the loop.
+  ShutDownAndDrain(context);
+  ASSERT_EQ(fired, (std::vector<int>{-1, -2}));
+  unifex::sync_wait(scope.cleanup());
+}
+
+TEST(GrpcContextTimer, ShutDownOnTheLoopThreadCompletesTimersWithDone) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  unifex::async_scope scope;
+  std::vector<int> fired;
+  SpawnTimer(scope, context, std::chrono::hours(1), 1, fired);
+  RunUntil(context, [&] { return context.get_outstanding_work() == 1; });
+
+  RunOnContext(context, [&] { context.ShutDown(); });
+  while (!context.is_shut_down()) {
+    context.RunOne();
+  }
+  ASSERT_EQ(fired, (std::vector<int>{-1}));
+  unifex::sync_wait(scope.cleanup());
+}
+
+TEST(GrpcContext, ShutDownTwice) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  unifex::async_scope scope;
+  std::vector<int> fired;
+  SpawnTimer(scope, context, std::chrono::hours(1), 1, fired);
+  RunUntil(context, [&] { return context.get_outstanding_work() == 1; });
+
+  context.ShutDown();
+  context.ShutDown();
+  while (!context.is_shut_down()) {
+    context.RunOne();
+  }
+  context.ShutDown();
+  ASSERT_EQ(fired, (std::vector<int>{-1}));
+  unifex::sync_wait(scope.cleanup());
+}
+
+// Spawns work on `scheduler` that records `id` into `order`, along with whether
+// it was already expired when it ran.
+void SpawnRecording(unifex::async_scope& scope, GrpcContext& context,
+                    GrpcContext::Scheduler scheduler, int id,
+                    std::vector<std::pair<int, bool>>& order) {
+  scope.spawn(unifex::then(unifex::schedule(scheduler), [&, id] {
+    order.emplace_back(id, context.is_current_work_expired());
+  }));
+}
+
+TEST(GrpcContextDeadline, RunsEarlierDeadlinesFirst) {
+  GrpcContext context{
+      std::make_unique<grpc::CompletionQueue>(),
+      {.scheduling_policy = SchedulingPolicy::kEarliestDeadlineFirst}};
+  auto scheduler = context.get_scheduler();
+  auto now = std::chrono::steady_clock::now();
+  unifex::async_scope scope;
+  std::vector<std::pair<int, bool>> order;
+  RunOnContext(context, [&] {
+    SpawnRecording(scope, context, scheduler, 4, order);
+    SpawnRecording(scope, context,
+                   scheduler.WithDeadline(now + std::chrono::hours(1)), 3,
+                   order);
+    SpawnRecording(scope, context,
+                   scheduler.WithDeadline(now + std::chrono::milliseconds(50)),
+                   1, order);
+    SpawnRecording(scope, context,
+                   scheduler.WithDeadline(now + std::chrono::seconds(10)), 2,
+                   order);
+  });
+  ASSERT_EQ(context.Poll(), 4);
+  ASSERT_EQ(order, (std::vector<std::pair<int, bool>>{
+                       {1, false}, {2, false}, {3, false}, {4, false}}));
+  ASSERT_EQ(context.get_stats().expired_work, 0);
+  unifex::sync_wait(scope.cleanup());
+  ShutDownAndDrain(context);
+}
+
+TEST(GrpcContextDeadline, RunsExpiredWorkFirstAndFlagsIt) {
+  GrpcContext context{
+      std::make_unique<grpc::CompletionQueue>(),
+      {.scheduling_policy = SchedulingPolicy::kEarliestDeadlineFirst}};
+  auto scheduler = context.get_scheduler();
+  auto now = std::chrono::steady_clock::now();
+  unifex::async_scope scope;
+  std::vector<std::pair<int, bool>> order;
+  RunOnContext(context, [&] {
+    SpawnRecording(scope, context,
+                   scheduler.WithDeadline(now + std::chrono::seconds(10)), 2,
+                   order);
+    SpawnRecording(scope, context,
+                   scheduler.WithDeadline(now - std::chrono::seconds(1)), 1,
+                   order);
+  });
+  ASSERT_EQ(context.Poll(), 2);
+  ASSERT_EQ(order, (std::vector<std::pair<int, bool>>{{1, true}, {2, false}}));
+  ASSERT_EQ(context.get_stats().expired_work, 1);
+  unifex::sync_wait(scope.cleanup());
+  ShutDownAndDrain(context);
+}
+
+TEST(GrpcContextDeadline, FifoPolicyIgnoresDeadlines) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  auto scheduler = context.get_scheduler();
+  auto now = std::chrono::steady_clock::now();
+  unifex::async_scope scope;
+  std::vector<std::pair<int, bool>> order;
+  RunOnContext(context, [&] {
+    SpawnRecording(scope, context,
+                   scheduler.WithDeadline(now + std::chrono::hours(1)), 1,
+                   order);
+    SpawnRecording(scope, context,
+                   scheduler.WithDeadline(now - std::chrono::seconds(1)), 2,
+                   order);
+  });
+  ASSERT_EQ(context.Poll(), 2);
+  ASSERT_EQ(order, (std::vector<std::pair<int, bool>>{{1, false}, {2, false}}));
+  unifex::sync_wait(scope.cleanup());
+  ShutDownAndDrain(context);
+}
+
+TEST(GrpcContextBudget, ItemBudgetBoundsAPass) {
+  constexpr int kBurst = 10;
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>(),
+                      {.local_work_item_budget = 3}};
+  unifex::async_scope scope;
+  std::vector<int> order;
+  RunOnContext(context, [&] {
+    for (int i = 0; i < kBurst; ++i) {
+      scope.spawn(unifex::then(unifex::schedule(context.get_scheduler()),
+                               [&, i] { order.push_back(i); }));
+    }
+  });
+  // Two passes of three, with the queues polled in between.
+  ASSERT_EQ(context.Poll(), 6);
+  ASSERT_EQ(context.get_stats().starvation_events, 2);
+  while (order.size() < kBurst) {
+    context.Poll();
+  }
+  // The rest is run ahead of new work and in order.
+  for (int i = 0; i < kBurst; ++i) {
+    ASSERT_EQ(order[i], i);
+  }
+  unifex::sync_wait(scope.cleanup());
+  ShutDownAndDrain(context);
+}
+
+TEST(GrpcContextBudget, CompletionOvertakesABurst) {
+  constexpr int kBurst = 100;
+  constexpr int kCompletion = -1;
+  GrpcContext context{
+      std::make_unique<grpc::CompletionQueue>(),
+      {.scheduling_policy = SchedulingPolicy::kEarliestDeadlineFirst,
+       .local_work_item_budget = 10}};
+  auto scheduler = context.get_scheduler();
+  auto now = std::chrono::steady_clock::now();
+  grpc::Alarm alarm;
+  unifex::async_scope scope;
+  std::vector<int> order;
+  RunOnContext(context, [&] {
+    for (int i = 0; i < kBurst; ++i) {
+      scope.spawn(unifex::then(
+          unifex::schedule(scheduler.WithDeadline(now + std::chrono::hours(1))),
+          [&, i] { order.push_back(i); }));
+    }
+    scope.spawn(unifex::then(
+        AsyncAlarm(
+            scheduler.WithDeadline(now + std::chrono::milliseconds(100)),
+            alarm, std::chrono::system_clock::now() + std::chrono::hours(1)),
+        [&](bool) { order.push_back(kCompletion); }));
+  });
+  // Puts the alarm's event on the completion queue before returning, unlike
+  // waiting for it to expire.
+  alarm.Cancel();
+  while (order.size() < kBurst + 1) {
+    context.Poll();
+  }
+  // Without the budget it would only run after the whole burst.
+  auto position = std::find(order.begin(), order.end(), kCompletion);
+  ASSERT_LT(position - order.begin(), kBurst / 2);
+  ASSERT_GT(context.get_stats().starvation_events, 0);
+  unifex::sync_wait(scope.cleanup());
+  ShutDownAndDrain(context);
+}
+
+unifex::task<void> YieldUntil(GrpcContext::Scheduler scheduler,
+                              const bool& flag, int& yields) {
+  while (!flag) {
+    co_await yield(scheduler);
+    ++yields;
+  }
+}
+
+TEST(GrpcContextYield, LetsCompletionsIn) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  grpc::Alarm alarm;
+  unifex::async_scope scope;
+  bool completed = false;
+  int yields = 0;
+  RunOnContext(context, [&] {
+    scope.spawn(unifex::then(AsyncAlarm(context.get_scheduler(), alarm),
+                             [&](bool) { completed = true; }));
+    scope.spawn(YieldUntil(context.get_scheduler(), completed, yields));
+  });
+  // The yielding task always has work ready, yet the completion gets in.
+  while (!completed || context.get_outstanding_work() > 0) {
+    context.Poll();
+  }
+  context.Poll();
+  ASSERT_GT(yields, 0);
+  unifex::sync_wait(scope.cleanup());
+  ShutDownAndDrain(context);
+}
+
+TEST(GrpcContextYield, LetsRemoteWorkIn) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  unifex::async_scope scope;
+  bool flag = false;
+  int yields = 0;
+  RunOnContext(context, [&] {
+    scope.spawn(YieldUntil(context.get_scheduler(), flag, yields));
+  });
+  std::thread producer{[&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    unifex::sync_wait(unifex::then(unifex::schedule(context.get_scheduler()),
+                                   [&] { flag = true; }));
+  }};
+  while (!flag) {
+    context.Poll();
+  }
+  context.Poll();
+  producer.join();
+  ASSERT_GT(yields, 0);
+  unifex::sync_wait(scope.cleanup());
+  ShutDownAndDrain(context);
+}
+
+TEST(GrpcContextYield, ResumesBehindReadyWork) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  unifex::async_scope scope;
+  std::vector<int> order;
+  auto scheduler = context.get_scheduler();
+  RunOnContext(context, [&] {
+    scope.spawn(unifex::then(unifex::schedule(scheduler),
+                             [&] { order.push_back(2); }));
+    scope.spawn(unifex::then(yield(scheduler), [&] { order.push_back(3); }));
+    order.push_back(1);
+  });
+  while (order.size() < 3) {
+    context.Poll();
+  }
+  ASSERT_EQ(order, (std::vector<int>{1, 2, 3}));
+  unifex::sync_wait(scope.cleanup());
+  ShutDownAndDrain(context);
+}
+
+}  // namespace
+}  // namespace agrpc
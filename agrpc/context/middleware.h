@@ -0,0 +1,271 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_CONTEXT_MIDDLEWARE_H_
+#define AGRPC_CONTEXT_MIDDLEWARE_H_
+
+#include <cstddef>
+#include <exception>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <grpcpp/support/status.h>
+
+#include "agrpc/context/rpcs.h"
+#include "agrpc/context/task.h"
+
+namespace agrpc {
+
+// What middleware hooks get to see of a call.
+template <typename ServerContext, typename Request>
+class MiddlewareCall {
+ public:
+  explicit MiddlewareCall(ServerContext& server_context,
+                          const Request& request) noexcept
+      : server_context_(server_context), request_(request) {}
+
+  ServerContext& server_context() const noexcept { return server_context_; }
+  const Request& request() const noexcept { return request_; }
+
+  // In `After`, the exception a `Before` hook, the handler or finishing the
+  // call with an error exited with, if any.
+  std::exception_ptr exception() const noexcept { return exception_; }
+
+  // In `After`, the error a middleware finished the call with instead of
+  // running the handler. OK if the handler ran.
+  const grpc::Status& rejection() const noexcept { return rejection_; }
+
+ private:
+  template <typename Handler, typename... Middlewares>
+  friend class MiddlewareHandler;
+
+  ServerContext& server_context_;
+  const Request& request_;
+  std::exception_ptr exception_;
+  grpc::Status rejection_;
+};
+
+namespace detail {
+
+struct NoMiddlewareState {};
+
+template <typename Middleware, typename = void>
+struct MiddlewareStateOf {
+  using type = NoMiddlewareState;
+};
+
+template <typename Middleware>
+struct MiddlewareStateOf<Middleware,
+                         std::void_t<typename Middleware::State>> {
+  using type = typename Middleware::State;
+};
+
+template <typename Middleware, typename Call, typename State>
+grpc::Status InvokeBefore(Middleware& middleware, Call& call, State& state) {
+  if constexpr (requires { middleware.Before(call, state); }) {
+    if constexpr (std::is_void_v<decltype(middleware.Before(call, state))>) {
+      middleware.Before(call, state);
+      return grpc::Status::OK;
+    } else {
+      return middleware.Before(call, state);
+    }
+  } else if constexpr (requires { middleware.Before(call); }) {
+    if constexpr (std::is_void_v<decltype(middleware.Before(call))>) {
+      middleware.Before(call);
+      return grpc::Status::OK;
+    } else {
+      return middleware.Before(call);
+    }
+  } else {
+    return grpc::Status::OK;
+  }
+}
+
+template <typename Middleware, typename Call, typename State>
+void InvokeAfter(Middleware& middleware, Call& call, State& state) noexcept {
+  if constexpr (requires { middleware.After(call, state); }) {
+    middleware.After(call, state);
+  } else if constexpr (requires { middleware.After(call); }) {
+    middleware.After(call);
+  }
+}
+
+// Finishes a call with an error status. gRPC only has `FinishWithError` for
+// responders that would otherwise send a response message.
+template <typename Executor, typename Responder>
+auto FinishWithStatus(Executor& executor, Responder& responder,
+                      const grpc::Status& status) {
+  if constexpr (std::is_invocable_v<decltype(AsyncFinishWithError), Executor&,
+                                    Responder&, const grpc::Status&>) {
+    return AsyncFinishWithError(executor, responder, status);
+  } else {
+    return AsyncFinish(executor, responder, status);
+  }
+}
+
+}  // namespace detail
+
+// A handler wrapped in middlewares, see `middleware::wrap`.
+template <typename Handler, typename... Middlewares>
+class MiddlewareHandler {
+ public:
+  explicit MiddlewareHandler(std::tuple<Middlewares...>& middlewares,
+                             Handler handler)
+      : middlewares_(middlewares), handler_(std::move(handler)) {}
+
+  template <typename Executor, typename ServerContext, typename Request,
+            typename Response, typename Responder>
+  task<void> operator()(Executor executor, ServerContext& server_context,
+                        Request& request, Response& response,
+                        Responder& responder) {
+    MiddlewareCall<ServerContext, Request> call{server_context, request};
+    std::tuple<typename detail::MiddlewareStateOf<Middlewares>::type...>
+        states;
+    std::size_t passed = 0;
+    try {
+      grpc::Status status = Before(call, states, passed,
+                                   std::index_sequence_for<Middlewares...>{});
+      if (status.ok()) {
+        co_await handler_(executor, server_context, request, response,
+                          responder);
+      } else {
+        call.rejection_ = status;
+        co_await detail::FinishWithStatus(executor, responder,
+                                          call.rejection_);
+      }
+    } catch (...) {
+      call.exception_ = std::current_exception();
+    }
+    After(call, states, passed, std::index_sequence_for<Middlewares...>{});
+    if (call.exception_) {
+      std::rethrow_exception(call.exception_);
+    }
+  }
+
+ private:
+  // Runs the `Before` hooks in order until one rejects the call or throws.
+  // `passed` is the number of hooks that let it through.
+  template <typename Call, typename States, std::size_t... Is>
+  grpc::Status Before(Call& call, States& states, std::size_t& passed,
+                      std::index_sequence<Is...>) {
+    grpc::Status status;
+    ((status = detail::InvokeBefore(std::get<Is>(middlewares_), call,
+                                    std::get<Is>(states)),
+      status.ok() && (++passed, true)) &&
+     ...);
+    return status;
+  }
+
+  // Runs the `After` hooks of the middlewares that let the call through, in
+  // reverse order.
+  template <typename Call, typename States, std::size_t... Is>
+  void After(Call& call, States& states, std::size_t passed,
+             std::index_sequence<Is...>) noexcept {
+    constexpr std::size_t kCount = sizeof...(Is);
+    ((kCount - 1 - Is < passed
+          ? detail::InvokeAfter(std::get<kCount - 1 - Is>(middlewares_), call,
+                                std::get<kCount - 1 - Is>(states))
+          : void()),
+     ...);
+  }
+
+  std::tuple<Middlewares...>& middlewares_;
+  Handler handler_;
+};
+
+// A chain of middlewares run around every call of the handlers it wraps, e.g.
+// for authentication, metrics, deadline checks and logging. Unlike gRPC's
+// interceptors, the chain is put together at compile time: its hooks are
+// called without virtual dispatch from a single coroutine frame that awaits
+// the frame of the wrapped handler. Both frames come from the frame cache of
+// the context the call runs on, so the chain adds one cached frame per call
+// however many middlewares it has.
+//
+//   struct Auth {
+//     template <typename Call>
+//     grpc::Status Before(Call& call) {
+//       if (!IsAuthorized(call.server_context())) {
+//         return grpc::Status(grpc::StatusCode::UNAUTHENTICATED, "");
+//       }
+//       return grpc::Status::OK;
+//     }
+//   };
+//
+//   struct Metrics {
+//     struct State {
+//       std::chrono::steady_clock::time_point start;
+//     };
+//     template <typename Call>
+//     void Before(Call& call, State& state) {
+//       state.start = std::chrono::steady_clock::now();
+//     }
+//     template <typename Call>
+//     void After(Call& call, State& state) noexcept { ... }
+//   };
+//
+//   agrpc::middleware<Auth, Metrics> chain;
+//   auto handler = chain.wrap(
+//       [](auto executor, auto& server_context, auto& request, auto& response,
+//          auto& responder) -> agrpc::task<void> { ... });
+//
+// Middlewares may have
+//
+//   - `Before(call)`, called in order before the handler. Returns `void` or a
+//     `grpc::Status`. If it is not OK, the call is finished with it through
+//     `AsyncFinishWithError` (or `AsyncFinish` for streaming responders) and
+//     neither the handler nor the remaining `Before` hooks run.
+//   - `After(call)`, called in reverse order once the handler returned, the
+//     call was rejected or a later `Before` threw, for every middleware whose
+//     `Before` let the call through. Must not throw.
+//
+// `call` is a `MiddlewareCall`. A middleware with a nested `State` type gets a
+// value-initialized `State` per call as a second argument to both hooks.
+//
+// Wrapped handlers are called as `handler(executor, server_context, request,
+// response, responder)`, the shape of the methods of generated service
+// skeletons and of the handlers of the callback backend, and call the handler
+// they wrap the same way. Exceptions of `Before` hooks and of the handler are
+// rethrown after the `After` hooks of the middlewares entered so far ran.
+template <typename... Middlewares>
+class middleware {
+ public:
+  middleware() = default;
+
+  explicit middleware(Middlewares... middlewares)
+      : middlewares_(std::move(middlewares)...) {}
+
+  middleware(const middleware&) = delete;
+  middleware& operator=(const middleware&) = delete;
+
+  // Wraps `handler` in the chain, which must outlive the result.
+  template <typename Handler>
+  MiddlewareHandler<Handler, Middlewares...> wrap(Handler handler) {
+    return MiddlewareHandler<Handler, Middlewares...>{middlewares_,
+                                                      std::move(handler)};
+  }
+
+  // The middleware of type `Middleware`, e.g. to read its counters.
+  template <typename Middleware>
+  Middleware& get() noexcept {
+    return std::get<Middleware>(middlewares_);
+  }
+
+ private:
+  std::tuple<Middlewares...> middlewares_;
+};
+
+}  // namespace agrpc
+
+#endif  // AGRPC_CONTEXT_MIDDLEWARE_H_
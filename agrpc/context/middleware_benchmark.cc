@@ -0,0 +1,283 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/middleware.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include <grpcpp/create_channel.h>
+#include <grpcpp/security/credentials.h>
+#include <grpcpp/security/server_credentials.h>
+#include <grpcpp/support/channel_arguments.h>
+#include <grpcpp/support/server_interceptor.h>
+#include <unifex/async_scope.hpp>
+#include <unifex/sync_wait.hpp>
+
+#include "benchmark/benchmark.h"
+
+#include "agrpc/base/thread.h"
+#include "agrpc/context/grpc_context_pool.h"
+#include "agrpc/context/serve.h"
+#include "agrpc/context/task.h"
+#include "agrpc/testing/echo.grpc.pb.h"
+
+// Compares the cost of authentication, deadline and metrics checks around an
+// echo handler when done by a `middleware` chain with doing them in a
+// `grpc::experimental::Interceptor`, which gRPC allocates per call and calls
+// virtually at every hook point. Server interceptors cannot reject a call
+// before the handler runs, so the interceptor can only replace the status the
+// handler finished with. All calls pass the checks here.
+
+namespace agrpc {
+
+namespace {
+
+using testing::EchoRequest;
+using testing::EchoResponse;
+using testing::EchoService;
+
+constexpr std::size_t kAcceptorsPerContext = 16;
+constexpr std::string_view kAuthorization = "authorization";
+constexpr std::string_view kToken = "Bearer benchmark";
+
+struct Metrics {
+  std::atomic<std::uint64_t> calls{0};
+  std::atomic<std::uint64_t> latency_ns{0};
+
+  void Record(std::chrono::steady_clock::time_point start) noexcept {
+    calls.fetch_add(1, std::memory_order_relaxed);
+    latency_ns.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count(),
+        std::memory_order_relaxed);
+  }
+};
+
+Metrics metrics;
+
+template <typename Metadata>
+bool IsAuthorized(const Metadata& metadata) {
+  auto it = metadata.find(
+      grpc::string_ref(kAuthorization.data(), kAuthorization.size()));
+  return it != metadata.end() &&
+         std::string_view(it->second.data(), it->second.size()) == kToken;
+}
+
+bool IsPastDeadline(const grpc::ServerContextBase& server_context) {
+  return server_context.deadline() < std::chrono::system_clock::now();
+}
+
+struct AuthMiddleware {
+  template <typename Call>
+  grpc::Status Before(Call& call) {
+    if (!IsAuthorized(call.server_context().client_metadata())) {
+      return grpc::Status(grpc::StatusCode::UNAUTHENTICATED, "");
+    }
+    return grpc::Status::OK;
+  }
+};
+
+struct DeadlineMiddleware {
+  template <typename Call>
+  grpc::Status Before(Call& call) {
+    if (IsPastDeadline(call.server_context())) {
+      return grpc::Status(grpc::StatusCode::DEADLINE_EXCEEDED, "");
+    }
+    return grpc::Status::OK;
+  }
+};
+
+struct MetricsMiddleware {
+  struct State {
+    std::chrono::steady_clock::time_point start;
+  };
+
+  template <typename Call>
+  void Before(Call&, State& state) {
+    state.start = std::chrono::steady_clock::now();
+  }
+
+  template <typename Call>
+  void After(Call&, State& state) noexcept {
+    metrics.Record(state.start);
+  }
+};
+
+class ChecksInterceptor : public grpc::experimental::Interceptor {
+ public:
+  explicit ChecksInterceptor(grpc::experimental::ServerRpcInfo* info)
+      : info_(info) {}
+
+  void Intercept(
+      grpc::experimental::InterceptorBatchMethods* methods) override {
+    using grpc::experimental::InterceptionHookPoints;
+    if (methods->QueryInterceptionHookPoint(
+            InterceptionHookPoints::POST_RECV_INITIAL_METADATA)) {
+      start_ = std::chrono::steady_clock::now();
+      if (!IsAuthorized(*methods->GetRecvInitialMetadata())) {
+        rejection_ = grpc::Status(grpc::StatusCode::UNAUTHENTICATED, "");
+      } else if (IsPastDeadline(*info_->server_context())) {
+        rejection_ = grpc::Status(grpc::StatusCode::DEADLINE_EXCEEDED, "");
+      }
+    }
+    if (methods->QueryInterceptionHookPoint(
+            InterceptionHookPoints::PRE_SEND_STATUS)) {
+      if (!rejection_.ok()) {
+        methods->ModifySendStatus(rejection_);
+      }
+      metrics.Record(start_);
+    }
+    methods->Proceed();
+  }
+
+ private:
+  grpc::experimental::ServerRpcInfo* info_;
+  std::chrono::steady_clock::time_point start_;
+  grpc::Status rejection_;
+};
+
+class ChecksInterceptorFactory
+    : public grpc::experimental::ServerInterceptorFactoryInterface {
+ public:
+  grpc::experimental::Interceptor* CreateServerInterceptor(
+      grpc::experimental::ServerRpcInfo* info) override {
+    return new ChecksInterceptor(info);
+  }
+};
+
+template <typename Executor, typename ServerContext, typename Responder>
+task<void> HandleEcho(Executor executor, ServerContext&,
+                      const EchoRequest& request, EchoResponse& response,
+                      Responder& responder) {
+  response.set_message(request.message());
+  co_await AsyncFinish(executor, responder, response, grpc::Status::OK);
+}
+
+enum class Checks { kNone, kMiddleware, kInterceptor };
+
+template <Checks kChecks>
+class EchoServer {
+ public:
+  EchoServer() {
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort("127.0.0.1:0", grpc::InsecureServerCredentials(),
+                             &port_);
+    builder.RegisterService(&service_);
+    if constexpr (kChecks == Checks::kInterceptor) {
+      std::vector<std::unique_ptr<
+          grpc::experimental::ServerInterceptorFactoryInterface>>
+          creators;
+      creators.push_back(std::make_unique<ChecksInterceptorFactory>());
+      builder.experimental().SetInterceptorCreators(std::move(creators));
+    }
+    pool_ = std::make_unique<GrpcContextPool>(builder,
+                                              GetNumberOfProcessorsAvailable());
+    server_ = builder.BuildAndStart();
+    for (std::size_t i = 0; i < pool_->size(); ++i) {
+      Spawn(pool_->get_context(i).get_scheduler());
+    }
+    pool_->Start();
+  }
+
+  ~EchoServer() {
+    server_->Shutdown();
+    pool_->ShutDown();
+    pool_->Join();
+    unifex::sync_wait(scope_.cleanup());
+  }
+
+  int port() const noexcept { return port_; }
+
+ private:
+  void Spawn(GrpcContext::Scheduler scheduler) {
+    auto echo = [](auto&&... args) { return HandleEcho(args...); };
+    auto handler = [&] {
+      if constexpr (kChecks == Checks::kMiddleware) {
+        return chain_.wrap(echo);
+      } else {
+        return echo;
+      }
+    }();
+    scope_.spawn(serve(
+        scheduler, &EchoService::AsyncService::RequestEcho, service_,
+        [scheduler, handler](auto& server_context, auto& request,
+                             auto& response, auto& responder) mutable {
+          return handler(scheduler, server_context, request, response,
+                         responder);
+        },
+        {.outstanding_requests = kAcceptorsPerContext}));
+  }
+
+  int port_{0};
+  EchoService::AsyncService service_;
+  middleware<AuthMiddleware, DeadlineMiddleware, MetricsMiddleware> chain_;
+  std::unique_ptr<GrpcContextPool> pool_;
+  std::unique_ptr<grpc::Server> server_;
+  unifex::async_scope scope_;
+};
+
+template <typename Server>
+void RunEchoClient(benchmark::State& state) {
+  static Server server;
+
+  // Keep each client thread on its own connection.
+  grpc::ChannelArguments args;
+  args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+  auto stub = EchoService::NewStub(grpc::CreateCustomChannel(
+      fmt::format("127.0.0.1:{}", server.port()),
+      grpc::InsecureChannelCredentials(), args));
+
+  EchoRequest request;
+  request.set_message("hello");
+  while (state.KeepRunning()) {
+    grpc::ClientContext client_context;
+    client_context.AddMetadata(std::string(kAuthorization),
+                               std::string(kToken));
+    EchoResponse response;
+    auto status = stub->Echo(&client_context, request, &response);
+    if (!status.ok()) {
+      state.SkipWithError(status.error_message().c_str());
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+}  // namespace
+
+void Benchmark_NoChecks(benchmark::State& state) {
+  RunEchoClient<EchoServer<Checks::kNone>>(state);
+}
+
+BENCHMARK(Benchmark_NoChecks)->ThreadRange(1, 64)->UseRealTime();
+
+void Benchmark_Middleware(benchmark::State& state) {
+  RunEchoClient<EchoServer<Checks::kMiddleware>>(state);
+}
+
+BENCHMARK(Benchmark_Middleware)->ThreadRange(1, 64)->UseRealTime();
+
+void Benchmark_Interceptor(benchmark::State& state) {
+  RunEchoClient<EchoServer<Checks::kInterceptor>>(state);
+}
+
+BENCHMARK(Benchmark_Interceptor)->ThreadRange(1, 64)->UseRealTime();
+
+}  // namespace agrpc
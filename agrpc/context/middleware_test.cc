@@ -0,0 +1,237 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/middleware.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <grpcpp/server_context.h>
+#include <unifex/just.hpp>
+#include <unifex/sync_wait.hpp>
+
+#include "gtest/gtest.h"
+
+#include "agrpc/testing/echo.pb.h"
+
+namespace agrpc {
+namespace {
+
+using testing::EchoRequest;
+using testing::EchoResponse;
+
+struct TestExecutor {};
+
+// Records how the call was finished instead of talking to gRPC.
+struct TestResponder : detail::BackendResponder {
+  bool finished_with_error = false;
+  grpc::Status status;
+};
+
+auto tag_invoke(tag_t<AsyncFinishWithError>, TestExecutor,
+                TestResponder& responder, const grpc::Status& status) {
+  responder.finished_with_error = true;
+  responder.status = status;
+  return unifex::just(true);
+}
+
+using Log = std::vector<std::string>;
+
+template <int N>
+struct Record {
+  Log* log;
+
+  template <typename Call>
+  void Before(Call&) {
+    log->push_back("before " + std::to_string(N));
+  }
+
+  template <typename Call>
+  void After(Call&) noexcept {
+    log->push_back("after " + std::to_string(N));
+  }
+};
+
+struct Reject {
+  Log* log;
+
+  template <typename Call>
+  grpc::Status Before(Call& call) {
+    log->push_back("reject");
+    if (call.request().message() == "denied") {
+      return grpc::Status(grpc::StatusCode::PERMISSION_DENIED, "denied");
+    }
+    return grpc::Status::OK;
+  }
+
+  template <typename Call>
+  void After(Call&) noexcept {
+    log->push_back("after reject");
+  }
+};
+
+struct Echo {
+  Log* log;
+
+  task<void> operator()(TestExecutor, grpc::ServerContext&,
+                        EchoRequest& request, EchoResponse& response,
+                        TestResponder&) {
+    log->push_back("handler");
+    response.set_message(request.message());
+    co_return;
+  }
+};
+
+TEST(Middleware, RunsHooksAroundHandler) {
+  Log log;
+  middleware<Record<1>, Record<2>> chain{Record<1>{&log}, Record<2>{&log}};
+  auto handler = chain.wrap(Echo{&log});
+
+  grpc::ServerContext server_context;
+  EchoRequest request;
+  request.set_message("hello");
+  EchoResponse response;
+  TestResponder responder;
+  unifex::sync_wait(handler(TestExecutor{}, server_context, request, response,
+                            responder));
+
+  ASSERT_EQ(log, (Log{"before 1", "before 2", "handler", "after 2",
+                      "after 1"}));
+  ASSERT_EQ(response.message(), "hello");
+  ASSERT_FALSE(responder.finished_with_error);
+}
+
+TEST(Middleware, ShortCircuitsWithError) {
+  Log log;
+  middleware<Record<1>, Reject, Record<2>> chain{
+      Record<1>{&log}, Reject{&log}, Record<2>{&log}};
+  auto handler = chain.wrap(Echo{&log});
+
+  grpc::ServerContext server_context;
+  EchoRequest request;
+  request.set_message("denied");
+  EchoResponse response;
+  TestResponder responder;
+  unifex::sync_wait(handler(TestExecutor{}, server_context, request, response,
+                            responder));
+
+  ASSERT_EQ(log, (Log{"before 1", "reject", "after 1"}));
+  ASSERT_TRUE(responder.finished_with_error);
+  ASSERT_EQ(responder.status.error_code(),
+            grpc::StatusCode::PERMISSION_DENIED);
+}
+
+struct CountCalls {
+  struct State {
+    int value = 0;
+  };
+
+  int* calls;
+
+  template <typename Call>
+  void Before(Call&, State& state) {
+    state.value = ++*calls;
+  }
+
+  template <typename Call>
+  void After(Call&, State& state) noexcept {
+    ASSERT_EQ(state.value, *calls);
+  }
+};
+
+TEST(Middleware, KeepsStatePerCall) {
+  Log log;
+  int calls = 0;
+  middleware<CountCalls> chain{CountCalls{&calls}};
+  auto handler = chain.wrap(Echo{&log});
+
+  grpc::ServerContext server_context;
+  EchoRequest request;
+  EchoResponse response;
+  TestResponder responder;
+  unifex::sync_wait(handler(TestExecutor{}, server_context, request, response,
+                            responder));
+  unifex::sync_wait(handler(TestExecutor{}, server_context, request, response,
+                            responder));
+
+  ASSERT_EQ(calls, 2);
+}
+
+struct SeeException {
+  bool* saw_exception;
+
+  template <typename Call>
+  void After(Call& call) noexcept {
+    *saw_exception = call.exception() != nullptr;
+  }
+};
+
+TEST(Middleware, RethrowsAfterHooks) {
+  bool saw_exception = false;
+  middleware<SeeException> chain{SeeException{&saw_exception}};
+  auto handler = chain.wrap(
+      [](TestExecutor, grpc::ServerContext&, EchoRequest&, EchoResponse&,
+         TestResponder&) -> task<void> {
+        throw std::runtime_error("failed");
+        co_return;
+      });
+
+  grpc::ServerContext server_context;
+  EchoRequest request;
+  EchoResponse response;
+  TestResponder responder;
+  ASSERT_THROW(unifex::sync_wait(handler(TestExecutor{}, server_context,
+                                         request, response, responder)),
+               std::runtime_error);
+  ASSERT_TRUE(saw_exception);
+}
+
+struct Throw {
+  Log* log;
+
+  template <typename Call>
+  void Before(Call&) {
+    log->push_back("throw");
+    throw std::runtime_error("failed");
+  }
+
+  template <typename Call>
+  void After(Call&) noexcept {
+    log->push_back("after throw");
+  }
+};
+
+TEST(Middleware, UnwindsEnteredMiddlewaresWhenBeforeThrows) {
+  Log log;
+  bool saw_exception = false;
+  middleware<SeeException, Record<1>, Throw, Record<2>> chain{
+      SeeException{&saw_exception}, Record<1>{&log}, Throw{&log},
+      Record<2>{&log}};
+  auto handler = chain.wrap(Echo{&log});
+
+  grpc::ServerContext server_context;
+  EchoRequest request;
+  EchoResponse response;
+  TestResponder responder;
+  ASSERT_THROW(unifex::sync_wait(handler(TestExecutor{}, server_context,
+                                         request, response, responder)),
+               std::runtime_error);
+  ASSERT_EQ(log, (Log{"before 1", "throw", "after 1"}));
+  ASSERT_TRUE(saw_exception);
+  ASSERT_FALSE(responder.finished_with_error);
+}
+
+}  // namespace
+}  // namespace agrpc
@@ -0,0 +1,153 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/offload_pool.h"
+
+#include "agrpc/base/logging.h"
+#include "agrpc/base/thread.h"
+
+namespace agrpc {
+
+namespace {
+
+struct CurrentWorker {
+  OffloadPool* pool = nullptr;
+  std::size_t index = 0;
+};
+
+thread_local CurrentWorker current_worker;
+
+}  // namespace
+
+OffloadPool::OffloadPool(std::size_t threads) {
+  if (threads == 0) {
+    threads = GetNumberOfProcessorsAvailable();
+  }
+  workers_.reserve(threads);
+  for (std::size_t i = 0; i < threads; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  threads_.reserve(threads);
+  for (std::size_t i = 0; i < threads; ++i) {
+    threads_.emplace_back([this, i] { WorkerMain(i); });
+  }
+}
+
+OffloadPool::~OffloadPool() {
+  {
+    std::lock_guard lock{sleep_mutex_};
+    stopping_ = true;
+  }
+  wakeup_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void OffloadPool::Submit(Task* task) {
+  AGRPC_CHECK(task != nullptr);
+  std::size_t index;
+  if (current_worker.pool == this) {
+    index = current_worker.index;
+  } else {
+    index = next_worker_.fetch_add(1, std::memory_order_relaxed) %
+            workers_.size();
+  }
+  // Counted before it is pushed so that the count never drops below zero.
+  // Pairs with `WaitForWork`: either the sleeper sees the task, or we see the
+  // sleeper.
+  queued_.fetch_add(1, std::memory_order_seq_cst);
+  auto& worker = *workers_[index];
+  {
+    std::lock_guard lock{worker.mutex};
+    worker.tasks.push_back(task);
+  }
+  if (sleepers_.load(std::memory_order_seq_cst) != 0) {
+    std::lock_guard lock{sleep_mutex_};
+    wakeup_.notify_one();
+  }
+}
+
+OffloadPoolStats OffloadPool::get_stats() const noexcept {
+  OffloadPoolStats stats;
+  for (auto& worker : workers_) {
+    stats.tasks_run += worker->tasks_run.Read();
+    stats.tasks_stolen += worker->tasks_stolen.Read();
+  }
+  return stats;
+}
+
+void OffloadPool::WorkerMain(std::size_t index) {
+  current_worker = {this, index};
+  auto& worker = *workers_[index];
+  while (true) {
+    auto* task = PopTask(index);
+    if (!task) {
+      task = StealTask(index);
+    }
+    if (!task) {
+      if (!WaitForWork()) {
+        break;
+      }
+      continue;
+    }
+    // Without a context the task may be gone once it ran.
+    auto* context = task->context_;
+    auto* continuation = task->continuation_;
+    task->execute_(task);
+    worker.tasks_run.Add();
+    if (context) {
+      // Handed over before the next task runs, which might take a while.
+      detail::GrpcContextAccess::Schedule(*context, continuation);
+    }
+  }
+}
+
+OffloadPool::Task* OffloadPool::PopTask(std::size_t index) noexcept {
+  auto& worker = *workers_[index];
+  std::lock_guard lock{worker.mutex};
+  if (worker.tasks.empty()) {
+    return nullptr;
+  }
+  queued_.fetch_sub(1, std::memory_order_relaxed);
+  return worker.tasks.pop_front();
+}
+
+OffloadPool::Task* OffloadPool::StealTask(std::size_t thief) noexcept {
+  if (queued_.load(std::memory_order_relaxed) == 0) {
+    return nullptr;
+  }
+  for (std::size_t i = 1; i < workers_.size(); ++i) {
+    auto& victim = *workers_[(thief + i) % workers_.size()];
+    std::lock_guard lock{victim.mutex};
+    if (!victim.tasks.empty()) {
+      queued_.fetch_sub(1, std::memory_order_relaxed);
+      workers_[thief]->tasks_stolen.Add();
+      return victim.tasks.pop_front();
+    }
+  }
+  return nullptr;
+}
+
+bool OffloadPool::WaitForWork() {
+  std::unique_lock lock{sleep_mutex_};
+  sleepers_.fetch_add(1, std::memory_order_seq_cst);
+  while (queued_.load(std::memory_order_seq_cst) == 0 && !stopping_) {
+    wakeup_.wait(lock);
+  }
+  sleepers_.fetch_sub(1, std::memory_order_relaxed);
+  return queued_.load(std::memory_order_relaxed) != 0 || !stopping_;
+}
+
+}  // namespace agrpc
@@ -0,0 +1,260 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_CONTEXT_OFFLOAD_POOL_H_
+#define AGRPC_CONTEXT_OFFLOAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <unifex/detail/intrusive_queue.hpp>
+#include <unifex/get_stop_token.hpp>
+#include <unifex/receiver_concepts.hpp>
+#include <unifex/stop_token_concepts.hpp>
+#include <unifex/type_traits.hpp>
+
+#include "agrpc/base/align.h"
+#include "agrpc/base/counter.h"
+#include "agrpc/context/grpc_context.h"
+
+namespace agrpc {
+
+struct OffloadPoolStats {
+  std::uint64_t tasks_run = 0;
+  // Tasks taken from another worker's queue.
+  std::uint64_t tasks_stolen = 0;
+};
+
+// Threads for CPU-heavy work that should not run on a `GrpcContext`'s run
+// loop, see `offload`.
+//
+// Each worker has its own task queue. Tasks submitted from outside are spread
+// over the workers round-robin, tasks submitted from a worker stay on it, and
+// idle workers steal from the others. Tasks that came from a `GrpcContext` are
+// resumed on it as soon as they finished, before the worker runs its next
+// task.
+class OffloadPool {
+ public:
+  struct Task {
+    Task* next_;
+    void (*execute_)(Task*) noexcept;
+    // If set, `continuation_` is run on `context_` once `execute_` returned.
+    // Otherwise `execute_` completes the task by itself.
+    GrpcContext* context_ = nullptr;
+    detail::GrpcContextAccess::OperationBase* continuation_ = nullptr;
+  };
+
+  // Starts `threads` workers, by default one per available CPU.
+  explicit OffloadPool(std::size_t threads = 0);
+
+  OffloadPool(const OffloadPool&) = delete;
+  OffloadPool& operator=(const OffloadPool&) = delete;
+
+  // Runs the tasks that are still queued and joins the workers.
+  ~OffloadPool();
+
+  std::size_t size() const noexcept { return workers_.size(); }
+
+  // Queues `task`. Thread-safe.
+  void Submit(Task* task);
+
+  // Snapshot of the worker counters. Safe to call from any thread.
+  OffloadPoolStats get_stats() const noexcept;
+
+ private:
+  using TaskQueue = unifex::intrusive_queue<Task, &Task::next_>;
+
+  struct alignas(hardware_destructive_interference_size) Worker {
+    std::mutex mutex;
+    TaskQueue tasks;
+    SingleWriterCounter tasks_run;
+    SingleWriterCounter tasks_stolen;
+  };
+
+  void WorkerMain(std::size_t index);
+  Task* PopTask(std::size_t index) noexcept;
+  Task* StealTask(std::size_t thief) noexcept;
+  // Blocks until there might be work. Returns false once the pool is stopping
+  // and all work is done.
+  bool WaitForWork();
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::thread> threads_;
+  std::atomic<std::size_t> next_worker_{0};
+
+  // Tasks queued and not yet taken by a worker.
+  alignas(hardware_destructive_interference_size)
+      std::atomic<std::size_t> queued_{0};
+  std::atomic<std::size_t> sleepers_{0};
+  std::mutex sleep_mutex_;
+  std::condition_variable wakeup_;
+  bool stopping_ = false;
+};
+
+namespace detail {
+
+template <typename F, typename Receiver>
+class OffloadOperation : private OffloadPool::Task {
+  using Result = std::invoke_result_t<F>;
+  using OperationBase = GrpcContextAccess::OperationBase;
+
+ public:
+  template <typename F2, typename Receiver2>
+  explicit OffloadOperation(OffloadPool& pool, F2&& fn, Receiver2&& r)
+      : pool_(pool), fn_((F2 &&) fn), receiver_((Receiver2 &&) r) {}
+
+  void start() noexcept {
+    this->execute_ = &OffloadOperation::Run;
+    this->context_ = GrpcContextAccess::GetCurrent();
+    if (this->context_) {
+      resume_op_.execute_ = &OffloadOperation::Resume;
+      resume_op_.self = this;
+      this->continuation_ = &resume_op_;
+    }
+    pool_.Submit(this);
+  }
+
+ private:
+  struct ResumeOperation : OperationBase {
+    OffloadOperation* self;
+  };
+
+  // On a pool thread.
+  static void Run(OffloadPool::Task* task) noexcept {
+    auto& self = *static_cast<OffloadOperation*>(task);
+    if constexpr (!unifex::is_stop_never_possible_v<
+                      unifex::stop_token_type_t<Receiver>>) {
+      self.stopped_ =
+          unifex::get_stop_token(self.receiver_).stop_requested();
+    }
+    if (!self.stopped_) {
+      UNIFEX_TRY {
+        if constexpr (std::is_void_v<Result>) {
+          std::invoke(std::move(self.fn_));
+        } else {
+          self.result_.emplace(std::invoke(std::move(self.fn_)));
+        }
+      }
+      UNIFEX_CATCH(...) { self.exception_ = std::current_exception(); }
+    }
+    if (!self.context_) {
+      self.Complete();
+    }
+  }
+
+  // On the originating context.
+  static void Resume(OperationBase* op) noexcept {
+    static_cast<ResumeOperation*>(op)->self->Complete();
+  }
+
+  void Complete() noexcept {
+    if (exception_) {
+      unifex::set_error(std::move(receiver_), std::move(exception_));
+    } else if (stopped_) {
+      unifex::set_done(std::move(receiver_));
+    } else if constexpr (std::is_void_v<Result>) {
+      SetValue();
+    } else {
+      SetValue(std::move(*result_));
+    }
+  }
+
+  template <typename... Values>
+  void SetValue(Values&&... values) noexcept {
+    if constexpr (noexcept(unifex::set_value(std::move(receiver_),
+                                             (Values &&) values...))) {
+      unifex::set_value(std::move(receiver_), (Values &&) values...);
+    } else {
+      UNIFEX_TRY {
+        unifex::set_value(std::move(receiver_), (Values &&) values...);
+      }
+      UNIFEX_CATCH(...) {
+        unifex::set_error(std::move(receiver_), std::current_exception());
+      }
+    }
+  }
+
+  struct Empty {};
+
+  OffloadPool& pool_;
+  F fn_;
+  Receiver receiver_;
+  ResumeOperation resume_op_;
+  bool stopped_ = false;
+  std::exception_ptr exception_;
+  std::optional<std::conditional_t<std::is_void_v<Result>, Empty, Result>>
+      result_;
+};
+
+template <typename F>
+class OffloadSender {
+  using Result = std::invoke_result_t<F>;
+
+ public:
+  template <template <typename...> class Variant,
+            template <typename...> class Tuple>
+  using value_types =
+      Variant<std::conditional_t<std::is_void_v<Result>, Tuple<>,
+                                 Tuple<Result>>>;
+
+  template <template <typename...> class Variant>
+  using error_types = Variant<std::exception_ptr>;
+
+  static constexpr bool sends_done = true;
+
+  template <typename F2>
+  explicit OffloadSender(OffloadPool& pool, F2&& fn)
+      : pool_(pool), fn_((F2 &&) fn) {}
+
+  template <typename Receiver>
+  OffloadOperation<F, unifex::remove_cvref_t<Receiver>> connect(
+      Receiver&& r) && {
+    return OffloadOperation<F, unifex::remove_cvref_t<Receiver>>{
+        pool_, std::move(fn_), (Receiver &&) r};
+  }
+
+ private:
+  OffloadPool& pool_;
+  F fn_;
+};
+
+}  // namespace detail
+
+// Runs `fn` on `pool` and completes with its result. When started on a
+// `GrpcContext`'s run loop, it completes there again; otherwise it completes
+// on the pool thread. Completes with done, without running `fn`, if stop was
+// requested before a worker got to it.
+//
+//   auto reply =
+//       co_await agrpc::offload(pool, [&] { return Transform(request); });
+template <typename F>
+detail::OffloadSender<unifex::remove_cvref_t<F>> offload(OffloadPool& pool,
+                                                         F&& fn) {
+  return detail::OffloadSender<unifex::remove_cvref_t<F>>{pool, (F &&) fn};
+}
+
+}  // namespace agrpc
+
+#endif  // AGRPC_CONTEXT_OFFLOAD_POOL_H_
@@ -0,0 +1,223 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/offload_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <unifex/async_scope.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/then.hpp>
+
+#include "gtest/gtest.h"
+
+#include "agrpc/testing/grpc_context_helpers.h"
+
+namespace agrpc {
+namespace {
+
+using testing::RunOnContext;
+using testing::RunUntil;
+using testing::ShutDownAndDrain;
+
+struct CountingTask : OffloadPool::Task {
+  explicit CountingTask(std::atomic<int>& counter) : counter(counter) {
+    execute_ = [](OffloadPool::Task* task) noexcept {
+      static_cast<CountingTask*>(task)->counter.fetch_add(1);
+    };
+  }
+  std::atomic<int>& counter;
+};
+
+// Receives the result of `offload` into a promise.
+template <typename T>
+struct PromiseReceiver {
+  std::promise<T>* promise;
+
+  template <typename... Values>
+  void set_value(Values&&... values) && noexcept {
+    promise->set_value((Values &&) values...);
+  }
+  void set_error(std::exception_ptr error) && noexcept {
+    promise->set_exception(error);
+  }
+  void set_done() && noexcept {
+    promise->set_exception(
+        std::make_exception_ptr(std::runtime_error("done")));
+  }
+};
+
+TEST(OffloadPool, RunsAllTasks) {
+  constexpr int kTasks = 10000;
+  std::atomic<int> counter{0};
+  std::vector<CountingTask> tasks(kTasks, CountingTask{counter});
+  {
+    OffloadPool pool{4};
+    ASSERT_EQ(pool.size(), 4);
+    for (auto& task : tasks) {
+      pool.Submit(&task);
+    }
+  }
+  ASSERT_EQ(counter.load(), kTasks);
+}
+
+TEST(OffloadPool, IdleWorkersSteal) {
+  constexpr int kChildren = 64;
+  std::atomic<int> counter{0};
+  std::vector<CountingTask> children(kChildren, CountingTask{counter});
+  for (auto& child : children) {
+    child.execute_ = [](OffloadPool::Task* task) noexcept {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      static_cast<CountingTask*>(task)->counter.fetch_add(1);
+    };
+  }
+
+  // All children are submitted from one worker, so they land on its queue.
+  struct ParentTask : OffloadPool::Task {
+    OffloadPool* pool;
+    std::vector<CountingTask>* children;
+  } parent;
+  parent.execute_ = [](OffloadPool::Task* task) noexcept {
+    auto& self = *static_cast<ParentTask*>(task);
+    for (auto& child : *self.children) {
+      self.pool->Submit(&child);
+    }
+  };
+
+  OffloadPool pool{4};
+  parent.pool = &pool;
+  parent.children = &children;
+  pool.Submit(&parent);
+  // The counters are bumped after the task ran.
+  while (pool.get_stats().tasks_run != kChildren + 1) {
+    std::this_thread::yield();
+  }
+  ASSERT_EQ(counter.load(), kChildren);
+  ASSERT_GT(pool.get_stats().tasks_stolen, 0);
+}
+
+TEST(OffloadPool, OffloadOutsideOfContext) {
+  OffloadPool pool{2};
+
+  std::promise<int> promise;
+  auto op = offload(pool, [] { return 42; })
+                .connect(PromiseReceiver<int>{&promise});
+  op.start();
+  ASSERT_EQ(promise.get_future().get(), 42);
+
+  std::promise<void> failed;
+  auto failing_op = offload(pool, [] { throw std::runtime_error("fail"); })
+                        .connect(PromiseReceiver<void>{&failed});
+  failing_op.start();
+  ASSERT_THROW(failed.get_future().get(), std::runtime_error);
+}
+
+TEST(OffloadPool, ResumesOnTheOriginatingContext) {
+  OffloadPool pool{2};
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  unifex::async_scope scope;
+  std::thread::id worker_thread;
+  std::thread::id resumed_thread;
+  bool resumed_on_context = false;
+  RunOnContext(context, [&] {
+    scope.spawn(unifex::then(
+        offload(pool, [] { return std::this_thread::get_id(); }),
+        [&](std::thread::id id) {
+          worker_thread = id;
+          resumed_thread = std::this_thread::get_id();
+          resumed_on_context =
+              detail::GrpcContextAccess::GetCurrent() == &context;
+        }));
+  });
+  RunUntil(context, [&] { return resumed_on_context; });
+  // The context is driven from this thread.
+  ASSERT_NE(worker_thread, std::this_thread::get_id());
+  ASSERT_EQ(resumed_thread, std::this_thread::get_id());
+  unifex::sync_wait(scope.cleanup());
+  ShutDownAndDrain(context);
+}
+
+TEST(OffloadPool, ResumesBeforeTheNextTaskEnds) {
+  OffloadPool pool{1};
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  unifex::async_scope scope;
+  std::atomic<bool> long_task_done{false};
+  bool long_task_done_at_resume = true;
+  bool short_resumed = false;
+  bool long_resumed = false;
+  RunOnContext(context, [&] {
+    // The single worker runs the long task right after the short one.
+    scope.spawn(unifex::then(offload(pool, [] {}), [&] {
+      long_task_done_at_resume = long_task_done.load();
+      short_resumed = true;
+    }));
+    scope.spawn(unifex::then(offload(pool,
+                                     [&] {
+                                       std::this_thread::sleep_for(
+                                           std::chrono::milliseconds(100));
+                                       long_task_done = true;
+                                     }),
+                             [&] { long_resumed = true; }));
+  });
+  RunUntil(context, [&] { return short_resumed && long_resumed; });
+  ASSERT_FALSE(long_task_done_at_resume);
+  unifex::sync_wait(scope.cleanup());
+  ShutDownAndDrain(context);
+}
+
+struct RecordingOperation : detail::GrpcContextAccess::OperationBase {
+  explicit RecordingOperation(int id, std::vector<int>& order)
+      : id(id), order(&order) {
+    execute_ = [](detail::GrpcContextAccess::OperationBase* op) noexcept {
+      auto& self = *static_cast<RecordingOperation*>(op);
+      self.order->push_back(self.id);
+    };
+  }
+  int id;
+  std::vector<int>* order;
+};
+
+TEST(OffloadPool, ScheduleRemoteQueueKeepsOrder) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  std::vector<int> order;
+  std::vector<RecordingOperation> ops;
+  ops.reserve(4);
+  for (int i = 0; i < 4; ++i) {
+    ops.emplace_back(i, order);
+  }
+  // From a foreign thread, both while the queue is inactive and while it
+  // already holds work.
+  std::thread producer{[&] {
+    detail::GrpcContextAccess::OperationQueue first;
+    first.push_back(&ops[0]);
+    first.push_back(&ops[1]);
+    detail::GrpcContextAccess::ScheduleRemote(context, std::move(first));
+    detail::GrpcContextAccess::OperationQueue second;
+    second.push_back(&ops[2]);
+    second.push_back(&ops[3]);
+    detail::GrpcContextAccess::ScheduleRemote(context, std::move(second));
+  }};
+  producer.join();
+  RunUntil(context, [&] { return order.size() == ops.size(); });
+  ASSERT_EQ(order, (std::vector<int>{0, 1, 2, 3}));
+  ShutDownAndDrain(context);
+}
+
+}  // namespace
+}  // namespace agrpc
@@ -15,6 +15,9 @@
 #ifndef AGRPC_CONTEXT_RPCS_H_
 #define AGRPC_CONTEXT_RPCS_H_
 
+#include <type_traits>
+
+#include <grpcpp/client_context.h>
 #include <grpcpp/completion_queue.h>
 #include <grpcpp/server_context.h>
 #include <unifex/type_traits.hpp>
@@ -25,6 +28,15 @@ using namespace unifex;
 
 namespace detail {
 
+// Base of the responders of backends other than `GrpcContext`, e.g.
+// `CallbackWriter`. The CPOs below forward any arguments for them to the
+// backend's `tag_invoke`.
+struct BackendResponder {};
+
+template <typename Responder>
+using EnableIfBackendResponder =
+    std::enable_if_t<std::is_base_of_v<BackendResponder, Responder>, int>;
+
 template <class RPC, class Request, class Responder>
 using ServerMultiArgRequest = void (RPC::*)(grpc::ServerContext*, Request*,
                                             Responder*, grpc::CompletionQueue*,
@@ -124,6 +136,18 @@ inline const struct AsyncReadCPO {
     return unifex::tag_invoke(*this, (Executor &&) executor, reader_writer,
                               request);
   }
+
+  // Responders of other backends.
+  template <typename Executor, typename Responder, typename... Args,
+            detail::EnableIfBackendResponder<Responder> = 0>
+  auto operator()(Executor&& executor, Responder& responder,
+                  Args&&... args) const
+      noexcept(is_nothrow_tag_invocable_v<AsyncReadCPO, Executor, Responder&,
+                                          Args...>)
+          -> tag_invoke_result_t<AsyncReadCPO, Executor, Responder&, Args...> {
+    return unifex::tag_invoke(*this, (Executor &&) executor, responder,
+                              (Args &&) args...);
+  }
 } AsyncRead{};
 
 inline const struct AsyncWriteCPO {
@@ -156,6 +180,18 @@ inline const struct AsyncWriteCPO {
     return unifex::tag_invoke(*this, (Executor &&) executor, reader_writer,
                               response);
   }
+
+  // Responders of other backends.
+  template <typename Executor, typename Responder, typename... Args,
+            detail::EnableIfBackendResponder<Responder> = 0>
+  auto operator()(Executor&& executor, Responder& responder,
+                  Args&&... args) const
+      noexcept(is_nothrow_tag_invocable_v<AsyncWriteCPO, Executor, Responder&,
+                                          Args...>)
+          -> tag_invoke_result_t<AsyncWriteCPO, Executor, Responder&, Args...> {
+    return unifex::tag_invoke(*this, (Executor &&) executor, responder,
+                              (Args &&) args...);
+  }
 } AsyncWrite{};
 
 inline const struct AsyncFinishCPO {
@@ -235,6 +271,37 @@ inline const struct AsyncFinishCPO {
     return unifex::tag_invoke(*this, (Executor &&) executor, reader, response,
                               status);
   }
+
+  // Client, cancelled through `client_context` on a stop request.
+  template <typename Executor, typename Response>
+  auto operator()(Executor&& executor, grpc::ClientContext& client_context,
+                  grpc::ClientAsyncResponseReader<Response>& reader,
+                  Response& response, grpc::Status& status) const
+      noexcept(
+          is_nothrow_tag_invocable_v<AsyncFinishCPO, Executor,
+                                     grpc::ClientContext&,
+                                     grpc::ClientAsyncResponseReader<Response>&,
+                                     Response&, grpc::Status&>)
+          -> tag_invoke_result_t<AsyncFinishCPO, Executor,
+                                 grpc::ClientContext&,
+                                 grpc::ClientAsyncResponseReader<Response>&,
+                                 Response&, grpc::Status&> {
+    return unifex::tag_invoke(*this, (Executor &&) executor, client_context,
+                              reader, response, status);
+  }
+
+  // Responders of other backends.
+  template <typename Executor, typename Responder, typename... Args,
+            detail::EnableIfBackendResponder<Responder> = 0>
+  auto operator()(Executor&& executor, Responder& responder,
+                  Args&&... args) const
+      noexcept(is_nothrow_tag_invocable_v<AsyncFinishCPO, Executor, Responder&,
+                                          Args...>)
+          -> tag_invoke_result_t<AsyncFinishCPO, Executor, Responder&,
+                                 Args...> {
+    return unifex::tag_invoke(*this, (Executor &&) executor, responder,
+                              (Args &&) args...);
+  }
 } AsyncFinish{};
 
 inline const struct AsyncWriteAndFinishCPO {
@@ -272,6 +339,19 @@ inline const struct AsyncWriteAndFinishCPO {
     return unifex::tag_invoke(*this, (Executor &&) executor, reader_writer,
                               response, options, status);
   }
+
+  // Responders of other backends.
+  template <typename Executor, typename Responder, typename... Args,
+            detail::EnableIfBackendResponder<Responder> = 0>
+  auto operator()(Executor&& executor, Responder& responder,
+                  Args&&... args) const
+      noexcept(is_nothrow_tag_invocable_v<AsyncWriteAndFinishCPO, Executor,
+                                          Responder&, Args...>)
+          -> tag_invoke_result_t<AsyncWriteAndFinishCPO, Executor, Responder&,
+                                 Args...> {
+    return unifex::tag_invoke(*this, (Executor &&) executor, responder,
+                              (Args &&) args...);
+  }
 } AsyncWriteAndFinish{};
 
 inline const struct AsyncFinishWithErrorCPO {
@@ -291,7 +371,7 @@ inline const struct AsyncFinishWithErrorCPO {
 
   template <typename Executor, typename Response>
   auto operator()(Executor&& executor,
-                  grpc::ServerAsyncResponseWriter<Response> writer,
+                  grpc::ServerAsyncResponseWriter<Response>& writer,
                   const grpc::Status& status) const
       noexcept(is_nothrow_tag_invocable_v<
                AsyncFinishWithErrorCPO, Executor,
@@ -301,16 +381,48 @@ inline const struct AsyncFinishWithErrorCPO {
                                  const grpc::Status&> {
     return unifex::tag_invoke(*this, (Executor &&) executor, writer, status);
   }
+
+  // Responders of other backends.
+  template <typename Executor, typename Responder, typename... Args,
+            detail::EnableIfBackendResponder<Responder> = 0>
+  auto operator()(Executor&& executor, Responder& responder,
+                  Args&&... args) const
+      noexcept(is_nothrow_tag_invocable_v<AsyncFinishWithErrorCPO, Executor,
+                                          Responder&, Args...>)
+          -> tag_invoke_result_t<AsyncFinishWithErrorCPO, Executor, Responder&,
+                                 Args...> {
+    return unifex::tag_invoke(*this, (Executor &&) executor, responder,
+                              (Args &&) args...);
+  }
 } AsyncFinishWithError{};
 
 inline const struct AsyncSendInitialMetadataCPO {
   template <typename Executor, typename Responder>
-  auto operator()(Executor&& executor, Responder& responder) const noexcept(
-      is_nothrow_tag_invocable_v<AsyncFinishWithErrorCPO, Executor, Responder&>)
-      -> tag_invoke_result_t<AsyncFinishWithErrorCPO, Executor, Responder&> {
+  auto operator()(Executor&& executor, Responder& responder) const
+      noexcept(is_nothrow_tag_invocable_v<AsyncSendInitialMetadataCPO,
+                                          Executor, Responder&>)
+          -> tag_invoke_result_t<AsyncSendInitialMetadataCPO, Executor,
+                                 Responder&> {
     return unifex::tag_invoke(*this, (Executor &&) executor, responder);
   }
-} AsyncSendInitialMetadata;
+} AsyncSendInitialMetadata{};
+
+// Completes once gRPC is done with the call, after which
+// `server_context.IsCancelled()` tells whether the client cancelled it or its
+// deadline passed. Must be started before the call is requested, and is never
+// completed if the request fails. It does not count as outstanding work of the
+// context, since it may never complete.
+inline const struct AsyncNotifyWhenDoneCPO {
+  template <typename Executor>
+  auto operator()(Executor&& executor,
+                  grpc::ServerContext& server_context) const
+      noexcept(is_nothrow_tag_invocable_v<AsyncNotifyWhenDoneCPO, Executor,
+                                          grpc::ServerContext&>)
+          -> tag_invoke_result_t<AsyncNotifyWhenDoneCPO, Executor,
+                                 grpc::ServerContext&> {
+    return unifex::tag_invoke(*this, (Executor &&) executor, server_context);
+  }
+} AsyncNotifyWhenDone{};
 
 }  // namespace agrpc
 
@@ -0,0 +1,356 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_CONTEXT_SERVE_H_
+#define AGRPC_CONTEXT_SERVE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include <grpcpp/server_context.h>
+
+#include <unifex/async_scope.hpp>
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/type_traits.hpp>
+
+#include "agrpc/base/logging.h"
+#include "agrpc/context/async_manual_reset_event.h"
+#include "agrpc/context/async_semaphore.h"
+#include "agrpc/context/drain_coordinator.h"
+#include "agrpc/context/grpc_context.h"
+#include "agrpc/context/rpcs.h"
+#include "agrpc/context/server_call_pool.h"
+#include "agrpc/context/task.h"
+
+namespace agrpc {
+
+struct ServeOptions {
+  // Number of `AsyncRequest`s kept posted, i.e. of calls that can be accepted
+  // at the same time.
+  std::size_t outstanding_requests = 1;
+
+  // Maximum number of handlers running at the same time. While it is reached,
+  // no requests are posted, so further calls queue up in gRPC.
+  std::size_t max_concurrency = std::numeric_limits<std::size_t>::max();
+
+  // If set, no requests are posted once it started draining, and calls are
+  // tracked so that it can cancel those that outlive the drain deadline.
+  DrainCoordinator* drain = nullptr;
+};
+
+namespace detail {
+
+class ServeState {
+ public:
+  // Must be constructed on the run loop of `scheduler`'s context.
+  ServeState(GrpcContext::Scheduler scheduler, const ServeOptions& options)
+      : scheduler_(scheduler),
+        context_(*GrpcContextAccess::GetCurrent()),
+        drain_(options.drain),
+        live_(options.outstanding_requests) {
+    AGRPC_CHECK_GT(options.outstanding_requests, 0);
+    if (options.max_concurrency != std::numeric_limits<std::size_t>::max()) {
+      AGRPC_CHECK_GE(options.max_concurrency, 1);
+      permits_.emplace(options.max_concurrency);
+    }
+  }
+
+  GrpcContext::Scheduler scheduler() const noexcept { return scheduler_; }
+  DrainCoordinator* drain() const noexcept { return drain_; }
+  unifex::async_scope& scope() noexcept { return scope_; }
+
+  // Whether no further requests may be posted: the drain started, or the
+  // context is shutting down and its completion queue must not get any.
+  bool stopping() const noexcept {
+    return context_.is_shutting_down() || (drain_ && drain_->draining());
+  }
+
+  // Waits for a handler slot if concurrency is bounded.
+  task<void> AcquireSlot() {
+    if (permits_) {
+      co_await permits_->Acquire();
+    }
+  }
+
+  void ReleaseSlot() noexcept {
+    if (permits_) {
+      permits_->Release();
+    }
+  }
+
+  // Acceptors and handlers are live until they call `OnExit`.
+  void OnHandlerStarted() noexcept {
+    live_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void OnExit() noexcept {
+    if (live_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      all_exited_.Set();
+    }
+  }
+
+  AsyncManualResetEvent::WaitSender WaitAllExited() noexcept {
+    return all_exited_.Wait();
+  }
+
+ private:
+  GrpcContext::Scheduler scheduler_;
+  GrpcContext& context_;
+  DrainCoordinator* drain_;
+  std::optional<AsyncSemaphore> permits_;
+  std::atomic<std::size_t> live_;
+  AsyncManualResetEvent all_exited_;
+  unifex::async_scope scope_;
+};
+
+template <typename Pool, typename RunHandler>
+task<void> RunServerCall(ServeState& state, Pool& pool,
+                         std::unique_ptr<typename Pool::Call> call,
+                         RunHandler& run_handler) {
+  {
+    std::optional<DrainCoordinator::Registration> registration;
+    if (state.drain()) {
+      registration.emplace(*state.drain(), call->server_context());
+    }
+    // Gives the acceptor the chance to post the next request first.
+    co_await unifex::schedule(state.scheduler());
+    try {
+      co_await run_handler(*call);
+    } catch (const std::exception& e) {
+      AGRPC_LOG_ERROR("Handler failed: {}", e.what());
+    } catch (...) {
+      AGRPC_LOG_ERROR("Handler failed with an unknown exception");
+    }
+  }
+  pool.Release(std::move(call));
+  state.ReleaseSlot();
+  state.OnExit();
+}
+
+template <typename Pool, typename RequestCall, typename RunHandler>
+task<void> AcceptServerCalls(ServeState& state, Pool& pool,
+                             RequestCall& request_call,
+                             RunHandler& run_handler) {
+  bool holds_slot = false;
+  try {
+    while (true) {
+      co_await state.AcquireSlot();
+      holds_slot = true;
+      // Waiting for the slot may have outlasted the server and the context.
+      if (state.stopping()) {
+        break;
+      }
+      auto call = pool.Acquire();
+      bool request_ok = co_await request_call(*call);
+      if (!request_ok) {
+        // The server or the completion queue is shutting down.
+        pool.Release(std::move(call));
+        break;
+      }
+      state.scope().spawn(
+          RunServerCall(state, pool, std::move(call), run_handler));
+      // The handler starts by scheduling onto this context, so it cannot exit
+      // before this coroutine suspends again.
+      state.OnHandlerStarted();
+      holds_slot = false;
+    }
+  } catch (const std::exception& e) {
+    AGRPC_LOG_ERROR("Accepting calls failed: {}", e.what());
+  } catch (...) {
+    AGRPC_LOG_ERROR("Accepting calls failed with an unknown exception");
+  }
+  if (holds_slot) {
+    state.ReleaseSlot();
+  }
+  state.OnExit();
+}
+
+template <typename Pool, typename RequestCall, typename RunHandler>
+task<void> Serve(GrpcContext::Scheduler scheduler, Pool& pool,
+                 ServeOptions options, RequestCall request_call,
+                 RunHandler run_handler) {
+  co_await unifex::schedule(scheduler);
+  ServeState state{scheduler, options};
+  for (std::size_t i = 0; i < options.outstanding_requests; ++i) {
+    state.scope().spawn(
+        AcceptServerCalls(state, pool, request_call, run_handler));
+  }
+  co_await state.WaitAllExited();
+  co_await state.scope().cleanup();
+}
+
+// Serves with a pool of its own.
+template <typename Pool, typename RequestCall, typename RunHandler>
+task<void> ServeWithOwnPool(GrpcContext::Scheduler scheduler,
+                            ServeOptions options, RequestCall request_call,
+                            RunHandler run_handler) {
+  Pool pool;
+  co_await Serve(scheduler, pool, options, std::move(request_call),
+                 std::move(run_handler));
+}
+
+// Calls `handler` with the response message of `call` if it takes one.
+template <typename Handler, typename Call>
+auto InvokeServeHandler(Handler& handler, Call& call) {
+  using Request = unifex::remove_cvref_t<decltype(call.request())>;
+  using Response = typename Call::Response;
+  using Responder = unifex::remove_cvref_t<decltype(call.responder())>;
+  if constexpr (std::is_invocable_v<Handler&, grpc::ServerContext&, Request&,
+                                    Response&, Responder&>) {
+    return handler(call.server_context(), call.request(), call.response(),
+                   call.responder());
+  } else {
+    return handler(call.server_context(), call.request(), call.responder());
+  }
+}
+
+template <typename Handler, typename Call>
+auto InvokeStreamingServeHandler(Handler& handler, Call& call) {
+  using Request = unifex::remove_cvref_t<decltype(call.request())>;
+  using Response = typename Call::Response;
+  using Responder = unifex::remove_cvref_t<decltype(call.responder())>;
+  if constexpr (std::is_invocable_v<Handler&, grpc::ServerContext&, Request&,
+                                    Response&, Responder&>) {
+    return handler(call.server_context(), call.request(), call.response(),
+                   call.responder());
+  } else {
+    return handler(call.server_context(), call.responder());
+  }
+}
+
+}  // namespace detail
+
+// Serves calls of one method on `scheduler`'s context. Keeps
+// `options.outstanding_requests` requests posted and re-posts each one as soon
+// as it completed. Every accepted call runs
+//
+//   co_await handler(server_context, request, responder);
+//
+// or, for handlers that take it, with the response message of the call too
+//
+//   co_await handler(server_context, request, response, responder);
+//
+// on the context, with at most `options.max_concurrency` handlers at a time:
+//
+//   co_await agrpc::serve(
+//       scheduler, &helloworld::Greeter::AsyncService::RequestSayHello,
+//       service,
+//       [&](grpc::ServerContext& server_context,
+//           helloworld::HelloRequest& request,
+//           grpc::ServerAsyncResponseWriter<helloworld::HelloReply>& writer)
+//           -> agrpc::task<void> {
+//         ...
+//         co_await agrpc::AsyncFinish(scheduler, writer, reply,
+//                                     grpc::Status::OK);
+//       },
+//       {.outstanding_requests = 16, .max_concurrency = 1024});
+//
+// The per-call state is taken from `pool` and given back once the handler
+// returned, so handlers must not keep references to it. Completes once the
+// server has been shut down and every handler returned. Exceptions escaping a
+// handler are logged and otherwise ignored. An acceptor that fails to post a
+// request logs the exception and stops, leaving the others running. See
+// `DrainCoordinator` for shutting down gracefully.
+template <typename RPC, typename Service, typename Request,
+          typename Responder, typename Handler>
+task<void> serve(
+    GrpcContext::Scheduler scheduler,
+    detail::ServerMultiArgRequest<RPC, Request, Responder> rpc,
+    Service& service, Handler handler,
+    ServerCallPool<Request, Responder>& pool, ServeOptions options = {}) {
+  using Call = ServerCall<Request, Responder>;
+  return detail::Serve(
+      scheduler, pool, options,
+      [scheduler, rpc, &service](Call& call) {
+        return AsyncRequest(scheduler, rpc, service, call.server_context(),
+                            call.request(), call.responder());
+      },
+      [handler = std::move(handler)](Call& call) mutable {
+        return detail::InvokeServeHandler(handler, call);
+      });
+}
+
+// Same as above with a pool of default options that only this `serve` uses.
+template <typename RPC, typename Service, typename Request,
+          typename Responder, typename Handler>
+task<void> serve(
+    GrpcContext::Scheduler scheduler,
+    detail::ServerMultiArgRequest<RPC, Request, Responder> rpc,
+    Service& service, Handler handler, ServeOptions options = {}) {
+  using Call = ServerCall<Request, Responder>;
+  return detail::ServeWithOwnPool<ServerCallPool<Request, Responder>>(
+      scheduler, options,
+      [scheduler, rpc, &service](Call& call) {
+        return AsyncRequest(scheduler, rpc, service, call.server_context(),
+                            call.request(), call.responder());
+      },
+      [handler = std::move(handler)](Call& call) mutable {
+        return detail::InvokeServeHandler(handler, call);
+      });
+}
+
+// Same as above for client-streaming and bidirectional methods, whose handlers
+// are called as `handler(server_context, responder)`, or as
+// `handler(server_context, request, response, responder)` with `request` a
+// pooled message to read into.
+template <typename RPC, typename Service, typename Responder,
+          typename Handler>
+task<void> serve(
+    GrpcContext::Scheduler scheduler,
+    detail::ServerSingleArgRequest<RPC, Responder> rpc, Service& service,
+    Handler handler,
+    ServerCallPool<typename detail::ServerResponderTraits<Responder>::Read,
+                   Responder>& pool,
+    ServeOptions options = {}) {
+  using Call = typename unifex::remove_cvref_t<decltype(pool)>::Call;
+  return detail::Serve(
+      scheduler, pool, options,
+      [scheduler, rpc, &service](Call& call) {
+        return AsyncRequest(scheduler, rpc, service, call.server_context(),
+                            call.responder());
+      },
+      [handler = std::move(handler)](Call& call) mutable {
+        return detail::InvokeStreamingServeHandler(handler, call);
+      });
+}
+
+template <typename RPC, typename Service, typename Responder,
+          typename Handler>
+task<void> serve(GrpcContext::Scheduler scheduler,
+                 detail::ServerSingleArgRequest<RPC, Responder> rpc,
+                 Service& service, Handler handler,
+                 ServeOptions options = {}) {
+  using Pool = ServerCallPool<
+      typename detail::ServerResponderTraits<Responder>::Read, Responder>;
+  using Call = typename Pool::Call;
+  return detail::ServeWithOwnPool<Pool>(
+      scheduler, options,
+      [scheduler, rpc, &service](Call& call) {
+        return AsyncRequest(scheduler, rpc, service, call.server_context(),
+                            call.responder());
+      },
+      [handler = std::move(handler)](Call& call) mutable {
+        return detail::InvokeStreamingServeHandler(handler, call);
+      });
+}
+
+}  // namespace agrpc
+
+#endif  // AGRPC_CONTEXT_SERVE_H_
@@ -0,0 +1,248 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/serve.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+#include <grpcpp/alarm.h>
+#include <grpcpp/create_channel.h>
+#include <grpcpp/security/credentials.h>
+#include <grpcpp/security/server_credentials.h>
+#include <grpcpp/server_builder.h>
+#include <unifex/async_scope.hpp>
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/then.hpp>
+
+#include "gtest/gtest.h"
+
+#include "agrpc/context/async_manual_reset_event.h"
+#include "agrpc/context/grpc_context_pool.h"
+#include "agrpc/testing/echo_server_fixture.h"
+#include "agrpc/testing/grpc_context_helpers.h"
+
+namespace agrpc {
+namespace {
+
+using testing::EchoRequest;
+using testing::EchoResponse;
+using testing::EchoService;
+
+void WaitFor(const std::atomic<int>& value, int expected) {
+  while (value.load() != expected) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+// Handlers wait for `release_` before they answer, so tests can look at the
+// calls that are being handled at the same time.
+class ServeTest : public testing::EchoServerFixture {
+ protected:
+  ~ServeTest() override {
+    release_.Set();
+    ShutDownServer();
+    JoinCalls();
+  }
+
+  void Serve(ServeOptions options) {
+    scope_.spawn(unifex::then(
+        serve(scheduler(), &EchoService::AsyncService::RequestEcho, service_,
+              [this](grpc::ServerContext&, EchoRequest& request,
+                     grpc::ServerAsyncResponseWriter<EchoResponse>& writer)
+                  -> task<void> {
+                int active = ++active_;
+                int max = max_active_.load();
+                while (active > max &&
+                       !max_active_.compare_exchange_weak(max, active)) {
+                }
+                ++entered_;
+                co_await release_.Wait();
+                --active_;
+                if (answer_) {
+                  EchoResponse response;
+                  response.set_message(request.message());
+                  co_await AsyncFinish(scheduler(), writer, response,
+                                       grpc::Status::OK);
+                }
+              },
+              options),
+        [this] { served_ = true; }));
+  }
+
+  // Makes `n` calls, each from a thread of its own.
+  void StartCalls(int n) {
+    for (int i = 0; i < n; ++i) {
+      clients_.emplace_back([this] {
+        grpc::ClientContext client_context;
+        EchoRequest request;
+        request.set_message("hello");
+        EchoResponse response;
+        if (stub_->Echo(&client_context, request, &response).ok()) {
+          ++succeeded_;
+        }
+      });
+    }
+  }
+
+  void JoinCalls() {
+    for (auto& client : clients_) {
+      client.join();
+    }
+    clients_.clear();
+  }
+
+  bool answer_ = true;
+  std::atomic<int> active_{0};
+  std::atomic<int> max_active_{0};
+  std::atomic<int> entered_{0};
+  std::atomic<int> succeeded_{0};
+  std::atomic<bool> served_{false};
+  AsyncManualResetEvent release_;
+  std::vector<std::thread> clients_;
+};
+
+TEST_F(ServeTest, BoundsConcurrentHandlers) {
+  constexpr int kCalls = 6;
+  Serve({.outstanding_requests = 4, .max_concurrency = 2});
+  StartCalls(kCalls);
+
+  WaitFor(entered_, 2);
+  // The other calls stay queued while both slots are taken.
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  ASSERT_EQ(entered_.load(), 2);
+
+  release_.Set();
+  JoinCalls();
+  ASSERT_EQ(succeeded_.load(), kCalls);
+  ASSERT_EQ(entered_.load(), kCalls);
+  ASSERT_EQ(max_active_.load(), 2);
+}
+
+TEST_F(ServeTest, ShutDownWhileSaturated) {
+  // Keeps the completion queue from draining until serve has returned, so that
+  // the handler can still be resumed after the context was shut down.
+  grpc::Alarm keep_alive;
+  scope_.spawn(testing::AsyncAlarm(
+      scheduler(), keep_alive,
+      std::chrono::system_clock::now() + std::chrono::hours(1)));
+  // The completion queue is shut down before the handler returns, so it must
+  // not start any further operation.
+  answer_ = false;
+  Serve({.outstanding_requests = 1, .max_concurrency = 1});
+  StartCalls(2);
+  WaitFor(entered_, 1);
+
+  // The acceptor now waits for the slot of the running handler. Shutting the
+  // server down cancels the calls and waits for the handler to let go of it.
+  std::thread server_shutdown{
+      [this] { server_->Shutdown(std::chrono::system_clock::now()); }};
+  // Resumes the handler from the run loop, since nothing can be queued on the
+  // context remotely once its completion queue is shut down.
+  scope_.spawn(unifex::then(unifex::schedule(scheduler()), [this] {
+    context().ShutDown();
+    release_.Set();
+  }));
+  while (!served_) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  server_shutdown.join();
+  keep_alive.Cancel();
+  JoinCalls();
+
+  ASSERT_EQ(entered_.load(), 1);
+  ASSERT_EQ(succeeded_.load(), 0);
+}
+
+TEST(Serve, RunsAnAcceptLoopPerContext) {
+  constexpr int kContexts = 2;
+  grpc::ServerBuilder builder;
+  int port = 0;
+  builder.AddListeningPort("127.0.0.1:0", grpc::InsecureServerCredentials(),
+                           &port);
+  EchoService::AsyncService service;
+  builder.RegisterService(&service);
+  GrpcContextPool pool{builder, kContexts};
+  auto server = builder.BuildAndStart();
+
+  std::mutex mutex;
+  std::set<GrpcContext*> handled_on;
+  std::atomic<int> entered{0};
+  AsyncManualResetEvent release;
+  unifex::async_scope scope;
+  for (int i = 0; i < kContexts; ++i) {
+    auto& context = pool.get_context(i);
+    auto scheduler = context.get_scheduler();
+    // With one handler per context at a time, two calls in flight must be
+    // handled on different contexts.
+    scope.spawn(serve(
+        scheduler, &EchoService::AsyncService::RequestEcho, service,
+        [&, context = &context, scheduler](
+            grpc::ServerContext&, EchoRequest& request,
+            grpc::ServerAsyncResponseWriter<EchoResponse>& writer)
+            -> task<void> {
+          EXPECT_EQ(detail::GrpcContextAccess::GetCurrent(), context);
+          {
+            std::lock_guard lock{mutex};
+            handled_on.insert(context);
+          }
+          ++entered;
+          co_await release.Wait();
+          EchoResponse response;
+          response.set_message(request.message());
+          co_await AsyncFinish(scheduler, writer, response, grpc::Status::OK);
+        },
+        {.max_concurrency = 1}));
+  }
+  pool.Start();
+
+  auto stub = EchoService::NewStub(
+      grpc::CreateChannel(fmt::format("127.0.0.1:{}", port),
+                          grpc::InsecureChannelCredentials()));
+  std::atomic<int> succeeded{0};
+  std::vector<std::thread> clients;
+  for (int i = 0; i < kContexts; ++i) {
+    clients.emplace_back([&] {
+      grpc::ClientContext client_context;
+      EchoRequest request;
+      EchoResponse response;
+      if (stub->Echo(&client_context, request, &response).ok()) {
+        ++succeeded;
+      }
+    });
+  }
+  WaitFor(entered, kContexts);
+  release.Set();
+  for (auto& client : clients) {
+    client.join();
+  }
+
+  ASSERT_EQ(succeeded.load(), kContexts);
+  ASSERT_EQ(static_cast<int>(handled_on.size()), kContexts);
+
+  server->Shutdown();
+  pool.ShutDown();
+  pool.Join();
+  unifex::sync_wait(scope.cleanup());
+}
+
+}  // namespace
+}  // namespace agrpc
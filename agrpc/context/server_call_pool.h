@@ -0,0 +1,248 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_CONTEXT_SERVER_CALL_POOL_H_
+#define AGRPC_CONTEXT_SERVER_CALL_POOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <grpcpp/server_context.h>
+#include <grpcpp/support/async_stream.h>
+#include <grpcpp/support/async_unary_call.h>
+
+#include "agrpc/base/counter.h"
+#include "agrpc/context/arena_pool.h"
+#include "agrpc/context/context_local.h"
+#include "agrpc/context/grpc_context.h"
+
+namespace agrpc {
+
+struct ServerCallPoolOptions {
+  // Call states built on each context when the pool is first used there.
+  std::size_t prewarm = 0;
+
+  // High-water mark of idle call states per context. States released while it
+  // is reached are freed instead.
+  std::size_t max_idle = 256;
+
+  // If set, the request and response message of every call are created on an
+  // arena leased from here for the duration of the call, instead of being
+  // recycled with the call state. Suits large nested messages, whose fields
+  // then come out of one block. Must outlive the pool.
+  ArenaPool* arenas = nullptr;
+};
+
+struct ServerCallPoolStats {
+  // Calls that reused an idle state.
+  std::uint64_t hits = 0;
+  // Calls that had to allocate a state because none was idle.
+  std::uint64_t misses = 0;
+  // States freed on release because the pool was at its high-water mark.
+  std::uint64_t discarded = 0;
+  // States idle in the pool right now.
+  std::uint64_t idle = 0;
+};
+
+namespace detail {
+
+// The message types a server responder writes and reads.
+template <typename Responder>
+struct ServerResponderTraits;
+
+template <typename W>
+struct ServerResponderTraits<grpc::ServerAsyncResponseWriter<W>> {
+  using Response = W;
+};
+
+template <typename W>
+struct ServerResponderTraits<grpc::ServerAsyncWriter<W>> {
+  using Response = W;
+};
+
+template <typename W, typename R>
+struct ServerResponderTraits<grpc::ServerAsyncReader<W, R>> {
+  using Response = W;
+  using Read = R;
+};
+
+template <typename W, typename R>
+struct ServerResponderTraits<grpc::ServerAsyncReaderWriter<W, R>> {
+  using Response = W;
+  using Read = R;
+};
+
+}  // namespace detail
+
+template <typename Request, typename Responder>
+class ServerCallPool;
+
+// Everything a server call of one method needs: the server context and
+// responder, a request message and a response message. Owned by a
+// `ServerCallPool` between calls. For client-streaming and bidirectional
+// methods `request()` is a buffer to read messages into.
+template <typename Request, typename Responder>
+class ServerCall {
+ public:
+  using Response = typename detail::ServerResponderTraits<Responder>::Response;
+
+  ServerCall() = default;
+
+  ServerCall(const ServerCall&) = delete;
+  ServerCall& operator=(const ServerCall&) = delete;
+
+  grpc::ServerContext& server_context() noexcept { return *server_context_; }
+  Request& request() noexcept { return *request_; }
+  Response& response() noexcept { return *response_; }
+  Responder& responder() noexcept { return *responder_; }
+
+ private:
+  friend ServerCallPool<Request, Responder>;
+
+  // gRPC does not support reusing a server context or responder, so those are
+  // rebuilt for every call. The messages are only cleared, which keeps the
+  // memory of their strings, repeated and sub-message fields.
+  void Begin(ArenaPool* arenas) {
+    if (arenas != nullptr) {
+      arena_ = arenas->Acquire();
+      request_ = arena_.Create<Request>();
+      response_ = arena_.Create<Response>();
+    }
+    server_context_.emplace();
+    responder_.emplace(&*server_context_);
+  }
+
+  void End() noexcept {
+    responder_.reset();
+    server_context_.reset();
+    if (arena_) {
+      arena_.Reset();
+      request_ = &own_request_;
+      response_ = &own_response_;
+    } else {
+      own_request_.Clear();
+      own_response_.Clear();
+    }
+  }
+
+  Request own_request_;
+  Response own_response_;
+  Request* request_ = &own_request_;
+  Response* response_ = &own_response_;
+  ArenaPool::Lease arena_;
+  std::optional<grpc::ServerContext> server_context_;
+  std::optional<Responder> responder_;
+};
+
+// Recycles the `ServerCall`s of one method, so that accepting a call does not
+// allocate once the pool is warm. Each context keeps its own free list, which
+// only its run loop thread touches:
+//
+//   agrpc::ServerCallPool<helloworld::HelloRequest,
+//                         grpc::ServerAsyncResponseWriter<HelloReply>>
+//       pool{{.prewarm = 64, .max_idle = 1024}};
+//   ...
+//   co_await agrpc::serve(scheduler, &Greeter::AsyncService::RequestSayHello,
+//                         service, handler, pool);
+//
+// Must outlive all calls taken from it.
+template <typename Request, typename Responder>
+class ServerCallPool {
+ public:
+  using Call = ServerCall<Request, Responder>;
+
+  explicit ServerCallPool(ServerCallPoolOptions options = {})
+      : options_(options),
+        free_lists_([options](GrpcContext&) { return FreeList(options); }) {}
+
+  ServerCallPool(const ServerCallPool&) = delete;
+  ServerCallPool& operator=(const ServerCallPool&) = delete;
+
+  // An idle call of the current context, or a new one if there is none. Must
+  // be called from a context's run loop.
+  std::unique_ptr<Call> Acquire() {
+    auto& free_list = free_lists_.get();
+    std::unique_ptr<Call> call;
+    if (!free_list.calls.empty()) {
+      call = std::move(free_list.calls.back());
+      free_list.calls.pop_back();
+      free_list.idle.store(free_list.calls.size(), std::memory_order_relaxed);
+      free_list.hits.Add();
+    } else {
+      call = std::make_unique<Call>();
+      free_list.misses.Add();
+    }
+    call->Begin(options_.arenas);
+    return call;
+  }
+
+  // Gives `call` back to the free list of the current context. Frees it if
+  // that list is full or if not called from a context's run loop.
+  void Release(std::unique_ptr<Call> call) noexcept {
+    call->End();
+    if (detail::GrpcContextAccess::GetCurrent() == nullptr) {
+      return;
+    }
+    auto& free_list = free_lists_.get();
+    if (free_list.calls.size() >= options_.max_idle) {
+      free_list.discarded.Add();
+      return;
+    }
+    free_list.calls.push_back(std::move(call));
+    free_list.idle.store(free_list.calls.size(), std::memory_order_relaxed);
+  }
+
+  // Snapshot of the counters summed over all contexts. Safe to call from any
+  // thread.
+  ServerCallPoolStats get_stats() const {
+    ServerCallPoolStats stats;
+    free_lists_.ForEach([&](GrpcContext&, const FreeList& free_list) {
+      stats.hits += free_list.hits.Read();
+      stats.misses += free_list.misses.Read();
+      stats.discarded += free_list.discarded.Read();
+      stats.idle += free_list.idle.load(std::memory_order_relaxed);
+    });
+    return stats;
+  }
+
+ private:
+  struct FreeList {
+    explicit FreeList(const ServerCallPoolOptions& options) {
+      std::size_t count = std::min(options.prewarm, options.max_idle);
+      calls.reserve(count);
+      for (std::size_t i = 0; i < count; ++i) {
+        calls.push_back(std::make_unique<Call>());
+      }
+      idle.store(calls.size(), std::memory_order_relaxed);
+    }
+
+    std::vector<std::unique_ptr<Call>> calls;
+    SingleWriterCounter hits;
+    SingleWriterCounter misses;
+    SingleWriterCounter discarded;
+    std::atomic<std::size_t> idle{0};
+  };
+
+  ServerCallPoolOptions options_;
+  ContextLocal<FreeList> free_lists_;
+};
+
+}  // namespace agrpc
+
+#endif  // AGRPC_CONTEXT_SERVER_CALL_POOL_H_
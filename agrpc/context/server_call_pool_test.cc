@@ -0,0 +1,136 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/server_call_pool.h"
+
+#include <memory>
+
+#include <grpcpp/support/async_unary_call.h>
+
+#include "gtest/gtest.h"
+
+#include "agrpc/testing/echo.pb.h"
+#include "agrpc/testing/grpc_context_helpers.h"
+
+namespace agrpc {
+namespace {
+
+using testing::RunOnContext;
+using testing::ShutDownAndDrain;
+
+using EchoCallPool =
+    ServerCallPool<testing::EchoRequest,
+                   grpc::ServerAsyncResponseWriter<testing::EchoResponse>>;
+
+TEST(ServerCallPool, ReusesReleasedCalls) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  EchoCallPool pool;
+
+  RunOnContext(context, [&] {
+    auto call = pool.Acquire();
+    auto* first = call.get();
+    call->request().set_message("hello");
+    call->response().set_message("world");
+    pool.Release(std::move(call));
+
+    call = pool.Acquire();
+    ASSERT_EQ(call.get(), first);
+    ASSERT_TRUE(call->request().message().empty());
+    ASSERT_TRUE(call->response().message().empty());
+    pool.Release(std::move(call));
+  });
+
+  auto stats = pool.get_stats();
+  ASSERT_EQ(stats.hits, 1);
+  ASSERT_EQ(stats.misses, 1);
+  ASSERT_EQ(stats.discarded, 0);
+  ASSERT_EQ(stats.idle, 1);
+
+  ShutDownAndDrain(context);
+}
+
+TEST(ServerCallPool, Prewarms) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  EchoCallPool pool{{.prewarm = 4}};
+
+  RunOnContext(context, [&] {
+    auto a = pool.Acquire();
+    auto b = pool.Acquire();
+    pool.Release(std::move(a));
+    pool.Release(std::move(b));
+  });
+
+  auto stats = pool.get_stats();
+  ASSERT_EQ(stats.hits, 2);
+  ASSERT_EQ(stats.misses, 0);
+  ASSERT_EQ(stats.idle, 4);
+
+  ShutDownAndDrain(context);
+}
+
+TEST(ServerCallPool, FreesCallsAboveHighWaterMark) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  EchoCallPool pool{{.max_idle = 1}};
+
+  RunOnContext(context, [&] {
+    auto a = pool.Acquire();
+    auto b = pool.Acquire();
+    pool.Release(std::move(a));
+    pool.Release(std::move(b));
+  });
+
+  auto stats = pool.get_stats();
+  ASSERT_EQ(stats.misses, 2);
+  ASSERT_EQ(stats.discarded, 1);
+  ASSERT_EQ(stats.idle, 1);
+
+  ShutDownAndDrain(context);
+}
+
+TEST(ServerCallPool, KeepsOneFreeListPerContext) {
+  GrpcContext a{std::make_unique<grpc::CompletionQueue>()};
+  GrpcContext b{std::make_unique<grpc::CompletionQueue>()};
+  EchoCallPool pool;
+
+  RunOnContext(a, [&] { pool.Release(pool.Acquire()); });
+  RunOnContext(b, [&] { pool.Release(pool.Acquire()); });
+
+  auto stats = pool.get_stats();
+  ASSERT_EQ(stats.hits, 0);
+  ASSERT_EQ(stats.misses, 2);
+  ASSERT_EQ(stats.idle, 2);
+
+  ShutDownAndDrain(a);
+  ShutDownAndDrain(b);
+}
+
+TEST(ServerCallPool, CreatesMessagesOnArenas) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+  ArenaPool arenas;
+  EchoCallPool pool{{.arenas = &arenas}};
+
+  RunOnContext(context, [&] {
+    auto call = pool.Acquire();
+    ASSERT_NE(call->request().GetArena(), nullptr);
+    ASSERT_EQ(call->request().GetArena(), call->response().GetArena());
+    pool.Release(std::move(call));
+  });
+
+  ASSERT_EQ(arenas.get_stats().misses, 1);
+
+  ShutDownAndDrain(context);
+}
+
+}  // namespace
+}  // namespace agrpc
@@ -0,0 +1,40 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/server_call_stop_source.h"
+
+namespace agrpc {
+
+ServerCallStopSource::ServerCallStopSource(GrpcContext& context,
+                                           grpc::ServerContext& server_context)
+    : context_(context), server_context_(server_context) {
+  this->execute_ = &ServerCallStopSource::OnDone;
+  // Only records the tag, gRPC queues it on the call's completion queue once
+  // the call ends.
+  server_context_.AsyncNotifyWhenDone(static_cast<OperationBase*>(this));
+}
+
+void ServerCallStopSource::OnDone(OperationBase* op) noexcept {
+  auto& self = *static_cast<ServerCallStopSource*>(op);
+  self.done_ = true;
+  if (self.server_context_.IsCancelled()) {
+    self.stop_source_.request_stop();
+  }
+  if (self.waiter_) {
+    detail::GrpcContextAccess::ScheduleLocal(self.context_,
+                                             std::exchange(self.waiter_, {}));
+  }
+}
+
+}  // namespace agrpc
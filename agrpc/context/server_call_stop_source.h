@@ -0,0 +1,150 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_CONTEXT_SERVER_CALL_STOP_SOURCE_H_
+#define AGRPC_CONTEXT_SERVER_CALL_STOP_SOURCE_H_
+
+#include <exception>
+#include <utility>
+
+#include <grpcpp/server_context.h>
+
+#include <unifex/inplace_stop_token.hpp>
+#include <unifex/receiver_concepts.hpp>
+#include <unifex/type_traits.hpp>
+
+#include "agrpc/context/grpc_context.h"
+
+namespace agrpc {
+
+// Requests stop when the client cancels a server call or its deadline passes,
+// so that a handler can hand `get_token()` to the work it starts on behalf of
+// the call:
+//
+//   grpc::ServerContext server_context;
+//   agrpc::ServerCallStopSource call_stop{grpc_context, server_context};
+//   if (!co_await agrpc::AsyncRequest(scheduler, ..., server_context, ...)) {
+//     co_return;
+//   }
+//   ... pass call_stop.get_token() downstream ...
+//   co_await agrpc::AsyncFinish(scheduler, writer, reply, status);
+//   co_await call_stop.WaitDone();
+//
+// Must be constructed before the call is requested, and must not be destroyed
+// while gRPC may still deliver the done notification: if the request
+// succeeded, await `WaitDone()` first.
+class ServerCallStopSource
+    : private detail::GrpcContextAccess::OperationBase {
+  using OperationBase = detail::GrpcContextAccess::OperationBase;
+
+ public:
+  class WaitDoneSender;
+
+  ServerCallStopSource(GrpcContext& context,
+                       grpc::ServerContext& server_context);
+
+  ServerCallStopSource(const ServerCallStopSource&) = delete;
+  ServerCallStopSource& operator=(const ServerCallStopSource&) = delete;
+
+  unifex::inplace_stop_token get_token() noexcept {
+    return stop_source_.get_token();
+  }
+
+  // Completes on the context once gRPC is done with the call.
+  WaitDoneSender WaitDone() noexcept;
+
+ private:
+  static void OnDone(OperationBase* op) noexcept;
+
+  GrpcContext& context_;
+  grpc::ServerContext& server_context_;
+  unifex::inplace_stop_source stop_source_;
+  // Only accessed on the run loop thread.
+  bool done_ = false;
+  OperationBase* waiter_ = nullptr;
+};
+
+class ServerCallStopSource::WaitDoneSender {
+  template <typename Receiver>
+  class Operation : private OperationBase {
+   public:
+    template <typename Receiver2>
+    explicit Operation(ServerCallStopSource& source, Receiver2&& r)
+        : source_(source), receiver_((Receiver2 &&) r) {}
+
+    void start() noexcept {
+      this->execute_ = &Operation::OnStart;
+      detail::GrpcContextAccess::Schedule(source_.context_,
+                                          static_cast<OperationBase*>(this));
+    }
+
+   private:
+    static void OnStart(OperationBase* op) noexcept {
+      auto& self = *static_cast<Operation*>(op);
+      if (self.source_.done_) {
+        self.Complete();
+        return;
+      }
+      self.execute_ = [](OperationBase* op) noexcept {
+        static_cast<Operation*>(op)->Complete();
+      };
+      self.source_.waiter_ = op;
+    }
+
+    void Complete() noexcept {
+      if constexpr (noexcept(unifex::set_value(std::move(receiver_)))) {
+        unifex::set_value(std::move(receiver_));
+      } else {
+        UNIFEX_TRY { unifex::set_value(std::move(receiver_)); }
+        UNIFEX_CATCH(...) {
+          unifex::set_error(std::move(receiver_), std::current_exception());
+        }
+      }
+    }
+
+    ServerCallStopSource& source_;
+    Receiver receiver_;
+  };
+
+ public:
+  template <template <typename...> class Variant,
+            template <typename...> class Tuple>
+  using value_types = Variant<Tuple<>>;
+
+  template <template <typename...> class Variant>
+  using error_types = Variant<std::exception_ptr>;
+
+  static constexpr bool sends_done = false;
+
+  explicit WaitDoneSender(ServerCallStopSource& source) noexcept
+      : source_(source) {}
+
+  template <typename Receiver>
+  Operation<unifex::remove_cvref_t<Receiver>> connect(Receiver&& r) const& {
+    return Operation<unifex::remove_cvref_t<Receiver>>{source_,
+                                                       (Receiver &&) r};
+  }
+
+ private:
+  ServerCallStopSource& source_;
+};
+
+inline ServerCallStopSource::WaitDoneSender
+ServerCallStopSource::WaitDone() noexcept {
+  return WaitDoneSender{*this};
+}
+
+}  // namespace agrpc
+
+#endif  // AGRPC_CONTEXT_SERVER_CALL_STOP_SOURCE_H_
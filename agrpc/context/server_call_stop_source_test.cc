@@ -0,0 +1,158 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/server_call_stop_source.h"
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <thread>
+
+#include <unifex/just.hpp>
+#include <unifex/let_done.hpp>
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/task.hpp>
+#include <unifex/with_query_value.hpp>
+
+#include "gtest/gtest.h"
+
+#include "agrpc/testing/echo_server_fixture.h"
+
+namespace agrpc {
+namespace {
+
+using testing::EchoRequest;
+using testing::EchoResponse;
+using testing::EchoService;
+
+class ServerCallStopSourceTest : public testing::EchoServerFixture {
+ protected:
+  // Accepts one call and holds it for `hold`, or until the stop source fires.
+  unifex::task<void> Handle(std::chrono::milliseconds hold) {
+    grpc::ServerContext server_context;
+    ServerCallStopSource call_stop{context(), server_context};
+    EchoRequest request;
+    grpc::ServerAsyncResponseWriter<EchoResponse> writer{&server_context};
+    if (!co_await AsyncRequest(scheduler(),
+                               &EchoService::AsyncService::RequestEcho,
+                               service_, server_context, request, writer)) {
+      co_return;
+    }
+    co_await unifex::let_done(
+        unifex::with_query_value(
+            unifex::schedule_after(scheduler(), hold),
+            unifex::get_stop_token, call_stop.get_token()),
+        [] { return unifex::just(); });
+    stopped_ = call_stop.get_token().stop_requested();
+    EchoResponse response;
+    response.set_message(request.message());
+    co_await AsyncFinish(scheduler(), writer, response, grpc::Status::OK);
+    co_await call_stop.WaitDone();
+    handled_ = true;
+  }
+
+  void WaitUntilHandled() {
+    while (!handled_) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  grpc::Status Call(grpc::ClientContext& client_context) {
+    EchoRequest request;
+    EchoResponse response;
+    grpc::Status status;
+    auto reader = stub_->AsyncEcho(&client_context, request,
+                                   context().get_completion_queue());
+    unifex::sync_wait(AsyncFinish(scheduler(), *reader, response, status));
+    return status;
+  }
+
+  std::atomic<bool> stopped_{false};
+  std::atomic<bool> handled_{false};
+};
+
+TEST_F(ServerCallStopSourceTest, NotStoppedWhenTheCallFinishes) {
+  scope_.spawn(Handle(std::chrono::milliseconds(0)));
+  grpc::ClientContext client_context;
+  ASSERT_TRUE(Call(client_context).ok());
+  WaitUntilHandled();
+  ASSERT_FALSE(stopped_);
+}
+
+TEST_F(ServerCallStopSourceTest, StoppedWhenTheClientCancels) {
+  scope_.spawn(Handle(std::chrono::seconds(30)));
+  grpc::ClientContext client_context;
+  std::thread canceller{[&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    client_context.TryCancel();
+  }};
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_EQ(Call(client_context).error_code(), grpc::StatusCode::CANCELLED);
+  canceller.join();
+  WaitUntilHandled();
+  ASSERT_TRUE(stopped_);
+  ASSERT_LT(std::chrono::steady_clock::now() - start,
+            std::chrono::seconds(10));
+}
+
+TEST_F(ServerCallStopSourceTest, StoppedWhenTheDeadlinePasses) {
+  scope_.spawn(Handle(std::chrono::seconds(30)));
+  grpc::ClientContext client_context;
+  client_context.set_deadline(std::chrono::system_clock::now() +
+                              std::chrono::milliseconds(50));
+  ASSERT_EQ(Call(client_context).error_code(),
+            grpc::StatusCode::DEADLINE_EXCEEDED);
+  WaitUntilHandled();
+  ASSERT_TRUE(stopped_);
+}
+
+struct NotifyReceiver {
+  std::atomic<bool>* notified;
+  void set_value(bool) && noexcept { *notified = true; }
+  template <typename Error>
+  void set_error(Error&&) && noexcept {
+    std::terminate();
+  }
+  void set_done() && noexcept {}
+};
+
+TEST_F(ServerCallStopSourceTest, NotifyWhenDoneOfFailedRequestIsNotWork) {
+  grpc::ServerContext server_context;
+  EchoRequest request;
+  grpc::ServerAsyncResponseWriter<EchoResponse> writer{&server_context};
+  std::atomic<bool> notified{false};
+  // Queued remotely ahead of the request, so it is started first.
+  auto notify =
+      unifex::connect(AsyncNotifyWhenDone(scheduler(), server_context),
+                      NotifyReceiver{&notified});
+  unifex::start(notify);
+
+  std::thread shutter{[&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ShutDownServer();
+  }};
+  auto request_ok = unifex::sync_wait(
+      AsyncRequest(scheduler(), &EchoService::AsyncService::RequestEcho,
+                   service_, server_context, request, writer));
+  shutter.join();
+
+  ASSERT_TRUE(request_ok.has_value());
+  ASSERT_FALSE(*request_ok);
+  ASSERT_FALSE(notified);
+  ASSERT_EQ(context().get_outstanding_work(), 0);
+}
+
+}  // namespace
+}  // namespace agrpc
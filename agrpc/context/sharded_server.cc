@@ -0,0 +1,117 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/sharded_server.h"
+
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <grpc/grpc.h>
+
+#include "agrpc/base/logging.h"
+#include "agrpc/base/thread.h"
+
+namespace agrpc {
+
+ShardedServer::ShardedServer(
+    std::string address, std::shared_ptr<grpc::ServerCredentials> credentials,
+    Options options)
+    : address_(std::move(address)),
+      credentials_(std::move(credentials)),
+      options_(options) {
+  if (options_.shards == 0) {
+    options_.shards = GetNumberOfProcessorsAvailable();
+  }
+}
+
+ShardedServer::~ShardedServer() {
+  if (!threads_.empty()) {
+    ShutDown();
+    Join();
+  }
+}
+
+void ShardedServer::Start(const ConfigureFunction& configure,
+                          ServeFunction serve) {
+  AGRPC_CHECK(shards_.empty(), "The server has already been started.");
+  shards_.resize(options_.shards);
+
+  // The first shard resolves a wildcard port, the others reuse it.
+  BuildShard(0, address_, configure);
+  auto host = address_.substr(0, address_.rfind(':'));
+  auto shard_address = fmt::format("{}:{}", host, selected_port_);
+  for (std::size_t i = 1; i < shards_.size(); ++i) {
+    BuildShard(i, shard_address, configure);
+  }
+
+  // Only CPUs in the affinity mask are eligible. They need not start at 0 or
+  // be contiguous, e.g. under taskset or a cpuset cgroup.
+  std::vector<std::size_t> cpus;
+  if (options_.pin_threads) {
+    cpus = GetAvailableProcessors();
+  }
+  threads_.reserve(shards_.size());
+  for (std::size_t i = 0; i < shards_.size(); ++i) {
+    std::optional<std::size_t> cpu;
+    if (!cpus.empty()) {
+      cpu = cpus[(options_.first_cpu + i) % cpus.size()];
+    }
+    threads_.emplace_back([this, i, cpu, serve] {
+      if (cpu) {
+        SetCurrentThreadAffinity(*cpu);
+      }
+      auto& context = *shards_[i].context;
+      serve(i, context);
+      context.Run(stop_source_.get_token());
+    });
+  }
+}
+
+void ShardedServer::BuildShard(std::size_t index, const std::string& address,
+                               const ConfigureFunction& configure) {
+  grpc::ServerBuilder builder;
+  builder.AddChannelArgument(GRPC_ARG_ALLOW_REUSEPORT, 1);
+  int port = 0;
+  builder.AddListeningPort(address, credentials_, &port);
+  configure(index, builder);
+
+  auto& shard = shards_[index];
+  shard.context = std::make_unique<GrpcContext>(builder.AddCompletionQueue(),
+                                                options_.context_options);
+  shard.server = builder.BuildAndStart();
+  AGRPC_CHECK(shard.server, "Failed to start shard #{} on {}.", index, address);
+  AGRPC_CHECK_NE(port, 0, "Failed to bind shard #{} to {}.", index, address);
+  if (index == 0) {
+    selected_port_ = port;
+  }
+}
+
+void ShardedServer::ShutDown() {
+  for (auto& shard : shards_) {
+    shard.server->Shutdown();
+  }
+  for (auto& shard : shards_) {
+    shard.context->ShutDown();
+  }
+}
+
+void ShardedServer::Join() {
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+}
+
+}  // namespace agrpc
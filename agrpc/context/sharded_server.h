@@ -0,0 +1,130 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_CONTEXT_SHARDED_SERVER_H_
+#define AGRPC_CONTEXT_SHARDED_SERVER_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <grpcpp/security/server_credentials.h>
+#include <grpcpp/server.h>
+#include <grpcpp/server_builder.h>
+
+#include <unifex/inplace_stop_token.hpp>
+
+#include "agrpc/context/grpc_context.h"
+
+namespace agrpc {
+
+// Shared-nothing server: one `grpc::Server` and one `GrpcContext` per shard,
+// each driven by its own (optionally pinned) thread. All shards listen on the
+// same address through `SO_REUSEPORT`, so the kernel spreads connections over
+// them and a call never leaves the thread that accepted it.
+//
+// Since a service instance can only be registered with one server, services
+// have to be instantiated per shard:
+//
+//   std::vector<helloworld::Greeter::AsyncService> services(shards);
+//   agrpc::ShardedServer server{address, grpc::InsecureServerCredentials(),
+//                               {.shards = shards}};
+//   server.Start(
+//       [&](std::size_t shard, grpc::ServerBuilder& builder) {
+//         builder.RegisterService(&services[shard]);
+//       },
+//       [&](std::size_t shard, agrpc::GrpcContext& context) {
+//         scopes[shard].spawn(Serve(context, services[shard]));
+//       });
+//   ...
+//   server.ShutDown();
+//   server.Join();
+class ShardedServer {
+ public:
+  struct Options {
+    // Defaults to the number of CPUs available to the process.
+    std::size_t shards = 0;
+    // Pin the thread of shard `i` to the `first_cpu + i`-th CPU (modulo
+    // their number) of the affinity mask the server is started with.
+    bool pin_threads = true;
+    std::size_t first_cpu = 0;
+    GrpcContextOptions context_options;
+  };
+
+  // Called once per shard before its server is built.
+  using ConfigureFunction =
+      std::function<void(std::size_t shard, grpc::ServerBuilder& builder)>;
+
+  // Called on the shard's thread right before its run loop is entered. It is
+  // expected to start (not to wait for) the work serving the shard.
+  using ServeFunction =
+      std::function<void(std::size_t shard, GrpcContext& context)>;
+
+  // If the port in `address` is 0, the first shard picks a port and the other
+  // shards bind to the same one.
+  ShardedServer(std::string address,
+                std::shared_ptr<grpc::ServerCredentials> credentials,
+                Options options);
+
+  ShardedServer(const ShardedServer&) = delete;
+  ShardedServer& operator=(const ShardedServer&) = delete;
+
+  ~ShardedServer();
+
+  // Builds and starts all servers and spawns the shard threads.
+  void Start(const ConfigureFunction& configure, ServeFunction serve);
+
+  // Shuts down every server, then every completion queue.
+  void ShutDown();
+
+  // Waits for all shard threads to exit.
+  void Join();
+
+  std::size_t size() const noexcept { return shards_.size(); }
+
+  int selected_port() const noexcept { return selected_port_; }
+
+  GrpcContext& get_context(std::size_t shard) noexcept {
+    return *shards_[shard].context;
+  }
+
+  grpc::Server& get_server(std::size_t shard) noexcept {
+    return *shards_[shard].server;
+  }
+
+ private:
+  struct Shard {
+    std::unique_ptr<grpc::Server> server;
+    std::unique_ptr<GrpcContext> context;
+  };
+
+  void BuildShard(std::size_t index, const std::string& address,
+                  const ConfigureFunction& configure);
+
+  std::string address_;
+  std::shared_ptr<grpc::ServerCredentials> credentials_;
+  Options options_;
+  int selected_port_{0};
+
+  std::vector<Shard> shards_;
+  std::vector<std::thread> threads_;
+  unifex::inplace_stop_source stop_source_;
+};
+
+}  // namespace agrpc
+
+#endif  // AGRPC_CONTEXT_SHARDED_SERVER_H_
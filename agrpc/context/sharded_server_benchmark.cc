@@ -0,0 +1,175 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/sharded_server.h"
+
+#include <memory>
+#include <vector>
+
+#include <grpcpp/create_channel.h>
+#include <grpcpp/security/credentials.h>
+#include <grpcpp/security/server_credentials.h>
+#include <grpcpp/support/channel_arguments.h>
+#include <unifex/async_scope.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/task.hpp>
+
+#include "benchmark/benchmark.h"
+
+#include "agrpc/base/thread.h"
+#include "agrpc/context/grpc_context_pool.h"
+#include "agrpc/testing/echo.grpc.pb.h"
+
+// Compares a single server whose calls are spread over one completion queue
+// per CPU (`GrpcContextPool`) with one server per CPU sharing the port through
+// `SO_REUSEPORT` (`ShardedServer`). Every benchmark thread is a client with its
+// own connection, so that the kernel can balance connections across shards.
+
+namespace agrpc {
+
+namespace {
+
+using testing::EchoRequest;
+using testing::EchoResponse;
+using testing::EchoService;
+
+// Number of `AsyncRequest`s kept outstanding per context.
+constexpr std::size_t kAcceptorsPerContext = 16;
+
+unifex::task<void> ServeEcho(GrpcContext& context,
+                             EchoService::AsyncService& service) {
+  while (true) {
+    grpc::ServerContext server_context;
+    EchoRequest request;
+    grpc::ServerAsyncResponseWriter<EchoResponse> writer{&server_context};
+    bool request_ok = co_await AsyncRequest(
+        context.get_scheduler(), &EchoService::AsyncService::RequestEcho,
+        service, server_context, request, writer);
+    if (!request_ok) {
+      co_return;
+    }
+    EchoResponse response;
+    response.set_message(request.message());
+    co_await AsyncFinish(context.get_scheduler(), writer, response,
+                         grpc::Status::OK);
+  }
+}
+
+class SharedMultiQueueServer {
+ public:
+  SharedMultiQueueServer() {
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort("127.0.0.1:0", grpc::InsecureServerCredentials(),
+                             &port_);
+    builder.RegisterService(&service_);
+    pool_ = std::make_unique<GrpcContextPool>(builder,
+                                              GetNumberOfProcessorsAvailable());
+    server_ = builder.BuildAndStart();
+    for (std::size_t i = 0; i < pool_->size(); ++i) {
+      for (std::size_t j = 0; j < kAcceptorsPerContext; ++j) {
+        scope_.spawn(ServeEcho(pool_->get_context(i), service_));
+      }
+    }
+    pool_->Start();
+  }
+
+  ~SharedMultiQueueServer() {
+    server_->Shutdown();
+    pool_->ShutDown();
+    pool_->Join();
+    unifex::sync_wait(scope_.cleanup());
+  }
+
+  int port() const noexcept { return port_; }
+
+ private:
+  int port_{0};
+  EchoService::AsyncService service_;
+  std::unique_ptr<GrpcContextPool> pool_;
+  std::unique_ptr<grpc::Server> server_;
+  unifex::async_scope scope_;
+};
+
+class ShardPerCoreServer {
+ public:
+  ShardPerCoreServer()
+      : server_("127.0.0.1:0", grpc::InsecureServerCredentials(), {}) {
+    for (std::size_t i = 0; i < GetNumberOfProcessorsAvailable(); ++i) {
+      services_.push_back(std::make_unique<EchoService::AsyncService>());
+    }
+    server_.Start(
+        [this](std::size_t shard, grpc::ServerBuilder& builder) {
+          builder.RegisterService(services_[shard].get());
+        },
+        [this](std::size_t shard, GrpcContext& context) {
+          for (std::size_t j = 0; j < kAcceptorsPerContext; ++j) {
+            scope_.spawn(ServeEcho(context, *services_[shard]));
+          }
+        });
+  }
+
+  ~ShardPerCoreServer() {
+    server_.ShutDown();
+    server_.Join();
+    unifex::sync_wait(scope_.cleanup());
+  }
+
+  int port() const noexcept { return server_.selected_port(); }
+
+ private:
+  std::vector<std::unique_ptr<EchoService::AsyncService>> services_;
+  ShardedServer server_;
+  unifex::async_scope scope_;
+};
+
+template <typename Server>
+void RunEchoClient(benchmark::State& state) {
+  static Server server;
+
+  // Keep each client thread on its own connection.
+  grpc::ChannelArguments args;
+  args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+  auto stub = EchoService::NewStub(grpc::CreateCustomChannel(
+      fmt::format("127.0.0.1:{}", server.port()),
+      grpc::InsecureChannelCredentials(), args));
+
+  EchoRequest request;
+  request.set_message("hello");
+  while (state.KeepRunning()) {
+    grpc::ClientContext client_context;
+    EchoResponse response;
+    auto status = stub->Echo(&client_context, request, &response);
+    if (!status.ok()) {
+      state.SkipWithError(status.error_message().c_str());
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+}  // namespace
+
+void Benchmark_SharedMultiQueue(benchmark::State& state) {
+  RunEchoClient<SharedMultiQueueServer>(state);
+}
+
+BENCHMARK(Benchmark_SharedMultiQueue)->ThreadRange(1, 64)->UseRealTime();
+
+void Benchmark_ShardPerCore(benchmark::State& state) {
+  RunEchoClient<ShardPerCoreServer>(state);
+}
+
+BENCHMARK(Benchmark_ShardPerCore)->ThreadRange(1, 64)->UseRealTime();
+
+}  // namespace agrpc
@@ -0,0 +1,149 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/sharded_server.h"
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+#include <grpcpp/create_channel.h>
+#include <grpcpp/security/credentials.h>
+#include <grpcpp/security/server_credentials.h>
+#include <grpcpp/support/channel_arguments.h>
+#include <unifex/async_scope.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/task.hpp>
+
+#include "gtest/gtest.h"
+
+#include "agrpc/testing/echo.grpc.pb.h"
+
+namespace agrpc {
+namespace {
+
+using testing::EchoRequest;
+using testing::EchoResponse;
+using testing::EchoService;
+
+// Answers every call with the index of the shard that accepted it.
+unifex::task<void> ServeShardIndex(GrpcContext& context,
+                                   EchoService::AsyncService& service,
+                                   std::size_t shard) {
+  while (true) {
+    grpc::ServerContext server_context;
+    EchoRequest request;
+    grpc::ServerAsyncResponseWriter<EchoResponse> writer{&server_context};
+    bool request_ok = co_await AsyncRequest(
+        context.get_scheduler(), &EchoService::AsyncService::RequestEcho,
+        service, server_context, request, writer);
+    if (!request_ok) {
+      co_return;
+    }
+    EchoResponse response;
+    response.set_message(std::to_string(shard));
+    co_await AsyncFinish(context.get_scheduler(), writer, response,
+                         grpc::Status::OK);
+  }
+}
+
+class ShardedServerTest : public ::testing::Test {
+ protected:
+  static constexpr std::size_t kShards = 2;
+
+  void StartServer(ShardedServer::Options options) {
+    server_ = std::make_unique<ShardedServer>(
+        "127.0.0.1:0", grpc::InsecureServerCredentials(), options);
+    for (std::size_t i = 0; i < options.shards; ++i) {
+      services_.push_back(std::make_unique<EchoService::AsyncService>());
+    }
+    server_->Start(
+        [this](std::size_t shard, grpc::ServerBuilder& builder) {
+          builder.RegisterService(services_[shard].get());
+        },
+        [this](std::size_t shard, GrpcContext& context) {
+          scope_.spawn(ServeShardIndex(context, *services_[shard], shard));
+        });
+  }
+
+  // Makes a call on a fresh connection and returns the shard it landed on.
+  std::size_t CallOnNewConnection() {
+    grpc::ChannelArguments args;
+    args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+    auto stub = EchoService::NewStub(grpc::CreateCustomChannel(
+        fmt::format("127.0.0.1:{}", server_->selected_port()),
+        grpc::InsecureChannelCredentials(), args));
+    grpc::ClientContext client_context;
+    EchoRequest request;
+    EchoResponse response;
+    auto status = stub->Echo(&client_context, request, &response);
+    EXPECT_TRUE(status.ok()) << status.error_message();
+    return status.ok() ? std::stoul(response.message()) : kShards;
+  }
+
+  void TearDown() override {
+    if (server_) {
+      server_->ShutDown();
+      server_->Join();
+    }
+    unifex::sync_wait(scope_.cleanup());
+  }
+
+  std::vector<std::unique_ptr<EchoService::AsyncService>> services_;
+  std::unique_ptr<ShardedServer> server_;
+  unifex::async_scope scope_;
+};
+
+TEST_F(ShardedServerTest, ServesOnEveryShard) {
+  StartServer({.shards = kShards, .pin_threads = false});
+  ASSERT_EQ(server_->size(), kShards);
+  ASSERT_NE(server_->selected_port(), 0);
+
+  // The kernel hashes connections over the shards, so keep connecting until
+  // each of them has answered.
+  std::set<std::size_t> shards;
+  for (int i = 0; i < 256 && shards.size() < kShards; ++i) {
+    shards.insert(CallOnNewConnection());
+  }
+  ASSERT_EQ(shards.size(), kShards);
+}
+
+TEST_F(ShardedServerTest, ServesWithPinnedThreads) {
+  StartServer({.shards = kShards, .pin_threads = true, .first_cpu = 1});
+  ASSERT_LT(CallOnNewConnection(), kShards);
+}
+
+TEST_F(ShardedServerTest, ShutDownStopsEveryShard) {
+  StartServer({.shards = kShards, .pin_threads = false});
+  CallOnNewConnection();
+
+  server_->ShutDown();
+  server_->Join();
+  for (std::size_t i = 0; i < server_->size(); ++i) {
+    ASSERT_TRUE(server_->get_context(i).is_shut_down());
+  }
+  unifex::sync_wait(scope_.cleanup());
+  server_.reset();
+}
+
+TEST_F(ShardedServerTest, DestructorShutsDownAndJoins) {
+  StartServer({.shards = kShards, .pin_threads = false});
+  CallOnNewConnection();
+  server_.reset();
+}
+
+}  // namespace
+}  // namespace agrpc
@@ -0,0 +1,255 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_CONTEXT_TASK_H_
+#define AGRPC_CONTEXT_TASK_H_
+
+#include <cstddef>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include <unifex/await_transform.hpp>
+#include <unifex/connect_awaitable.hpp>
+#include <unifex/coroutine.hpp>
+#include <unifex/get_stop_token.hpp>
+#include <unifex/inplace_stop_token.hpp>
+#include <unifex/sender_concepts.hpp>
+#include <unifex/tag_invoke.hpp>
+#include <unifex/type_list.hpp>
+#include <unifex/type_traits.hpp>
+
+#include "agrpc/context/frame_allocator.h"
+
+namespace agrpc {
+
+template <typename T>
+class task;
+
+namespace detail {
+
+class TaskPromiseBase {
+ public:
+  static void* operator new(std::size_t size) { return AllocateFrame(size); }
+
+  static void operator delete(void* frame, std::size_t size) noexcept {
+    DeallocateFrame(frame, size);
+  }
+
+  unifex::coro::suspend_always initial_suspend() noexcept { return {}; }
+
+  // Resumes the awaiting coroutine by symmetric transfer, so that a chain of
+  // tasks completing synchronously does not grow the stack.
+  struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+
+    template <typename Promise>
+    unifex::coro::coroutine_handle<> await_suspend(
+        unifex::coro::coroutine_handle<Promise> coro) noexcept {
+      return coro.promise().continuation_.handle();
+    }
+
+    void await_resume() noexcept {}
+  };
+
+  FinalAwaiter final_suspend() noexcept { return {}; }
+
+  void unhandled_exception() noexcept {
+    exception_ = std::current_exception();
+  }
+
+  // A sender awaited by the task completed with done. Completes the awaiting
+  // coroutine with done as well.
+  unifex::coro::coroutine_handle<> unhandled_done() noexcept {
+    return continuation_.done();
+  }
+
+  friend unifex::inplace_stop_token tag_invoke(
+      unifex::tag_t<unifex::get_stop_token>,
+      const TaskPromiseBase& promise) noexcept {
+    return promise.stop_token_;
+  }
+
+ protected:
+  template <typename T>
+  friend class agrpc::task;
+
+  void RethrowIfFailed() {
+    if (exception_) {
+      std::rethrow_exception(std::move(exception_));
+    }
+  }
+
+  unifex::continuation_handle<> continuation_;
+  unifex::inplace_stop_token stop_token_;
+  std::exception_ptr exception_;
+};
+
+template <typename T>
+class TaskPromise : public TaskPromiseBase {
+ public:
+  task<T> get_return_object() noexcept;
+
+  template <typename Value>
+  decltype(auto) await_transform(Value&& value) {
+    return unifex::await_transform(*this, (Value &&) value);
+  }
+
+  template <typename Value>
+  void return_value(Value&& value) {
+    value_.emplace((Value &&) value);
+  }
+
+  T GetResult() {
+    RethrowIfFailed();
+    return std::move(*value_);
+  }
+
+ private:
+  std::optional<T> value_;
+};
+
+template <>
+class TaskPromise<void> : public TaskPromiseBase {
+ public:
+  task<void> get_return_object() noexcept;
+
+  template <typename Value>
+  decltype(auto) await_transform(Value&& value) {
+    return unifex::await_transform(*this, (Value &&) value);
+  }
+
+  void return_void() noexcept {}
+
+  void GetResult() { RethrowIfFailed(); }
+};
+
+}  // namespace detail
+
+// A lazily started coroutine like `unifex::task`, whose frame comes from
+// size-class free lists of the context it is created on rather than from the
+// heap. Awaiting one task from another transfers control symmetrically both
+// ways. Use it for handlers and the coroutines they await, which are created
+// for every call:
+//
+//   agrpc::task<HelloReply> MakeReply(const HelloRequest& request);
+//
+//   agrpc::task<void> Handle(grpc::ServerContext& server_context,
+//                            HelloRequest& request,
+//                            grpc::ServerAsyncResponseWriter<HelloReply>&
+//                                writer) {
+//     HelloReply reply = co_await MakeReply(request);
+//     co_await agrpc::AsyncFinish(scheduler, writer, reply, grpc::Status::OK);
+//   }
+//
+// A task is also a sender, so it can be spawned, run with `sync_wait` or
+// combined with other senders. Stop requests reach the senders it awaits if
+// the awaiting coroutine or receiver has an `inplace_stop_token`; other stop
+// tokens are not forwarded.
+template <typename T>
+class task {
+  static_assert(!std::is_reference_v<T>,
+                "agrpc::task does not support reference results.");
+
+ public:
+  using promise_type = detail::TaskPromise<T>;
+
+  template <template <typename...> class Variant,
+            template <typename...> class Tuple>
+  using value_types =
+      Variant<typename std::conditional_t<std::is_void_v<T>,
+                                          unifex::type_list<>,
+                                          unifex::type_list<T>>::
+                  template apply<Tuple>>;
+
+  template <template <typename...> class Variant>
+  using error_types = Variant<std::exception_ptr>;
+
+  static constexpr bool sends_done = true;
+
+  task(task&& other) noexcept : coro_(std::exchange(other.coro_, {})) {}
+
+  task& operator=(task other) noexcept {
+    std::swap(coro_, other.coro_);
+    return *this;
+  }
+
+  ~task() {
+    if (coro_) {
+      coro_.destroy();
+    }
+  }
+
+  class Awaiter {
+   public:
+    explicit Awaiter(
+        unifex::coro::coroutine_handle<promise_type> coro) noexcept
+        : coro_(coro) {}
+
+    bool await_ready() noexcept { return false; }
+
+    template <typename Promise>
+    unifex::coro::coroutine_handle<> await_suspend(
+        unifex::coro::coroutine_handle<Promise> continuation) noexcept {
+      auto& promise = coro_.promise();
+      promise.continuation_ = continuation;
+      using StopToken = unifex::stop_token_type_t<Promise&>;
+      if constexpr (std::is_same_v<StopToken, unifex::inplace_stop_token>) {
+        promise.stop_token_ = unifex::get_stop_token(continuation.promise());
+      }
+      return coro_;
+    }
+
+    T await_resume() { return coro_.promise().GetResult(); }
+
+   private:
+    unifex::coro::coroutine_handle<promise_type> coro_;
+  };
+
+  Awaiter operator co_await() && noexcept { return Awaiter{coro_}; }
+
+  template <typename Receiver>
+  friend auto tag_invoke(unifex::tag_t<unifex::connect>, task&& t,
+                         Receiver&& r) {
+    return unifex::connect_awaitable(std::move(t), (Receiver &&) r);
+  }
+
+ private:
+  friend promise_type;
+
+  explicit task(unifex::coro::coroutine_handle<promise_type> coro) noexcept
+      : coro_(coro) {}
+
+  unifex::coro::coroutine_handle<promise_type> coro_;
+};
+
+namespace detail {
+
+template <typename T>
+task<T> TaskPromise<T>::get_return_object() noexcept {
+  return task<T>{
+      unifex::coro::coroutine_handle<TaskPromise>::from_promise(*this)};
+}
+
+inline task<void> TaskPromise<void>::get_return_object() noexcept {
+  return task<void>{
+      unifex::coro::coroutine_handle<TaskPromise>::from_promise(*this)};
+}
+
+}  // namespace detail
+
+}  // namespace agrpc
+
+#endif  // AGRPC_CONTEXT_TASK_H_
@@ -0,0 +1,161 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/task.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+#include <fmt/core.h>
+#include <grpcpp/create_channel.h>
+#include <grpcpp/security/credentials.h>
+#include <grpcpp/security/server_credentials.h>
+#include <grpcpp/server.h>
+#include <grpcpp/server_builder.h>
+#include <unifex/async_scope.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/task.hpp>
+
+#include "benchmark/benchmark.h"
+
+#include "agrpc/context/grpc_context_pool.h"
+#include "agrpc/context/serve.h"
+#include "agrpc/testing/echo.grpc.pb.h"
+
+// Counts the heap allocations made by the server per unary call when the
+// handler and the coroutine it awaits are `unifex::task`s and when they are
+// `agrpc::task`s. Only allocations on the context's thread are counted, which
+// includes those of gRPC itself.
+
+namespace {
+
+std::atomic<std::uint64_t> context_allocations{0};
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  if (agrpc::detail::GrpcContextAccess::GetCurrent() != nullptr) {
+    context_allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+
+namespace agrpc {
+
+namespace {
+
+using testing::EchoRequest;
+using testing::EchoResponse;
+using testing::EchoService;
+
+template <template <typename> class Task>
+Task<EchoResponse> MakeResponse(const EchoRequest& request) {
+  EchoResponse response;
+  response.set_message(request.message());
+  co_return response;
+}
+
+template <template <typename> class Task>
+class EchoServer {
+ public:
+  EchoServer() {
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort("127.0.0.1:0", grpc::InsecureServerCredentials(),
+                             &port_);
+    builder.RegisterService(&service_);
+    pool_ = std::make_unique<GrpcContextPool>(builder, 1);
+    server_ = builder.BuildAndStart();
+    auto scheduler = pool_->get_context(0).get_scheduler();
+    scope_.spawn(serve(
+        scheduler, &EchoService::AsyncService::RequestEcho, service_,
+        [scheduler](grpc::ServerContext&, EchoRequest& request,
+                    grpc::ServerAsyncResponseWriter<EchoResponse>& writer)
+            -> Task<void> {
+          auto response = co_await MakeResponse<Task>(request);
+          co_await AsyncFinish(scheduler, writer, response, grpc::Status::OK);
+        },
+        {.outstanding_requests = 16}));
+    pool_->Start();
+  }
+
+  ~EchoServer() {
+    server_->Shutdown();
+    pool_->ShutDown();
+    pool_->Join();
+    unifex::sync_wait(scope_.cleanup());
+  }
+
+  int port() const noexcept { return port_; }
+
+ private:
+  int port_{0};
+  EchoService::AsyncService service_;
+  std::unique_ptr<GrpcContextPool> pool_;
+  std::unique_ptr<grpc::Server> server_;
+  unifex::async_scope scope_;
+};
+
+template <template <typename> class Task>
+void RunEchoClient(benchmark::State& state) {
+  static EchoServer<Task> server;
+
+  auto stub = EchoService::NewStub(
+      grpc::CreateChannel(fmt::format("127.0.0.1:{}", server.port()),
+                          grpc::InsecureChannelCredentials()));
+
+  EchoRequest request;
+  request.set_message("hello");
+  std::uint64_t allocations_before =
+      context_allocations.load(std::memory_order_relaxed);
+  while (state.KeepRunning()) {
+    grpc::ClientContext client_context;
+    EchoResponse response;
+    auto status = stub->Echo(&client_context, request, &response);
+    if (!status.ok()) {
+      state.SkipWithError(status.error_message().c_str());
+      break;
+    }
+  }
+  std::uint64_t allocations =
+      context_allocations.load(std::memory_order_relaxed) - allocations_before;
+  state.counters["allocs_per_rpc"] = benchmark::Counter(
+      static_cast<double>(allocations) / state.iterations());
+  state.SetItemsProcessed(state.iterations());
+}
+
+}  // namespace
+
+void Benchmark_UnifexTask(benchmark::State& state) {
+  RunEchoClient<unifex::task>(state);
+}
+
+BENCHMARK(Benchmark_UnifexTask)->UseRealTime();
+
+void Benchmark_AgrpcTask(benchmark::State& state) {
+  RunEchoClient<task>(state);
+}
+
+BENCHMARK(Benchmark_AgrpcTask)->UseRealTime();
+
+}  // namespace agrpc
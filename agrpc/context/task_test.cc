@@ -0,0 +1,148 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/task.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <stdexcept>
+
+#include <unifex/just.hpp>
+#include <unifex/just_done.hpp>
+#include <unifex/sync_wait.hpp>
+
+#include "gtest/gtest.h"
+
+#include "agrpc/context/frame_allocator.h"
+#include "agrpc/context/grpc_context.h"
+#include "agrpc/testing/grpc_context_helpers.h"
+
+namespace {
+
+// Memory whose return to the heap `operator delete` below records.
+std::atomic<void*> watched_memory{nullptr};
+std::atomic<bool> watched_memory_deleted{false};
+
+void Free(void* memory) noexcept {
+  if (memory != nullptr && memory == watched_memory.load()) {
+    watched_memory_deleted = true;
+  }
+  std::free(memory);
+}
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept { Free(memory); }
+
+void operator delete(void* memory, std::size_t) noexcept { Free(memory); }
+
+namespace agrpc {
+namespace {
+
+using testing::RunOnContext;
+using testing::ShutDownAndDrain;
+
+task<int> Add(int a, int b) { co_return a + b; }
+
+task<int> AddTwice(int a, int b) {
+  int sum = co_await Add(a, b);
+  co_return co_await Add(sum, sum);
+}
+
+task<void> Throw() {
+  throw std::runtime_error("failed");
+  co_return;
+}
+
+task<int> CountSynchronously(int n) {
+  int count = 0;
+  for (int i = 0; i < n; ++i) {
+    count = co_await Add(count, 1);
+  }
+  co_return count;
+}
+
+TEST(Task, ReturnsValue) {
+  ASSERT_EQ(unifex::sync_wait(AddTwice(1, 2)), 6);
+}
+
+TEST(Task, AwaitsSenders) {
+  auto result = unifex::sync_wait([]() -> task<int> {
+    co_return co_await unifex::just(42);
+  }());
+  ASSERT_EQ(result, 42);
+}
+
+TEST(Task, PropagatesExceptions) {
+  ASSERT_THROW(unifex::sync_wait(Throw()), std::runtime_error);
+}
+
+TEST(Task, PropagatesDone) {
+  auto result = unifex::sync_wait([]() -> task<int> {
+    co_await unifex::just_done();
+    co_return 1;
+  }());
+  ASSERT_FALSE(result.has_value());
+}
+
+TEST(Task, DoesNotGrowStackOnSynchronousCompletion) {
+  constexpr int kIterations = 1'000'000;
+  ASSERT_EQ(unifex::sync_wait(CountSynchronously(kIterations)), kIterations);
+}
+
+TEST(Task, ReusesFramesOnContext) {
+  GrpcContext context{std::make_unique<grpc::CompletionQueue>()};
+
+  RunOnContext(context, [] {
+    void* first = detail::AllocateFrame(200);
+    detail::DeallocateFrame(first, 200);
+    // Same size class.
+    void* second = detail::AllocateFrame(180);
+    ASSERT_EQ(second, first);
+    detail::DeallocateFrame(second, 180);
+  });
+
+  ShutDownAndDrain(context);
+}
+
+TEST(Task, ReleasesCachedFramesWithTheirContext) {
+  auto context =
+      std::make_unique<GrpcContext>(std::make_unique<grpc::CompletionQueue>());
+  void* frame = nullptr;
+  RunOnContext(*context, [&] {
+    frame = detail::AllocateFrame(200);
+    detail::DeallocateFrame(frame, 200);
+  });
+  ShutDownAndDrain(*context);
+
+  // The frame stays cached until the context goes away.
+  watched_memory = frame;
+  watched_memory_deleted = false;
+  context.reset();
+  ASSERT_TRUE(watched_memory_deleted);
+  watched_memory = nullptr;
+}
+
+}  // namespace
+}  // namespace agrpc
@@ -0,0 +1,56 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_CONTEXT_WITH_TIMEOUT_H_
+#define AGRPC_CONTEXT_WITH_TIMEOUT_H_
+
+#include <chrono>
+#include <utility>
+
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/stop_when.hpp>
+
+#include "agrpc/context/grpc_context.h"
+
+namespace agrpc {
+
+// Races `sender` against a timer on `scheduler`'s context. If `timeout`
+// elapses first, `sender` is asked to stop, which for a client call started
+// with its `grpc::ClientContext` cancels the call:
+//
+//   grpc::ClientContext client_context;
+//   auto reader = stub->AsyncSayHello(&client_context, request, cq);
+//   std::optional<bool> ok = co_await agrpc::with_timeout(
+//       agrpc::AsyncFinish(scheduler, client_context, *reader, reply, status),
+//       scheduler, std::chrono::milliseconds(100));
+//
+// The result is that of `sender`, i.e. done if it honoured the stop request.
+template <typename Sender, typename Rep, typename Ratio>
+auto with_timeout(Sender&& sender, GrpcContext::Scheduler scheduler,
+                  std::chrono::duration<Rep, Ratio> timeout) {
+  return unifex::stop_when(std::forward<Sender>(sender),
+                           unifex::schedule_after(scheduler, timeout));
+}
+
+// Same as above, with the timer on the context the call runs on.
+template <typename AsyncRPC, typename Rep, typename Ratio>
+auto with_timeout(GrpcContext::AsyncRPCSender<AsyncRPC> sender,
+                  std::chrono::duration<Rep, Ratio> timeout) {
+  auto scheduler = sender.get_scheduler();
+  return with_timeout(std::move(sender), scheduler, timeout);
+}
+
+}  // namespace agrpc
+
+#endif  // AGRPC_CONTEXT_WITH_TIMEOUT_H_
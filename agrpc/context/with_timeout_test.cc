@@ -0,0 +1,177 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "agrpc/context/with_timeout.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <thread>
+
+#include <unifex/async_scope.hpp>
+#include <unifex/inplace_stop_token.hpp>
+#include <unifex/just.hpp>
+#include <unifex/let_done.hpp>
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/task.hpp>
+#include <unifex/then.hpp>
+
+#include "gtest/gtest.h"
+
+#include "agrpc/testing/echo_server_fixture.h"
+#include "agrpc/testing/grpc_context_helpers.h"
+
+namespace agrpc {
+namespace {
+
+using testing::EchoRequest;
+using testing::EchoResponse;
+using testing::EchoService;
+using testing::RunUntil;
+using testing::ShutDownAndDrain;
+
+class WithTimeoutTest : public testing::EchoServerFixture {
+ protected:
+  // Accepts one call and echoes it after `delay`.
+  unifex::task<void> AnswerAfter(std::chrono::milliseconds delay) {
+    grpc::ServerContext server_context;
+    EchoRequest request;
+    grpc::ServerAsyncResponseWriter<EchoResponse> writer{&server_context};
+    bool request_ok = co_await AsyncRequest(
+        scheduler(), &EchoService::AsyncService::RequestEcho, service_,
+        server_context, request, writer);
+    if (request_ok) {
+      co_await unifex::schedule_after(scheduler(), delay);
+      EchoResponse response;
+      response.set_message(request.message());
+      co_await AsyncFinish(scheduler(), writer, response, grpc::Status::OK);
+    }
+    answered_ = true;
+  }
+
+  void WaitUntilAnswered() {
+    while (!answered_) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  std::unique_ptr<grpc::ClientAsyncResponseReader<EchoResponse>> StartEcho() {
+    request_.set_message("hello");
+    return stub_->AsyncEcho(&client_context_, request_,
+                            context().get_completion_queue());
+  }
+
+  std::atomic<bool> answered_{false};
+  grpc::ClientContext client_context_;
+  EchoRequest request_;
+  EchoResponse response_;
+  grpc::Status status_;
+};
+
+TEST_F(WithTimeoutTest, TimeoutThatFiresCancelsTheCall) {
+  scope_.spawn(AnswerAfter(std::chrono::milliseconds(500)));
+  auto reader = StartEcho();
+  auto ok = unifex::sync_wait(
+      with_timeout(AsyncFinish(scheduler(), client_context_, *reader,
+                               response_, status_),
+                   std::chrono::milliseconds(20)));
+  ASSERT_FALSE(ok.has_value());
+  ASSERT_EQ(status_.error_code(), grpc::StatusCode::CANCELLED);
+  WaitUntilAnswered();
+}
+
+TEST_F(WithTimeoutTest, TimeoutThatDoesNotFireKeepsTheResult) {
+  scope_.spawn(AnswerAfter(std::chrono::milliseconds(0)));
+  auto reader = StartEcho();
+  auto ok = unifex::sync_wait(
+      with_timeout(AsyncFinish(scheduler(), client_context_, *reader,
+                               response_, status_),
+                   std::chrono::seconds(30)));
+  ASSERT_TRUE(ok.has_value());
+  ASSERT_TRUE(*ok);
+  ASSERT_TRUE(status_.ok()) << status_.error_message();
+  ASSERT_EQ(response_.message(), "hello");
+  WaitUntilAnswered();
+}
+
+TEST_F(WithTimeoutTest, TimerOnAnotherScheduler) {
+  GrpcContext timer_context{std::make_unique<grpc::CompletionQueue>()};
+  unifex::inplace_stop_source stop_source;
+  std::thread timer_thread{[&] { timer_context.Run(stop_source.get_token()); }};
+
+  scope_.spawn(AnswerAfter(std::chrono::milliseconds(500)));
+  auto reader = StartEcho();
+  auto ok = unifex::sync_wait(
+      with_timeout(AsyncFinish(scheduler(), client_context_, *reader,
+                               response_, status_),
+                   timer_context.get_scheduler(),
+                   std::chrono::milliseconds(20)));
+  ASSERT_FALSE(ok.has_value());
+  WaitUntilAnswered();
+
+  stop_source.request_stop();
+  timer_thread.join();
+  ShutDownAndDrain(timer_context);
+}
+
+TEST_F(WithTimeoutTest, TryCancelFailsTheCall) {
+  scope_.spawn(AnswerAfter(std::chrono::milliseconds(500)));
+  auto reader = StartEcho();
+  client_context_.TryCancel();
+  // Cancelled without a stop request, so the call completes with its status.
+  auto ok = unifex::sync_wait(
+      AsyncFinish(scheduler(), client_context_, *reader, response_, status_));
+  ASSERT_TRUE(ok.has_value());
+  ASSERT_EQ(status_.error_code(), grpc::StatusCode::CANCELLED);
+  WaitUntilAnswered();
+}
+
+TEST_F(WithTimeoutTest, StopAfterSuccessKeepsTheResult) {
+  // The client side runs on a context driven from this thread, so that the
+  // stop request can be made while the completion of the call waits in the
+  // completion queue.
+  GrpcContext client{std::make_unique<grpc::CompletionQueue>()};
+  scope_.spawn(AnswerAfter(std::chrono::milliseconds(0)));
+  request_.set_message("hello");
+  auto reader = stub_->AsyncEcho(&client_context_, request_,
+                                 client.get_completion_queue());
+
+  std::optional<bool> ok;
+  bool done = false;
+  unifex::async_scope scope;
+  scope.spawn(unifex::let_done(
+      unifex::then(AsyncFinish(client.get_scheduler(), client_context_,
+                               *reader, response_, status_),
+                   [&](bool result) { ok = result; }),
+      [&] {
+        done = true;
+        return unifex::just();
+      }));
+  RunUntil(client, [&] { return client.get_outstanding_work() == 1; });
+  WaitUntilAnswered();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  scope.request_stop();
+  RunUntil(client, [&] { return ok.has_value() || done; });
+  ASSERT_FALSE(done);
+  ASSERT_TRUE(*ok);
+  ASSERT_TRUE(status_.ok()) << status_.error_message();
+  unifex::sync_wait(scope.cleanup());
+  ShutDownAndDrain(client);
+}
+
+}  // namespace
+}  // namespace agrpc
@@ -10,14 +10,15 @@
 
 #include "agrpc/base/logging.h"
 #include "agrpc/context/grpc_context.h"
+#include "agrpc/context/serve.h"
+#include "agrpc/context/task.h"
 #include "agrpc/example/proto/hellostreamingworld.grpc.pb.h"
 
 DEFINE_int32(port, 50051, "Grpc port to listen on");
 
 template <typename Scheduler>
-unifex::task<hellostreamingworld::HelloReply> HandleRequest(
-    Scheduler scheduler,
-    const hellostreamingworld::HelloRequest& request,
+agrpc::task<void> HandleRequest(
+    Scheduler scheduler, const hellostreamingworld::HelloRequest& request,
     grpc::ServerAsyncWriter<hellostreamingworld::HelloReply>& writer,
     const grpc::ServerContext& context) {
   hellostreamingworld::HelloReply response;
@@ -47,25 +48,20 @@ int main(int argc, char** argv) {
 
   unifex::inplace_stop_source stop_source{};
   unifex::sync_wait(unifex::when_all(
-      [&]() -> unifex::task<void> {
-        while (true) {
-          grpc::ServerContext server_context;
-          hellostreamingworld::HelloRequest request;
-          grpc::ServerAsyncWriter<hellostreamingworld::HelloReply> writer{
-              &server_context};
-          bool request_ok = co_await agrpc::AsyncRequest(
-              grpc_context.get_scheduler(),
-              &hellostreamingworld::MultiGreeter::AsyncService::RequestSayHello,
-              service, server_context, request, writer);
-          if (!request_ok) {
-            co_return;
-          }
-          co_await HandleRequest(grpc_context.get_scheduler(), request, writer,
-                                 server_context);
-          co_await agrpc::AsyncFinish(grpc_context.get_scheduler(), writer,
-                                      grpc::Status::OK);
-        }
-      }(),
+      agrpc::serve(
+          grpc_context.get_scheduler(),
+          &hellostreamingworld::MultiGreeter::AsyncService::RequestSayHello,
+          service,
+          [&](grpc::ServerContext& server_context,
+              hellostreamingworld::HelloRequest& request,
+              grpc::ServerAsyncWriter<hellostreamingworld::HelloReply>& writer)
+              -> agrpc::task<void> {
+            co_await HandleRequest(grpc_context.get_scheduler(), request,
+                                   writer, server_context);
+            co_await agrpc::AsyncFinish(grpc_context.get_scheduler(), writer,
+                                        grpc::Status::OK);
+          },
+          {.outstanding_requests = 16}),
       [&]() -> unifex::task<void> {
         grpc_context.Run(stop_source.get_token());
         co_return;
@@ -10,11 +10,13 @@
 
 #include "agrpc/base/logging.h"
 #include "agrpc/context/grpc_context.h"
+#include "agrpc/context/serve.h"
+#include "agrpc/context/task.h"
 #include "agrpc/example/proto/helloworld.grpc.pb.h"
 
 DEFINE_int32(port, 50051, "Grpc port to listen on");
 
-unifex::task<helloworld::HelloReply> HandleRequest(
+agrpc::task<helloworld::HelloReply> HandleRequest(
     const helloworld::HelloRequest& request,
     const grpc::ServerContext& context) {
   helloworld::HelloReply response;
@@ -42,24 +44,18 @@ int main(int argc, char** argv) {
 
   unifex::inplace_stop_source stop_source{};
   unifex::sync_wait(unifex::when_all(
-      [&]() -> unifex::task<void> {
-        while (true) {
-          grpc::ServerContext server_context;
-          helloworld::HelloRequest request;
-          grpc::ServerAsyncResponseWriter<helloworld::HelloReply> writer{
-              &server_context};
-          bool request_ok = co_await agrpc::AsyncRequest(
-              grpc_context.get_scheduler(),
-              &helloworld::Greeter::AsyncService::RequestSayHello,
-              service, server_context, request, writer);
-          if (!request_ok) {
-            co_return;
-          }
-          auto response = co_await HandleRequest(request, server_context);
-          co_await agrpc::AsyncFinish(grpc_context.get_scheduler(), writer,
-                                      response, grpc::Status::OK);
-        }
-      }(),
+      agrpc::serve(
+          grpc_context.get_scheduler(),
+          &helloworld::Greeter::AsyncService::RequestSayHello, service,
+          [&](grpc::ServerContext& server_context,
+              helloworld::HelloRequest& request,
+              grpc::ServerAsyncResponseWriter<helloworld::HelloReply>& writer)
+              -> agrpc::task<void> {
+            auto response = co_await HandleRequest(request, server_context);
+            co_await agrpc::AsyncFinish(grpc_context.get_scheduler(), writer,
+                                        response, grpc::Status::OK);
+          },
+          {.outstanding_requests = 16}),
       [&]() -> unifex::task<void> {
         grpc_context.Run(stop_source.get_token());
         co_return;
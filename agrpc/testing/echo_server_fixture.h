@@ -0,0 +1,90 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_TESTING_ECHO_SERVER_FIXTURE_H_
+#define AGRPC_TESTING_ECHO_SERVER_FIXTURE_H_
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include <fmt/format.h>
+#include <grpcpp/create_channel.h>
+#include <grpcpp/security/credentials.h>
+#include <grpcpp/security/server_credentials.h>
+#include <grpcpp/server.h>
+#include <grpcpp/server_builder.h>
+#include <unifex/async_scope.hpp>
+#include <unifex/inplace_stop_token.hpp>
+#include <unifex/sync_wait.hpp>
+
+#include "gtest/gtest.h"
+
+#include "agrpc/context/grpc_context.h"
+#include "agrpc/testing/echo.grpc.pb.h"
+
+namespace agrpc {
+namespace testing {
+
+// Serves `EchoService` from a `GrpcContext` that runs on a thread of its own,
+// and connects a stub to it. Client calls of the test can complete on the same
+// context. Work spawned into `scope_` is waited for after shutdown.
+class EchoServerFixture : public ::testing::Test {
+ protected:
+  EchoServerFixture() {
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort("127.0.0.1:0", grpc::InsecureServerCredentials(),
+                             &port_);
+    builder.RegisterService(&service_);
+    context_ = std::make_unique<GrpcContext>(builder.AddCompletionQueue());
+    server_ = builder.BuildAndStart();
+    stub_ = EchoService::NewStub(
+        grpc::CreateChannel(fmt::format("127.0.0.1:{}", port_),
+                            grpc::InsecureChannelCredentials()));
+    thread_ = std::thread{[this] {
+      // Returns once the completion queue is shut down and drained.
+      context_->Run(unifex::inplace_stop_token{});
+    }};
+  }
+
+  ~EchoServerFixture() override {
+    ShutDownServer();
+    thread_.join();
+    unifex::sync_wait(scope_.cleanup());
+  }
+
+  // Cancels the calls in flight, then shuts the context down. Idempotent.
+  void ShutDownServer() {
+    server_->Shutdown(std::chrono::system_clock::now());
+    context_->ShutDown();
+  }
+
+  GrpcContext& context() noexcept { return *context_; }
+  GrpcContext::Scheduler scheduler() noexcept {
+    return context_->get_scheduler();
+  }
+
+  int port_{0};
+  EchoService::AsyncService service_;
+  std::unique_ptr<GrpcContext> context_;
+  std::unique_ptr<grpc::Server> server_;
+  std::unique_ptr<EchoService::Stub> stub_;
+  unifex::async_scope scope_;
+  std::thread thread_;
+};
+
+}  // namespace testing
+}  // namespace agrpc
+
+#endif  // AGRPC_TESTING_ECHO_SERVER_FIXTURE_H_
@@ -0,0 +1,80 @@
+// Copyright 2021 The AGRPC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AGRPC_TESTING_GRPC_CONTEXT_HELPERS_H_
+#define AGRPC_TESTING_GRPC_CONTEXT_HELPERS_H_
+
+#include <chrono>
+#include <exception>
+
+#include <grpcpp/alarm.h>
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/sender_concepts.hpp>
+
+#include "agrpc/context/grpc_context.h"
+
+// Helpers for tests that drive a `GrpcContext` from the test thread instead of
+// running it on a thread of its own.
+
+namespace agrpc {
+namespace testing {
+
+template <typename F>
+struct InvokeReceiver {
+  F* fn;
+  void set_value() && noexcept { (*fn)(); }
+  void set_error(std::exception_ptr) && noexcept { std::terminate(); }
+  void set_done() && noexcept {}
+};
+
+// Runs `fn` on `context`, driving it from this thread.
+template <typename F>
+void RunOnContext(GrpcContext& context, F fn) {
+  auto op = unifex::connect(unifex::schedule(context.get_scheduler()),
+                            InvokeReceiver<F>{&fn});
+  unifex::start(op);
+  while (context.RunOne() == 0) {
+  }
+}
+
+// Drives `context` from this thread until `done()` returns true.
+template <typename Predicate>
+void RunUntil(GrpcContext& context, Predicate done) {
+  while (!done()) {
+    context.RunOne();
+  }
+}
+
+// Completes through the completion queue of the scheduler's context once
+// `deadline` has passed, with `false` if `alarm` is cancelled before.
+inline auto AsyncAlarm(GrpcContext::Scheduler scheduler, grpc::Alarm& alarm,
+                       std::chrono::system_clock::time_point deadline =
+                           std::chrono::system_clock::now()) {
+  return GrpcContext::AsyncRPCSender(
+      scheduler, [&alarm, deadline](GrpcContext& context, void* tag) {
+        alarm.Set(context.get_completion_queue(), deadline, tag);
+      });
+}
+
+inline void ShutDownAndDrain(GrpcContext& context) {
+  context.ShutDown();
+  while (!context.is_shut_down()) {
+    context.RunOne();
+  }
+}
+
+}  // namespace testing
+}  // namespace agrpc
+
+#endif  // AGRPC_TESTING_GRPC_CONTEXT_HELPERS_H_
@@ -10,6 +10,8 @@ include(CMakeParseArguments)
 # PROTOC_ARGS: List of protobuf arguments.
 # PUBLIC: Add this so that this library will be exported under agrpc::
 # WITH_GRPC: Whether to generate grpc files.
+# WITH_AGRPC: Whether to also generate agrpc service skeletons (.agrpc.h) with
+#   protoc-gen-agrpc. Implies WITH_GRPC.
 # Also in IDE, target will appear in AGRPC folder while non PUBLIC will be in AGRPC/internal.
 # TESTONLY: When added, this target will only be built if user passes -DAGRPC_BUILD_TESTS=ON to CMake.
 #
@@ -32,8 +34,8 @@ include(CMakeParseArguments)
 #   DEPS
 #     agrpc::schemas::some_def )
 function(agrpc_cc_proto_library)
-  cmake_parse_arguments(_RULE "PUBLIC;WITH_GRPC;TESTONLY" "NAME" "SRCS;PROTOC_ARGS"
-                        ${ARGN})
+  cmake_parse_arguments(_RULE "PUBLIC;WITH_GRPC;WITH_AGRPC;TESTONLY" "NAME"
+                        "SRCS;PROTOC_ARGS" ${ARGN})
 
   if(_RULE_TESTONLY AND NOT AGRPC_BUILD_TESTS)
     return()
@@ -43,6 +45,10 @@ function(agrpc_cc_proto_library)
   agrpc_package_name(_PACKAGE_NAME)
   set(_NAME "${_PACKAGE_NAME}_${_RULE_NAME}")
 
+  if(_RULE_WITH_AGRPC)
+    set(_RULE_WITH_GRPC ON)
+  endif()
+
   protobuf_generate(PROTOS ${_RULE_SRCS} LANGUAGE cpp OUT_VAR _OUTS)
 
   if(_RULE_WITH_GRPC)
@@ -62,6 +68,21 @@ function(agrpc_cc_proto_library)
     list(APPEND _OUTS ${_GRPC_OUTS})
   endif()
 
+  if(_RULE_WITH_AGRPC)
+    protobuf_generate(
+      PROTOS
+      ${_RULE_SRCS}
+      LANGUAGE
+      agrpc
+      GENERATE_EXTENSIONS
+      .agrpc.h
+      PLUGIN
+      "protoc-gen-agrpc=$<TARGET_FILE:agrpc_codegen_protoc-gen-agrpc>"
+      OUT_VAR
+      _AGRPC_OUTS)
+    list(APPEND _OUTS ${_AGRPC_OUTS})
+  endif()
+
   add_library(${_NAME} STATIC "")
   set_source_files_properties(${_OUTS} PROPERTIES GENERATED TRUE)
   target_sources(${_NAME} PRIVATE ${_OUTS})
@@ -74,6 +95,11 @@ function(agrpc_cc_proto_library)
   if(_RULE_WITH_GRPC)
     target_link_libraries(${_NAME} PUBLIC gRPC::grpc++)
   endif()
+  if(_RULE_WITH_AGRPC)
+    target_link_libraries(
+      ${_NAME} PUBLIC agrpc::context::grpc_context_pool agrpc::context::serve
+                      agrpc::context::task unifex)
+  endif()
 
   # Add all AGRPC targets to a folder in the IDE for organization.
   if(_RULE_PUBLIC)